@@ -1,15 +1,26 @@
 #include "storage/DataBlock.h"
 #include "storage/DataView.h"
+#include "storage/FixedPoint.h"
 #include "storage/IO.h"
 #include "storage/Matrix.h"
 #include "storage/MCTask.h"
 #include "storage/MLTask.h"
+#include "storage/ModelReplicas.h"
+#include "storage/Partitioner.h"
+#include "storage/Prefetch.h"
+#include "storage/RandomProjection.h"
 #include "storage/SVMTask.h"
 #include "storage/tests/StorageTestHelpers.h"
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <gflags/gflags.h>
+#include <limits>
+#include <mutex>
+#include <numeric>
 #include <string>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
@@ -42,6 +53,212 @@ static bool ValidateAlgorithm(const char* flagname, std::string const & value) {
 DEFINE_string(algorithm, "svm", "The machine learning algorithm to use. Select one of [svm, mc].");
 DEFINE_validator(algorithm, &ValidateAlgorithm);
 
+static bool ValidateScheduler(const char* flagname, std::string const & value) {
+  if (value.compare("static") == 0 || value.compare("stealing") == 0 || value.compare("cyclades") == 0) {
+    return true;
+  }
+  printf("Invalid scheduler choice. Choices are:\n\tstatic\n\tstealing\n\tcyclades\n");
+  return false;
+}
+DEFINE_string(scheduler, "static", "How an epoch's data is divided amongst threads. 'static' gives each"
+  " thread a fixed share. 'stealing' splits the epoch into block ranges which threads pull from"
+  " per-thread queues, stealing from other threads when their own runs dry. 'cyclades' (sparse SVM"
+  " only) samples the rows into batches and gives each connected component of a batch's row-feature"
+  " conflict graph to one thread, so that no two threads update a feature at once.");
+DEFINE_validator(scheduler, &ValidateScheduler);
+
+static bool ValidateCycladesBatchRows(const char* flagname, std::int64_t value) {
+  if (value >= 0 && value <= std::numeric_limits<int>::max()) {
+    return true;
+  }
+  printf("The number of rows per cyclades batch should be positive, or 0 to size batches automatically\n");
+  return false;
+}
+DEFINE_int64(cyclades_batch_rows, 0, "The number of rows per batch of the cyclades scheduler. 0 sizes"
+  " batches from the column degrees so that a row is expected to share features with fewer than one"
+  " other row of its batch.");
+DEFINE_validator(cyclades_batch_rows, &ValidateCycladesBatchRows);
+
+static bool ValidatePartition(const char* flagname, std::string const & value) {
+  obamadb::PartitionPolicy policy;
+  if (obamadb::ParsePartitionPolicy(value, &policy)) {
+    return true;
+  }
+  printf("Invalid partition choice. Choices are:\n\tcontiguous\n\tlongest-first\n\tround-robin\n");
+  return false;
+}
+DEFINE_string(partition, "contiguous", "How the static scheduler divides the SVM training rows amongst"
+  " threads. 'contiguous' cuts the rows, in storage order, into runs of equal nonzeros, splitting"
+  " blocks between threads. 'longest-first' assigns whole blocks, the most nonzeros first, to the"
+  " thread with the fewest nonzeros, cutting only blocks larger than a quarter of a thread's share."
+  " 'round-robin' deals whole blocks out by count.");
+DEFINE_validator(partition, &ValidatePartition);
+
+static bool ValidatePrefetchDistance(const char* flagname, std::int64_t value) {
+  if (value >= -1 && value <= 1024) {
+    return true;
+  }
+  printf("The prefetch distance should be between -1 and 1024\n");
+  return false;
+}
+DEFINE_int64(prefetch_distance, obamadb::kDefaultPrefetchDistance, "How many rows (SVM) or ratings (MC)"
+  " ahead of the current one a thread prefetches the model entries of. Models small enough to stay in"
+  " cache (under 4 MB) are not prefetched. 0 disables prefetching, and -1 times the first epochs with"
+  " different distances, whatever the model's size, and keeps the fastest.");
+DEFINE_validator(prefetch_distance, &ValidatePrefetchDistance);
+
+static bool ValidateMinibatchRows(const char* flagname, std::int64_t value) {
+  if (value >= 1 && value <= (1 << 20)) {
+    return true;
+  }
+  printf("The number of rows per mini-batch should be between 1 and %d\n", 1 << 20);
+  return false;
+}
+DEFINE_int64(minibatch_rows, 1, "The number of rows each SVM thread sums its updates over, in a"
+  " thread-local gradient, before adding them to the shared model with one write per distinct feature."
+  " 1 updates the model after every row. Not used by the cyclades scheduler, whose threads never"
+  " share features.");
+DEFINE_validator(minibatch_rows, &ValidateMinibatchRows);
+
+DEFINE_bool(shuffle, false, "If true, each SVM thread visits its blocks, and the chunks of rows within"
+  " each block, in a new random order every epoch. The data is not moved.");
+DEFINE_int64(shuffle_seed, 0, "Seeds the per-thread shuffling orders, and the order in which the cyclades"
+  " scheduler samples rows into batches.");
+DEFINE_bool(shuffle_compare, false, "If true, each SVM trial trains twice from the same initial model,"
+  " without and then with shuffling, and prints the time and convergence of each epoch side by side.");
+
+static bool ValidateSVMLoss(const char* flagname, std::string const & value) {
+  obamadb::SVMLoss loss;
+  if (obamadb::ParseSVMLoss(value, &loss)) {
+    return true;
+  }
+  printf("Invalid SVM loss choice. Choices are:\n\thinge\n\talways-update\n");
+  return false;
+}
+DEFINE_string(svm_loss, "always-update", "The loss SVM rows step along. 'hinge' skips rows classified"
+  " beyond the margin. 'always-update' gives them a small step back, so every row writes the model.");
+DEFINE_validator(svm_loss, &ValidateSVMLoss);
+
+static bool ValidateSVMRegularization(const char* flagname, std::string const & value) {
+  obamadb::SVMRegularization regularization;
+  if (obamadb::ParseSVMRegularization(value, &regularization)) {
+    return true;
+  }
+  printf("Invalid SVM regularization choice. Choices are:\n\tnone\n\tdegree-scaling\n\tlazy-l2\n");
+  return false;
+}
+DEFINE_string(svm_regularization, "none", "The SVM regularization. 'degree-scaling' shrinks the features"
+  " a row updates in inverse proportion to the number of rows holding them. 'lazy-l2' shrinks every"
+  " feature on every row, deferring each feature's shrinkage until it is next read.");
+DEFINE_validator(svm_regularization, &ValidateSVMRegularization);
+
+static bool ValidateUpdateConsistency(const char* flagname, std::string const & value) {
+  obamadb::UpdateConsistency consistency;
+  if (obamadb::ParseUpdateConsistency(value, &consistency)) {
+    return true;
+  }
+  printf("Invalid update consistency choice. Choices are:\n\tracy\n\tatomic\n\tlocked\n");
+  return false;
+}
+DEFINE_string(update_consistency, "racy", "How SVM threads update the shared model. 'racy' uses plain"
+  " loads and stores, as Hogwild, and may lose updates. 'atomic' updates each feature with a"
+  " compare-and-swap. 'locked' holds a lock on the whole model for each row.");
+DEFINE_validator(update_consistency, &ValidateUpdateConsistency);
+
+static bool ValidateSVMOptimizer(const char* flagname, std::string const & value) {
+  obamadb::SVMOptimizer optimizer;
+  if (obamadb::ParseSVMOptimizer(value, &optimizer)) {
+    return true;
+  }
+  printf("Invalid SVM optimizer choice. Choices are:\n\tsgd\n\tadagrad\n");
+  return false;
+}
+DEFINE_string(svm_optimizer, "sgd", "How SVM steps are sized. 'sgd' steps every feature by the global"
+  " step size. 'adagrad' divides each feature's step by the root of its summed squared gradients,"
+  " kept next to its weight, so rare features keep taking larger steps.");
+DEFINE_validator(svm_optimizer, &ValidateSVMOptimizer);
+
+static bool ValidateModelPrecision(const char* flagname, std::string const & value) {
+  obamadb::ModelPrecision precision;
+  if (obamadb::ParseModelPrecision(value, &precision)) {
+    return true;
+  }
+  printf("Invalid model precision choice. Choices are:\n\tfp32\n\tint16\n\tint8\n");
+  return false;
+}
+DEFINE_string(model_precision, "fp32", "How the SVM model's weights are stored. 'int16' and 'int8' store"
+  " fixed-point weights, whose updates are rounded stochastically, so that each update moves fewer"
+  " bytes between the cores. Fixed-point models are trained with racy plain SGD and no regularization.");
+DEFINE_validator(model_precision, &ValidateModelPrecision);
+
+static bool ValidateFixedPointRange(const char* flagname, double value) {
+  if (value > 0) {
+    return true;
+  }
+  printf("The fixed-point range must be positive.\n");
+  return false;
+}
+DEFINE_double(fixed_point_range, 4, "The largest magnitude a weight of a fixed-point model can take."
+  " The weights' resolution is the range over the largest value of the integer type.");
+DEFINE_validator(fixed_point_range, &ValidateFixedPointRange);
+
+static bool ValidateSVMSweep(const char* flagname, std::string const & value) {
+  std::vector<obamadb::SVMSweepSetting> settings;
+  if (value.empty() || obamadb::ParseSVMSweep(value, &settings)) {
+    return true;
+  }
+  printf("Invalid SVM sweep. Give comma separated step_size:mu pairs, e.g. 0.1:1,0.05:1\n");
+  return false;
+}
+DEFINE_string(svm_sweep, "", "If given, a comma separated list of step_size:mu pairs. One SVM model per"
+  " pair is trained, all of them updated by each row of a single scan of the data. The loss and the"
+  " regularization, 'none' or 'degree-scaling', are shared by the models.");
+DEFINE_validator(svm_sweep, &ValidateSVMSweep);
+
+static bool ValidateReplication(const char* flagname, std::string const & value) {
+  obamadb::ReplicationPolicy policy;
+  if (obamadb::ParseReplicationPolicy(value, &policy)) {
+    return true;
+  }
+  printf("Invalid replication choice. Choices are:\n\tshared\n\tsocket\n\tcore\n");
+  return false;
+}
+DEFINE_string(replication, "shared", "How many copies of the SVM model the training threads update."
+  " 'shared' is a single model. 'socket' gives the threads of each socket a replica of their own, and"
+  " 'core' the threads of each physical core. Replicas are averaged after every epoch, and more often"
+  " with replica_merge_rows. Not used by the cyclades scheduler.");
+DEFINE_validator(replication, &ValidateReplication);
+
+static bool ValidateReplicaMergeRows(const char* flagname, std::int64_t value) {
+  if (value >= 0) {
+    return true;
+  }
+  printf("The number of rows between replica merges should not be negative\n");
+  return false;
+}
+DEFINE_int64(replica_merge_rows, 0, "If positive, a background thread also averages the model replicas"
+  " each time the training threads have trained this many more rows.");
+DEFINE_validator(replica_merge_rows, &ValidateReplicaMergeRows);
+DEFINE_bool(replication_compare, false, "If true, each SVM trial trains once per replication granularity"
+  " (shared, socket, core) from the same initial model, and prints the throughput and convergence of"
+  " each epoch side by side.");
+
+static bool ValidatePlacement(const char* flagname, std::string const & value) {
+  obamadb::threading::PlacementPolicy policy;
+  if (obamadb::threading::ParsePlacementPolicy(value, &policy)) {
+    return true;
+  }
+  printf("Invalid placement choice. Choices are:\n\tlinear\n\tcompact\n\tscatter\n"
+         "\tone-per-physical-core\n\tfill-socket-first\n");
+  return false;
+}
+DEFINE_string(placement, "one-per-physical-core", "The order in which threads are bound to cpus when"
+  " core_affinities is not given. 'compact' fills the hyperthreads of a core before the next core,"
+  " 'scatter' spreads threads over sockets and then physical cores, 'one-per-physical-core' uses one"
+  " hyperthread per physical core before any siblings, 'fill-socket-first' uses a socket's physical"
+  " cores and then its hyperthreads before the next socket, and 'linear' uses cpus in id order.");
+DEFINE_validator(placement, &ValidatePlacement);
+
 DEFINE_string(train_file, "", "The TSV format file to train the algorithm over.");
 DEFINE_string(test_file, "", "The TSV format file to test the algorithm over.");
 
@@ -58,6 +275,30 @@ DEFINE_string(core_affinities, "-1", "A comma separated list of cores to have th
 
 DEFINE_int64(rank, 10, "The rank of the LR factoring matrices used in Matrix Completion");
 
+DEFINE_int64(projection_k, 0, "If greater than 0, the SVM train and test sets are compressed to this many"
+  " columns with the same random projection before training.");
+DEFINE_int64(projection_seed, 0, "The seed which identifies the random projection matrix.");
+DEFINE_double(projection_dense_threshold, 0.5, "Projected matrices whose expected fraction of nonzero"
+  " elements exceeds this are stored in dense blocks and trained with dense kernels.");
+
+DEFINE_int64(barrier_spin_budget, obamadb::threading::kDefaultBarrierSpinBudget, "The number of pause"
+  " iterations a thread pool worker spins at an epoch barrier before sleeping.");
+
+DEFINE_bool(stats_cache, false, "If true, the statistics computed while loading a data file are cached"
+  " next to it and reused by later runs on the same file.");
+
+DEFINE_int64(eval_threads, 0, "The number of threads which compute the metrics printed after each epoch"
+  " in verbose mode. 0 uses a thread per core, or with async_eval, a thread per core left over by"
+  " training.");
+DEFINE_bool(perf_counters, false, "If true, each thread reads hardware performance counters (cycles,"
+  " instructions, stalls, cache and NUMA node misses) over its share of every epoch, and they are"
+  " printed with the epoch stats. Counters the machine does not allow are printed as n/a.");
+DEFINE_bool(eval_auc, false, "If true, the metrics printed after each epoch in verbose mode also include"
+  " the area under the ROC curve of the train and test margins.");
+DEFINE_bool(async_eval, false, "If true, the metrics printed after each epoch in verbose mode are"
+  " computed on a copy of the model in the background, overlapped with the next epoch, on the cores"
+  " after those the training threads are bound to.");
+
 
 #define VPRINT(str) { if(FLAGS_verbose) { printf(str); } }
 #define VPRINTF(str, ...) { if(FLAGS_verbose) { printf(str, __VA_ARGS__); } }
@@ -114,9 +355,8 @@ namespace obamadb {
       return;
     }
 
-    // Loop until the number of waiters is the number of worker threads.
-    int const total_workers = observer->threadPool_->getNumWorkers();
-    while (total_workers > observer->threadPool_->getWaiterCount()) {
+    // Loop until the observer is the only thread still running the cycle.
+    while (observer->threadPool_->getNumRunning() > 1) {
       observer->record();
       usleep(ConvergenceObserver::kObserverWaitTimeUS);
     }
@@ -124,29 +364,210 @@ namespace obamadb {
   }
 
   /**
-   * Allocates Datablocks to DataViews. Dataviews will then be given to threads in the form of tasks.
+   * Averages model replicas in the background while they are trained, every so many rows.
+   */
+  struct ReplicaMerger {
+    ReplicaMerger(ModelReplicas *replicas, std::int64_t merge_rows)
+      : replicas(replicas),
+        merge_rows(merge_rows),
+        next_merge(merge_rows),
+        background_threads(1),
+        threadPool_(nullptr) {}
+
+    static int kMergerWaitTimeUS; // Time between checks of the training progress.
+
+    ModelReplicas *replicas;
+    std::int64_t const merge_rows;
+    // The row count, over all epochs, at which to merge next.
+    std::int64_t next_merge;
+    // Threads of the pool which are still running the cycle but not training, including the merger.
+    // Set before each cycle, as the observer only runs in the first.
+    int background_threads;
+    ThreadPool * threadPool_;
+  };
+
+  int ReplicaMerger::kMergerWaitTimeUS = 100;
+
+  /**
+   * The function which a thread calls once per epoch to merge replicas until the training threads
+   * have finished.
+   * @param tid Thread id. Not used.
+   * @param mergerState The merger.
+   */
+  void mergerThreadFn(int tid, void* mergerState) {
+    (void) tid;
+    ReplicaMerger* merger = reinterpret_cast<ReplicaMerger*>(mergerState);
+    while (merger->threadPool_->getNumRunning() > merger->background_threads) {
+      if (merger->replicas->getRows() >= merger->next_merge) {
+        merger->replicas->average(nullptr);
+        merger->next_merge += merger->merge_rows;
+      } else {
+        usleep(ReplicaMerger::kMergerWaitTimeUS);
+      }
+    }
+  }
+
+  // The number of work items per thread an epoch of matrix completion is split into when stealing.
+  int const kStealingItemsPerThread = 16;
+
+  bool useWorkStealing() {
+    return FLAGS_scheduler.compare("stealing") == 0;
+  }
+
+  bool useCyclades() {
+    return FLAGS_scheduler.compare("cyclades") == 0;
+  }
+
+  /**
+   * @return A scheduler of conflict-free batches over the training rows.
+   */
+  std::unique_ptr<CycladesScheduler> getCycladesScheduler(Matrix const * mat_train) {
+    CHECK(!mat_train->isDense()) << "The cyclades scheduler needs sparse training data, as every pair of"
+                                 << " dense rows conflicts";
+    MatrixStats const & stats = mat_train->getStats();
+    int const batch_rows = FLAGS_cyclades_batch_rows > 0
+                           ? static_cast<int>(FLAGS_cyclades_batch_rows)
+                           : CycladesBatchRows(stats, kCycladesConflictsPerRow);
+    std::unique_ptr<CycladesScheduler> cyclades(new CycladesScheduler(
+      FLAGS_threads, mat_train->blocks_, mat_train->numColumns_, batch_rows, FLAGS_shuffle_seed));
+    VPRINTF("cyclades: %d batches of %d rows per epoch, %.2f expected conflicts per row\n",
+            cyclades->getNumBatches(),
+            cyclades->getBatchRows(),
+            CycladesExpectedConflicts(stats, cyclades->getBatchRows()));
+    LOG_IF(WARNING, CycladesExpectedConflicts(stats, cyclades->getBatchRows()) > 1)
+      << "The training rows share features too widely for small batches to break into many components,"
+      << " so cyclades batches will train mostly on one thread";
+    VPRINT("cyclades, epoch, mean_plan_time\n");
+    return cyclades;
+  }
+
+  /**
+   * Allocates the rows of the Datablocks to DataViews, balancing their nonzeros according to the
+   * partition flag. Dataviews will then be given to threads in the form of tasks.
    * @param num_threads How many dataviews to allocate and distribute amongst.
    * @param data_blocks The set of training data.
-   * @return Vector of Dataviews.
+   * @param stats Statistics of the matrix holding the blocks.
    */
-  template<class T>
+  template<class Block>
   void allocateBlocks(const int num_threads,
-                      const std::vector<SparseDataBlock<T> *> &data_blocks,
+                      const std::vector<Block *> &data_blocks,
+                      MatrixStats const & stats,
                       std::vector<std::unique_ptr<DataView>>& views) {
     CHECK(views.size() == 0) << "Only accepts empty view vectors";
-    CHECK_GE(data_blocks.size(), views.size())
-      << "Partitioned data would not distribute to all threads."
-      << " Use fewer threads.";
-
-    for (int i = 0; i < data_blocks.size(); i++) {
-      if (i < num_threads) {
-        views.push_back(std::unique_ptr<DataView>(new DataView()));
+    PartitionPolicy policy;
+    CHECK(ParsePartitionPolicy(FLAGS_partition, &policy));
+
+    RowCosts const costs = GetRowCosts(data_blocks, stats);
+    std::vector<std::vector<RowSlice>> const parts = PartitionRows(costs, num_threads, policy);
+    for (auto const & part : parts) {
+      DataView *view = new DataView();
+      for (RowSlice const & slice : part) {
+        view->appendBlock(data_blocks[slice.block], slice.begin, slice.end);
       }
-      SparseDataBlock<T> const *dbptr = data_blocks[i];
-      views[i % num_threads]->appendBlock(dbptr);
+      views.push_back(std::unique_ptr<DataView>(view));
+    }
+
+    if (FLAGS_verbose) {
+      std::vector<std::int64_t> const part_costs = GetPartCosts(costs, parts);
+      double const mean = std::accumulate(part_costs.begin(), part_costs.end(), 0.0) / part_costs.size();
+      std::int64_t const max = *std::max_element(part_costs.begin(), part_costs.end());
+      printf("partition: %s, %d blocks over %d threads, cost imbalance (max/mean) %.3f\n",
+             PartitionPolicyName(policy).c_str(), (int) data_blocks.size(), num_threads,
+             mean == 0 ? 1.0 : max / mean);
     }
   }
 
+  /**
+   * Training tasks run on the workers of the current pool in the order they are given to a
+   * ThreadPool.
+   * @param first_worker The position of the first training task amongst the pool's tasks.
+   * @return The core each training thread is bound to.
+   */
+  std::vector<int> getTrainingCores(int first_worker) {
+    WorkerPool const * pool = WorkerPool::Current();
+    CHECK(pool != nullptr && first_worker + FLAGS_threads <= pool->getNumWorkers())
+      << "Training threads must run on the global worker pool to be placed";
+    std::vector<int> cores;
+    for (int i = 0; i < FLAGS_threads; i++) {
+      cores.push_back(pool->getCore(first_worker + i));
+    }
+    return cores;
+  }
+
+  /**
+   * @return A tuner if the prefetch distance should be tuned, otherwise null.
+   */
+  std::unique_ptr<PrefetchTuner> getPrefetchTuner() {
+    return std::unique_ptr<PrefetchTuner>(FLAGS_prefetch_distance < 0 ? new PrefetchTuner() : nullptr);
+  }
+
+  /**
+   * @param model_bytes The size of the model the prefetches are for.
+   * @return The prefetch distance for the next epoch.
+   */
+  int getPrefetchDistance(PrefetchTuner const * tuner, std::size_t model_bytes) {
+    return tuner != nullptr ? tuner->distance() : prefetchDistanceFor(FLAGS_prefetch_distance, model_bytes);
+  }
+
+  /**
+   * Times an epoch for the tuner, if the distance is being tuned.
+   */
+  void recordPrefetchEpoch(PrefetchTuner *tuner, int epoch, int distance, double seconds) {
+    if (tuner == nullptr || tuner->isTuned()) {
+      return;
+    }
+    tuner->record(seconds);
+    VPRINTF("prefetch, %d, distance %d, %.6f\n", epoch, distance, seconds);
+    if (tuner->isTuned()) {
+      VPRINTF("prefetch distance tuned to %d\n", tuner->distance());
+    }
+  }
+
+  /**
+   * @return The number of threads used to evaluate the model.
+   */
+  int numEvalThreads() {
+    if (FLAGS_eval_threads > 0) {
+      return FLAGS_eval_threads;
+    } else if (FLAGS_async_eval) {
+      return std::max<int>(1, threading::numCores() - FLAGS_threads);
+    }
+    return threading::numCores();
+  }
+
+  /**
+   * The training threads are the first workers of the global pool, so they are bound to the first
+   * cores handed out. Background evaluation takes the cores handed out after them.
+   * @return Cores for background evaluation threads.
+   */
+  std::vector<int> getAsyncEvalCores(int num_threads) {
+    std::vector<int> const order = FLAGS_core_affinities.compare("-1") == 0
+      ? threading::getTopology().placement(threading::getPlacementPolicy())
+      : GetIntList(FLAGS_core_affinities);
+    int const num_training_threads = FLAGS_threads + (FLAGS_measure_convergence ? 1 : 0);
+    std::vector<int> cores;
+    for (int i = 0; i < num_threads; i++) {
+      cores.push_back(order[(num_training_threads + i) % order.size()]);
+    }
+    return cores;
+  }
+
+  /**
+   * @return Every metric of the model on the matrix, from one pass over its rows.
+   */
+  SVMMetrics evaluateSVM(fvector const & theta, Matrix const * mat, bool auc) {
+    return mat->isDense() ? SVMTask::evaluate(theta, mat->dense_blocks_, numEvalThreads(), auc)
+                          : SVMTask::evaluate(theta, mat->blocks_, numEvalThreads(), auc);
+  }
+
+  double fractionMisclassified(fvector const & theta, Matrix const * mat) {
+    return evaluateSVM(theta, mat, false).fractionMisclassified();
+  }
+
+  double rmsErrorLoss(fvector const & theta, Matrix const * mat) {
+    return evaluateSVM(theta, mat, false).rmsErrorLoss();
+  }
+
   void printSVMEpochStats(Matrix const * matTrain,
                         Matrix const * matTest,
                         fvector const & theta,
@@ -157,28 +578,247 @@ namespace obamadb {
       return;
     }
 
-    double const trainRmsLoss = SVMTask::rmsErrorLoss(theta, matTrain->blocks_);
-    double const testRmsLoss = SVMTask::rmsErrorLoss(theta, matTest->blocks_);
-    double const trainFractionMisclassified = SVMTask::fractionMisclassified(theta,matTrain->blocks_);
-    double const testFractionMisclassified = SVMTask::fractionMisclassified(theta,matTest->blocks_);
+    SVMMetrics const train = evaluateSVM(theta, matTrain, FLAGS_eval_auc);
+    SVMMetrics const test = evaluateSVM(theta, matTest, FLAGS_eval_auc);
 
-    printf("%-3d, %.3f, %.4f, %.2f, %.4f, %.2f\n",
+    printf("%-3d, %.3f, %.4f, %.2f, %.4f, %.2f",
            iteration,
            timeTrain,
-           trainFractionMisclassified,
-           trainRmsLoss,
-           testFractionMisclassified,
-           testRmsLoss);
+           train.fractionMisclassified(),
+           train.rmsErrorLoss(),
+           test.fractionMisclassified(),
+           test.rmsErrorLoss());
+    if (FLAGS_eval_auc) {
+      printf(", %.4f, %.4f", train.auc, test.auc);
+    }
+    printf("\n");
   }
 
   /**
+   * Prints each thread's hardware counts for an epoch, and their total.
+   */
+  void printEpochPerfCounters(int epoch, std::vector<PerfSample> const & samples) {
+    if (samples.empty()) {
+      return;
+    }
+    PerfSample total = samples[0];
+    for (int i = 1; i < samples.size(); i++) {
+      total.add(samples[i]);
+    }
+    auto print_row = [epoch](std::string const & thread, PerfSample const & sample) {
+      printf("perf, %d, %s", epoch, thread.c_str());
+      for (int e = 0; e < kNumPerfEvents; e++) {
+        if (sample.values[e] < 0) {
+          printf(", n/a");
+        } else {
+          printf(", %lld", (long long) sample.values[e]);
+        }
+      }
+      std::int64_t const cycles = sample.values[kPerfCycles];
+      std::int64_t const instructions = sample.values[kPerfInstructions];
+      if (cycles > 0 && instructions >= 0) {
+        printf(", %.2f\n", (double) instructions / cycles);
+      } else {
+        printf(", n/a\n");
+      }
+    };
+    for (int i = 0; i < samples.size(); i++) {
+      print_row(std::to_string(i), samples[i]);
+    }
+    print_row("all", total);
+  }
+
+  /**
+   * Prints how evenly an epoch's work was spread over the threads, naming the straggler.
+   */
+  void printEpochBalance(int epoch, CycleReport const & report) {
+    VPRINTF("balance, %d, %.3f, %.3f, %.3f, %.2f, %d, %.3f, %lld, %lld, %lld, %lld\n",
+            epoch,
+            report.min_ms,
+            report.median_ms,
+            report.max_ms,
+            report.imbalance,
+            report.slowest,
+            report.max_wait_ms,
+            (long long) report.min_rows,
+            (long long) report.max_rows,
+            (long long) report.min_nonzeros,
+            (long long) report.max_nonzeros);
+  }
+
+  void printThreadReportHeaders() {
+    VPRINT("balance, epoch, min_ms, median_ms, max_ms, imbalance, slowest_thread, max_wait_ms,"
+           " min_rows, max_rows, min_nonzeros, max_nonzeros\n");
+    if (!FLAGS_perf_counters) {
+      return;
+    }
+    PerfCounters probe;
+    if (!probe.anyAvailable()) {
+      printf("Hardware performance counters are unavailable, see /proc/sys/kernel/perf_event_paranoid.\n");
+    }
+    printf("perf, epoch, thread");
+    for (int e = 0; e < kNumPerfEvents; e++) {
+      printf(", %s", PerfCounters::EventName(static_cast<PerfEvent>(e)));
+    }
+    printf(", ipc\n");
+  }
+
+  /**
+   * Prints the epoch stats of copies of the model on a background thread, so that evaluating one
+   * epoch overlaps with training the next. The evaluation runs on a pool of its own, bound to cores
+   * the training threads do not use.
+   */
+  class AsyncEpochEvaluator {
+  public:
+    AsyncEpochEvaluator(Matrix const * mat_train, Matrix const * mat_test, std::vector<int> const & cores)
+      : mat_train_(mat_train),
+        mat_test_(mat_test),
+        pool_(cores),
+        mutex_(),
+        cond_(),
+        snapshots_(),
+        done_(false),
+        thread_(&AsyncEpochEvaluator::run, this) {}
+
+    ~AsyncEpochEvaluator() {
+      finish();
+    }
+
+    /**
+     * Queues a copy of the model for evaluation. Call between epochs, while the model is not being
+     * written.
+     */
+    void submit(fvector const & theta,
+                int iteration,
+                float time_train,
+                CycleReport const & balance,
+                std::vector<PerfSample> const & perf) {
+      Snapshot snapshot(theta, iteration, time_train, balance, perf);
+      std::lock_guard<std::mutex> lock(mutex_);
+      snapshots_.push_back(std::move(snapshot));
+      cond_.notify_one();
+    }
+
+    /**
+     * Blocks until every queued model has been evaluated and printed.
+     */
+    void finish() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+        cond_.notify_one();
+      }
+      if (thread_.joinable()) {
+        thread_.join();
+      }
+    }
+
+    WorkerPool const & getPool() const {
+      return pool_;
+    }
+
+  private:
+    struct Snapshot {
+      Snapshot(fvector const & theta,
+               int iteration,
+               float time_train,
+               CycleReport const & balance,
+               std::vector<PerfSample> const & perf)
+        : theta(new fvector(theta)),
+          iteration(iteration),
+          time_train(time_train),
+          balance(balance),
+          perf(perf) {}
+
+      std::unique_ptr<fvector> theta;
+      int iteration;
+      float time_train;
+      // Of the threads which trained the epoch.
+      CycleReport balance;
+      std::vector<PerfSample> perf;
+    };
+
+    void run() {
+      // Thread pools started by this thread run on the evaluation cores.
+      WorkerPool::SetForThread(&pool_);
+      while (true) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return done_ || !snapshots_.empty(); });
+        if (snapshots_.empty()) {
+          break;
+        }
+        Snapshot snapshot = std::move(snapshots_.front());
+        snapshots_.pop_front();
+        lock.unlock();
+        printSVMEpochStats(mat_train_, mat_test_, *snapshot.theta, snapshot.iteration, snapshot.time_train);
+        printEpochBalance(snapshot.iteration, snapshot.balance);
+        printEpochPerfCounters(snapshot.iteration, snapshot.perf);
+      }
+      WorkerPool::SetForThread(nullptr);
+    }
+
+    Matrix const * mat_train_;
+    Matrix const * mat_test_;
+    WorkerPool pool_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Snapshot> snapshots_;
+    bool done_;
+    std::thread thread_;
+
+    DISABLE_COPY_AND_ASSIGN(AsyncEpochEvaluator);
+  };
+
+  /**
+   * The time and the model's quality after an epoch.
+   */
+  struct EpochMetrics {
+    EpochMetrics(double time, double train_rms_loss, double test_fraction_misclassified)
+      : time(time),
+        train_rms_loss(train_rms_loss),
+        test_fraction_misclassified(test_fraction_misclassified) {}
+
+    double time;
+    double train_rms_loss;
+    double test_fraction_misclassified;
+  };
+
+  /**
+   * @param initial_theta The model to start training from.
+   * @param shuffle If true, the threads' views visit their rows in a new order each epoch.
+   * @param replication How many copies of the model the threads train.
+   * @param metrics If not null, filled with each epoch's time and the model's quality after it.
    * @return A vector of the epoch times.
    */
   std::vector<double> trainSVM(Matrix *mat_train,
-                               Matrix *mat_test) {
-    SVMParams* svm_params = DefaultSVMParams<num_t>(mat_train->blocks_);
-    DCHECK_EQ(svm_params->degrees.size(), maxColumns(mat_train->blocks_));
-    fvector sharedTheta = fvector::GetRandomFVector(mat_train->numColumns_);
+                               Matrix *mat_test,
+                               fvector const & initial_theta,
+                               bool shuffle,
+                               ReplicationPolicy replication,
+                               std::vector<EpochMetrics> *metrics) {
+    SVMParams* svm_params = DefaultSVMParams(mat_train->getStats());
+    DCHECK_EQ(svm_params->degrees.size(), mat_train->numColumns_);
+    svm_params->minibatch_rows = FLAGS_minibatch_rows;
+    CHECK(ParseSVMLoss(FLAGS_svm_loss, &svm_params->policy.loss));
+    CHECK(ParseSVMRegularization(FLAGS_svm_regularization, &svm_params->policy.regularization));
+    CHECK(ParseUpdateConsistency(FLAGS_update_consistency, &svm_params->policy.consistency));
+    CHECK(ParseSVMOptimizer(FLAGS_svm_optimizer, &svm_params->policy.optimizer));
+    if (svm_params->policy.regularization == SVMRegularization::kLazyL2) {
+      svm_params->lazy_l2.reset(new LazyL2(mat_train->numColumns_, mat_train->numRows_,
+                                           svm_params->mu, svm_params->step_size));
+    }
+    fvector sharedTheta(initial_theta);
+    if (svm_params->policy.optimizer == SVMOptimizer::kAdaGrad) {
+      // The tasks train the interleaved model, which is copied to sharedTheta after each epoch.
+      svm_params->adagrad.reset(new AdaGradModel(sharedTheta));
+    }
+    CHECK(ParseModelPrecision(FLAGS_model_precision, &svm_params->policy.precision));
+    if (svm_params->policy.precision == ModelPrecision::kInt16) {
+      svm_params->fixed_point16.reset(new FixedPointModel<std::int16_t>(sharedTheta, FLAGS_fixed_point_range));
+    } else if (svm_params->policy.precision == ModelPrecision::kInt8) {
+      svm_params->fixed_point8.reset(new FixedPointModel<std::int8_t>(sharedTheta, FLAGS_fixed_point_range));
+    }
 
     // Arguments to the thread pool.
     std::vector<void*> threadStates;
@@ -196,51 +836,158 @@ namespace obamadb {
     // Create the tasks for the thread pool.
     // Roughly allocates work.
     std::vector<std::unique_ptr<DataView>> data_views;
-
-    allocateBlocks(FLAGS_threads, mat_train->blocks_, data_views);
+    std::unique_ptr<threading::EpochScheduler> scheduler;
+    std::unique_ptr<CycladesScheduler> cyclades;
+
+    if (useCyclades()) {
+      // The tasks train on the rows the scheduler gives them, not on their views.
+      cyclades = getCycladesScheduler(mat_train);
+      for (int i = 0; i < FLAGS_threads; i++) {
+        data_views.push_back(std::unique_ptr<DataView>(new DataView()));
+      }
+    } else if (useWorkStealing()) {
+      // Every task views all of the blocks and trains on the ranges it pulls from the scheduler.
+      int const num_blocks = mat_train->blocks_.size() + mat_train->dense_blocks_.size();
+      scheduler.reset(new threading::EpochScheduler(FLAGS_threads, num_blocks, 1));
+      for (int i = 0; i < FLAGS_threads; i++) {
+        DataView *view = new DataView();
+        for (auto block : mat_train->blocks_) {
+          view->appendBlock(block);
+        }
+        for (auto block : mat_train->dense_blocks_) {
+          view->appendBlock(block);
+        }
+        data_views.push_back(std::unique_ptr<DataView>(view));
+      }
+    } else if (mat_train->isDense()) {
+      allocateBlocks(FLAGS_threads, mat_train->dense_blocks_, mat_train->getStats(), data_views);
+    } else {
+      allocateBlocks(FLAGS_threads, mat_train->blocks_, mat_train->getStats(), data_views);
+    }
+    if (shuffle) {
+      for (int i = 0; i < data_views.size(); i++) {
+        data_views[i]->setShuffle(FLAGS_shuffle_seed * FLAGS_threads + i);
+      }
+    }
     // Create tasks
     auto update_fn = [](int tid, void* state) {
       SVMTask* task = reinterpret_cast<SVMTask*>(state);
       task->execute(tid, nullptr);
     };
+    std::unique_ptr<ModelReplicas> replicas;
+    if (replication != ReplicationPolicy::kShared && !cyclades) {
+      CHECK(!svm_params->lazy_l2) << "lazy L2 regularization keeps one clock per feature, so needs a shared model";
+      CHECK(!svm_params->adagrad) << "AdaGrad trains a model of its own, so needs a shared model";
+      CHECK(svm_params->policy.precision == ModelPrecision::kFloat32)
+        << "a fixed-point model is trained in place of the shared model, so cannot be replicated";
+      replicas.reset(new ModelReplicas(sharedTheta, AssignReplicas(replication,
+                                                                   getTrainingCores(threadFns.size()),
+                                                                   threading::getTopology())));
+    }
     std::vector<std::unique_ptr<SVMTask>> tasks(FLAGS_threads);
     for (int i = 0; i < tasks.size(); i++) {
-      tasks[i].reset(new SVMTask(data_views[i].release(), &sharedTheta, svm_params));
+      if (cyclades) {
+        tasks[i].reset(new SVMTask(data_views[i].release(), &sharedTheta, svm_params, cyclades.get(), i));
+      } else {
+        fvector *theta = replicas ? replicas->getReplica(i) : &sharedTheta;
+        tasks[i].reset(new SVMTask(data_views[i].release(), theta, svm_params, scheduler.get(), i));
+      }
+      if (replicas && FLAGS_replica_merge_rows > 0) {
+        tasks[i]->setRowCounter(replicas->getRowCounter(i));
+      }
       threadStates.push_back(tasks[i].get());
       threadFns.push_back(update_fn);
     }
 
+    std::unique_ptr<ReplicaMerger> merger;
+    if (replicas && FLAGS_replica_merge_rows > 0) {
+      merger.reset(new ReplicaMerger(replicas.get(), FLAGS_replica_merge_rows));
+      threadFns.push_back(mergerThreadFn);
+      threadStates.push_back(merger.get());
+    }
+
     ThreadPool tp(threadFns, threadStates);
 
     // If we are observing convergence, the thread pool must be referenced.
     if (observer) {
       observer->threadPool_ = &tp;
     }
+    if (merger) {
+      merger->threadPool_ = &tp;
+    }
 
     tp.begin();
 
-    VPRINT("epoch, train_time, train_fraction_misclassified, train_RMS_loss, test_fraction_misclassified, test_RMS_loss\n");
+    std::unique_ptr<AsyncEpochEvaluator> evaluator;
+    if (FLAGS_verbose && FLAGS_async_eval) {
+      evaluator.reset(new AsyncEpochEvaluator(mat_train, mat_test, getAsyncEvalCores(numEvalThreads())));
+      for (int i = 0; i < evaluator->getPool().getNumWorkers(); i++) {
+        printf("evaluation thread %d -> %s\n", i,
+               threading::getTopology().describe(evaluator->getPool().getCore(i)).c_str());
+      }
+    }
+
+    printThreadReportHeaders();
+    VPRINT("replication, epoch, granularity, replicas, merges, rows_per_second\n");
+    VPRINTF("epoch, train_time, train_fraction_misclassified, train_RMS_loss, test_fraction_misclassified,"
+            " test_RMS_loss%s\n", FLAGS_eval_auc ? ", train_AUC, test_AUC" : "");
     printSVMEpochStats(mat_train, mat_test, sharedTheta, -1, -1);
     double totalTrainTime = 0.0;
     std::vector<double> epoch_times;
+    std::unique_ptr<PrefetchTuner> prefetch_tuner = getPrefetchTuner();
     for (int cycle = 0; cycle < FLAGS_num_epochs; cycle++) {
+      svm_params->prefetch_distance = getPrefetchDistance(prefetch_tuner.get(), sizeof(num_t) * sharedTheta.dimension_);
+      int const merges_before = replicas ? replicas->getNumMerges() : 0;
+      if (merger) {
+        // The observer returns at once from every cycle after its first.
+        merger->background_threads = observer && observer->cyclesObserved_ == 0 ? 2 : 1;
+      }
       auto time_start = std::chrono::steady_clock::now();
       tp.cycle();
+      // Brings the model up to date for evaluation.
+      FinishSVMEpoch(svm_params, &sharedTheta);
+      if (replicas) {
+        replicas->average(&sharedTheta);
+      }
       auto time_end = std::chrono::steady_clock::now();
       std::chrono::duration<double, std::milli> time_ms = time_end - time_start;
       double elapsedTimeSec = (time_ms.count())/ 1e3;
       totalTrainTime += elapsedTimeSec;
-
-      printSVMEpochStats(mat_train, mat_test, sharedTheta, cycle, elapsedTimeSec);
+      recordPrefetchEpoch(prefetch_tuner.get(), cycle, svm_params->prefetch_distance, elapsedTimeSec);
+      if (cyclades) {
+        VPRINTF("cyclades, %d, %.6f\n", cycle, cyclades->takePlanSeconds());
+      }
+      VPRINTF("replication, %d, %s, %d, %d, %.0f\n",
+              cycle,
+              ReplicationPolicyName(replicas ? replication : ReplicationPolicy::kShared).c_str(),
+              replicas ? replicas->getNumReplicas() : 1,
+              replicas ? replicas->getNumMerges() - merges_before : 0,
+              mat_train->numRows_ / elapsedTimeSec);
+
+      if (evaluator) {
+        evaluator->submit(sharedTheta, cycle, elapsedTimeSec, tp.getCycleReport(), tp.getPerfSamples());
+      } else {
+        printSVMEpochStats(mat_train, mat_test, sharedTheta, cycle, elapsedTimeSec);
+        printEpochBalance(cycle, tp.getCycleReport());
+        printEpochPerfCounters(cycle, tp.getPerfSamples());
+      }
+      if (metrics != nullptr) {
+        metrics->push_back(EpochMetrics(elapsedTimeSec,
+                                        rmsErrorLoss(sharedTheta, mat_train),
+                                        fractionMisclassified(sharedTheta, mat_test)));
+      }
       epoch_times.push_back(elapsedTimeSec);
     }
     tp.stop();
+    if (evaluator) {
+      evaluator->finish();
+    }
 
     printf("num_threads,avg_train_time,frac_mispredicted_test\n");
     printf(">>>\n%d,%f,%f\n",
            (int)FLAGS_threads,
            totalTrainTime / FLAGS_num_epochs,
-           SVMTask::fractionMisclassified(sharedTheta, mat_test->blocks_));
+           fractionMisclassified(sharedTheta, mat_test));
 
     if (FLAGS_measure_convergence) {
       printf("Convergence Info (%d measures)\n", (int)observer->observedModels_.size());
@@ -251,32 +998,199 @@ namespace obamadb {
         printf("%d,%llu,%.4f,%.4f\n",
                (int)FLAGS_threads,
                timeObs,
-               SVMTask::rmsErrorLoss(thetaObs, mat_test->blocks_),
-               SVMTask::fractionMisclassified(thetaObs, mat_test->blocks_));
+               rmsErrorLoss(thetaObs, mat_test),
+               fractionMisclassified(thetaObs, mat_test));
       }
     }
     return epoch_times;
   }
 
+  /**
+   * Prints the epochs of an unshuffled and a shuffled run from the same initial model side by side.
+   */
+  void printShuffleComparison(std::vector<EpochMetrics> const & baseline,
+                              std::vector<EpochMetrics> const & shuffled) {
+    printf("shuffle, epoch, baseline_time, shuffled_time, baseline_train_RMS_loss, shuffled_train_RMS_loss,"
+           " baseline_test_fraction_misclassified, shuffled_test_fraction_misclassified\n");
+    double baseline_total = 0;
+    double shuffled_total = 0;
+    for (int e = 0; e < std::min(baseline.size(), shuffled.size()); e++) {
+      baseline_total += baseline[e].time;
+      shuffled_total += shuffled[e].time;
+      printf("shuffle, %d, %.6f, %.6f, %.4f, %.4f, %.4f, %.4f\n",
+             e,
+             baseline[e].time,
+             shuffled[e].time,
+             baseline[e].train_rms_loss,
+             shuffled[e].train_rms_loss,
+             baseline[e].test_fraction_misclassified,
+             shuffled[e].test_fraction_misclassified);
+    }
+    printf("shuffle, total, %.6f, %.6f\n", baseline_total, shuffled_total);
+  }
+
+  /**
+   * Prints the epochs of runs with each replication granularity from the same initial model.
+   */
+  void printReplicationComparison(std::vector<ReplicationPolicy> const & policies,
+                                  std::vector<std::vector<EpochMetrics>> const & runs,
+                                  int num_rows) {
+    printf("replication, granularity, epoch, time, rows_per_second, train_RMS_loss,"
+           " test_fraction_misclassified\n");
+    for (int p = 0; p < policies.size(); p++) {
+      double total = 0;
+      for (int e = 0; e < runs[p].size(); e++) {
+        EpochMetrics const & epoch = runs[p][e];
+        total += epoch.time;
+        printf("replication, %s, %d, %.6f, %.0f, %.4f, %.4f\n",
+               ReplicationPolicyName(policies[p]).c_str(),
+               e,
+               epoch.time,
+               num_rows / epoch.time,
+               epoch.train_rms_loss,
+               epoch.test_fraction_misclassified);
+      }
+      printf("replication, %s, total, %.6f\n", ReplicationPolicyName(policies[p]).c_str(), total);
+    }
+  }
+
+  /**
+   * Trains a model per setting of the sweep flag, all in one scan of the training data per epoch.
+   * @return A vector of the epoch times.
+   */
+  std::vector<double> trainSVMSweep(Matrix *mat_train, Matrix *mat_test, fvector const & initial_theta) {
+    std::vector<SVMSweepSetting> settings;
+    CHECK(ParseSVMSweep(FLAGS_svm_sweep, &settings));
+    CHECK(!useCyclades() && !useWorkStealing()) << "a sweep uses the static scheduler";
+    CHECK_EQ(1, FLAGS_minibatch_rows) << "a sweep updates the models after every row";
+    CHECK(FLAGS_replication == "shared") << "a sweep trains one copy of each model";
+    CHECK(FLAGS_update_consistency == "racy" && FLAGS_svm_optimizer == "sgd")
+      << "a sweep trains with racy plain SGD";
+    CHECK(FLAGS_model_precision == "fp32") << "a sweep trains float models";
+
+    MultiSVMModel model(initial_theta, settings.size());
+    std::unique_ptr<SVMParams> defaults(DefaultSVMParams(mat_train->getStats()));
+    MultiSVMParams params(settings, model.getStride(), defaults->step_decay, defaults->degrees);
+    CHECK(ParseSVMLoss(FLAGS_svm_loss, &params.loss));
+    CHECK(ParseSVMRegularization(FLAGS_svm_regularization, &params.regularization));
+    CHECK(params.regularization == SVMRegularization::kNone ||
+          params.regularization == SVMRegularization::kDegreeScaling)
+      << "a sweep supports no regularization or degree-scaling";
+
+    std::vector<std::unique_ptr<DataView>> data_views;
+    if (mat_train->isDense()) {
+      allocateBlocks(FLAGS_threads, mat_train->dense_blocks_, mat_train->getStats(), data_views);
+    } else {
+      allocateBlocks(FLAGS_threads, mat_train->blocks_, mat_train->getStats(), data_views);
+    }
+    if (FLAGS_shuffle) {
+      for (int i = 0; i < data_views.size(); i++) {
+        data_views[i]->setShuffle(FLAGS_shuffle_seed * FLAGS_threads + i);
+      }
+    }
+    auto update_fn = [](int tid, void* state) {
+      MultiSVMTask* task = reinterpret_cast<MultiSVMTask*>(state);
+      task->execute(tid, nullptr);
+    };
+    std::vector<std::unique_ptr<MultiSVMTask>> tasks;
+    std::vector<void*> threadStates;
+    std::vector<std::function<void(int, void*)>> threadFns;
+    for (int i = 0; i < FLAGS_threads; i++) {
+      tasks.push_back(std::unique_ptr<MultiSVMTask>(new MultiSVMTask(data_views[i].release(), &model, &params)));
+      threadStates.push_back(tasks.back().get());
+      threadFns.push_back(update_fn);
+    }
+    ThreadPool tp(threadFns, threadStates);
+    tp.begin();
+
+    printf("sweep, %d models, %d weights per feature\n", model.getNumModels(), model.getStride());
+    VPRINT("sweep, epoch, model, step_size, mu, train_time, test_fraction_misclassified\n");
+    fvector theta(initial_theta);
+    std::vector<double> epoch_times;
+    std::unique_ptr<PrefetchTuner> prefetch_tuner = getPrefetchTuner();
+    for (int cycle = 0; cycle < FLAGS_num_epochs; cycle++) {
+      params.prefetch_distance = getPrefetchDistance(prefetch_tuner.get(),
+                                                     sizeof(num_t) * model.getStride() * model.getDimension());
+      auto time_start = std::chrono::steady_clock::now();
+      tp.cycle();
+      std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - time_start;
+      recordPrefetchEpoch(prefetch_tuner.get(), cycle, params.prefetch_distance, elapsed.count());
+      epoch_times.push_back(elapsed.count());
+      if (FLAGS_verbose) {
+        for (int k = 0; k < model.getNumModels(); k++) {
+          model.copyModel(k, &theta);
+          printf("sweep, %d, %d, %g, %g, %.6f, %.4f\n", cycle, k, settings[k].step_size, settings[k].mu,
+                 elapsed.count(), fractionMisclassified(theta, mat_test));
+        }
+      }
+    }
+    tp.stop();
+
+    printf("model,step_size,mu,frac_mispredicted_test\n>>>\n");
+    for (int k = 0; k < model.getNumModels(); k++) {
+      model.copyModel(k, &theta);
+      printf("%d,%g,%g,%f\n", k, settings[k].step_size, settings[k].mu, fractionMisclassified(theta, mat_test));
+    }
+    return epoch_times;
+  }
+
   void runSvmExperiment() {
     std::unique_ptr<Matrix> mat_train;
     std::unique_ptr<Matrix> mat_test;
 
     VPRINT("Reading input files...\n");
     VPRINTF("Loading: %s\n", FLAGS_train_file.c_str());
-    PRINT_TIMING({mat_train.reset(IO::load(FLAGS_train_file));});
+    PRINT_TIMING({mat_train.reset(IO::load(FLAGS_train_file, FLAGS_stats_cache));});
     VSTREAM(*mat_train);
 
     VPRINTF("Loading: %s\n", FLAGS_test_file.c_str());
-    PRINT_TIMING({mat_test.reset(IO::load(FLAGS_test_file));});
+    PRINT_TIMING({mat_test.reset(IO::load(FLAGS_test_file, FLAGS_stats_cache));});
     VSTREAM(*mat_test);
 
+    if (FLAGS_projection_k > 0) {
+      // Both sets are projected with the same implicit matrix, identified by its seed.
+      ImplicitProjection projection(std::max(mat_train->numColumns_, mat_test->numColumns_),
+                                    FLAGS_projection_k,
+                                    FLAGS_projection_seed);
+      double const density = mat_train->expectedProjectedDensity(projection);
+      bool const dense = density > FLAGS_projection_dense_threshold;
+      VPRINTF("Projecting to %d columns, expected density %.3f, storing as %s\n",
+              (int) FLAGS_projection_k, density, dense ? "dense" : "sparse");
+      PRINT_TIMING({mat_train.reset(mat_train->randomProjectionsCompress(projection, dense));});
+      VSTREAM(*mat_train);
+      PRINT_TIMING({mat_test.reset(mat_test->randomProjectionsCompress(projection, dense));});
+      VSTREAM(*mat_test);
+    }
+
     CHECK_EQ(mat_test->numColumns_, mat_train->numColumns_)
       << "Train and Test matrices had differing number of features.";
 
+    ReplicationPolicy replication;
+    CHECK(ParseReplicationPolicy(FLAGS_replication, &replication));
     std::vector<double> all_epoch_times;
     for (int i = 0; i < FLAGS_num_trials; i++) {
-      std::vector<double> times = trainSVM(mat_train.get(), mat_test.get());
+      fvector const initial_theta = fvector::GetRandomFVector(mat_train->numColumns_);
+      std::vector<double> times;
+      if (!FLAGS_svm_sweep.empty()) {
+        times = trainSVMSweep(mat_train.get(), mat_test.get(), initial_theta);
+      } else if (FLAGS_replication_compare) {
+        std::vector<ReplicationPolicy> const policies = {ReplicationPolicy::kShared,
+                                                         ReplicationPolicy::kPerSocket,
+                                                         ReplicationPolicy::kPerCore};
+        std::vector<std::vector<EpochMetrics>> runs(policies.size());
+        for (int p = 0; p < policies.size(); p++) {
+          times = trainSVM(mat_train.get(), mat_test.get(), initial_theta, FLAGS_shuffle, policies[p], &runs[p]);
+        }
+        printReplicationComparison(policies, runs, mat_train->numRows_);
+      } else if (FLAGS_shuffle_compare) {
+        std::vector<EpochMetrics> baseline;
+        std::vector<EpochMetrics> shuffled;
+        trainSVM(mat_train.get(), mat_test.get(), initial_theta, false, replication, &baseline);
+        times = trainSVM(mat_train.get(), mat_test.get(), initial_theta, true, replication, &shuffled);
+        printShuffleComparison(baseline, shuffled);
+      } else {
+        times = trainSVM(mat_train.get(), mat_test.get(), initial_theta, FLAGS_shuffle, replication, nullptr);
+      }
       all_epoch_times.insert(all_epoch_times.end(), times.begin(), times.end());
 
       if (FLAGS_num_trials != i -1) {
@@ -322,10 +1236,18 @@ namespace obamadb {
       MCTask* task = reinterpret_cast<MCTask*>(state);
       task->execute(tid, nullptr);
     };
+    std::unique_ptr<threading::EpochScheduler> scheduler;
+    if (useWorkStealing()) {
+      // Several ranges of examples per thread leave room to even out the threads' epochs.
+      int const num_examples = train_matrix->numElements();
+      int const grain = std::max(1, num_examples / (int) (FLAGS_threads * kStealingItemsPerThread));
+      scheduler.reset(new threading::EpochScheduler(FLAGS_threads, num_examples, grain));
+    }
+
     std::vector<std::unique_ptr<MCTask>> tasks(FLAGS_threads);
     std::vector<void*> tp_states;
     for (int i = 0; i < tasks.size(); i++) {
-      tasks[i].reset(new MCTask(FLAGS_threads, train_matrix, mcstate.get()));
+      tasks[i].reset(new MCTask(FLAGS_threads, train_matrix, mcstate.get(), scheduler.get()));
       tp_states.push_back(tasks[i].get());
       threadFns.push_back(update_fn);
     }
@@ -333,19 +1255,26 @@ namespace obamadb {
     ThreadPool tp(threadFns, tp_states);
     tp.begin();
 
+    printThreadReportHeaders();
     VPRINT("epoch, train_time, probe_RMS_loss\n");
     printMCEpochStats(-1, -1, mcstate.get(), probe_matrix);
     double totalTrainTime = 0.0;
     std::vector<double> epoch_times;
+    std::unique_ptr<PrefetchTuner> prefetch_tuner = getPrefetchTuner();
     for (int cycle = 0; cycle < FLAGS_num_epochs; cycle++) {
+      mcstate->prefetch_distance = getPrefetchDistance(prefetch_tuner.get(),
+                                                       sizeof(num_t) * (mcstate->mat_l->getSize() + mcstate->mat_r->getSize()));
       auto time_start = std::chrono::steady_clock::now();
       tp.cycle();
       auto time_end = std::chrono::steady_clock::now();
       std::chrono::duration<double, std::milli> time_ms = time_end - time_start;
       double elapsedTimeSec = (time_ms.count())/ 1e3;
       totalTrainTime += elapsedTimeSec;
+      recordPrefetchEpoch(prefetch_tuner.get(), cycle, mcstate->prefetch_distance, elapsedTimeSec);
 
       printMCEpochStats(cycle, elapsedTimeSec, mcstate.get(), probe_matrix);
+      printEpochBalance(cycle, tp.getCycleReport());
+      printEpochPerfCounters(cycle, tp.getPerfSamples());
       epoch_times.push_back(elapsedTimeSec);
     }
     tp.stop();
@@ -393,11 +1322,36 @@ namespace obamadb {
            stats::stderr<double>(all_epoch_times));
   }
 
+  /**
+   * Prints which cpu each training thread runs on, so that scaling runs can be reproduced.
+   */
+  void printWorkerPlacement(WorkerPool const & pool) {
+    threading::CpuTopology const & topology = threading::getTopology();
+    printf("topology: %d cpus, %d physical cores, %d sockets\n",
+           topology.numCpus(), topology.numPhysicalCores(), topology.numSockets());
+    printf("placement: %s\n",
+           FLAGS_core_affinities.compare("-1") == 0 ? FLAGS_placement.c_str() : "core_affinities");
+    // The SVM convergence observer runs on the first worker, ahead of the training threads.
+    int const first_trainer = FLAGS_algorithm.compare("svm") == 0 && FLAGS_measure_convergence ? 1 : 0;
+    if (first_trainer > 0) {
+      printf("observer (worker 0) -> %s\n", topology.describe(pool.getCore(0)).c_str());
+    }
+    for (int i = 0; i < std::min<int>(FLAGS_threads, pool.getNumWorkers() - first_trainer); i++) {
+      int const worker = first_trainer + i;
+      printf("thread %d (worker %d) -> %s\n", i, worker, topology.describe(pool.getCore(worker)).c_str());
+    }
+  }
+
   int main(int argc, char** argv) {
     ::google::InitGoogleLogging(argv[0]);
     ::gflags::SetUsageMessage(std::string(argv[0]) + " -help");
     ::gflags::SetVersionString("0.0");
     ::gflags::ParseCommandLineFlags(&argc, &argv, true);
+    threading::setDefaultBarrierSpinBudget(FLAGS_barrier_spin_budget);
+    threading::PlacementPolicy placement;
+    CHECK(threading::ParsePlacementPolicy(FLAGS_placement, &placement));
+    threading::setPlacementPolicy(placement);
+    threading::setPerfCountersEnabled(FLAGS_perf_counters);
 
     std::vector<int> affinities = GetIntList(FLAGS_core_affinities);
     if (affinities[0] != -1) {
@@ -407,6 +1361,13 @@ namespace obamadb {
       threading::setCoreAffinity(0);
     }
 
+    // Every stage (loading statistics, projection, training) runs its parallel work on this pool, so
+    // threads are created and bound to cores once. Sized for the training threads plus an observer
+    // and a replica merger, and for the stages which use a thread per core.
+    WorkerPool pool(std::max<int>(FLAGS_threads + 2, threading::numCores()));
+    WorkerPool::SetGlobal(&pool);
+    printWorkerPlacement(pool);
+
     if (FLAGS_algorithm.compare("svm") == 0) {
       runSvmExperiment();
     } else if (FLAGS_algorithm.compare("mc") == 0) {
@@ -417,6 +1378,7 @@ namespace obamadb {
       LOG(FATAL) << "unknown training algorithm";
     }
 
+    WorkerPool::SetGlobal(nullptr);
     return 0;
   }
 } // namespace obamadb
@@ -0,0 +1,203 @@
+#include "storage/Cyclades.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "glog/logging.h"
+
+namespace obamadb {
+
+  namespace {
+    std::vector<RowSlice> getChunks(std::vector<SparseDataBlock<num_t>*> const & blocks) {
+      std::vector<RowSlice> chunks;
+      for (int b = 0; b < blocks.size(); b++) {
+        int const num_rows = blocks[b]->getNumRows();
+        for (int begin = 0; begin < num_rows; begin += kCycladesChunkRows) {
+          chunks.push_back(RowSlice(b, begin, std::min(num_rows, begin + kCycladesChunkRows)));
+        }
+      }
+      return chunks;
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+      std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+      return elapsed.count();
+    }
+  }
+
+  double CycladesExpectedConflicts(MatrixStats const & stats, int batch_rows) {
+    double const num_rows = stats.numRows();
+    if (num_rows < 2) {
+      return 0;
+    }
+    // A row shares feature f with degree(f) - 1 other rows, each in the batch with probability
+    // (batch_rows - 1) / (num_rows - 1). Averaged over the rows, f is in degree(f) / num_rows of them.
+    double pairs = 0;
+    for (int degree : stats.degrees) {
+      pairs += static_cast<double>(degree) * (degree - 1);
+    }
+    return pairs / num_rows * (batch_rows - 1) / (num_rows - 1);
+  }
+
+  int CycladesBatchRows(MatrixStats const & stats, double conflicts_per_row) {
+    int const num_rows = stats.numRows();
+    double const per_row = CycladesExpectedConflicts(stats, 2);
+    if (per_row <= 0) {
+      return std::max(1, num_rows);
+    }
+    double const batch_rows = 1 + conflicts_per_row / per_row;
+    return static_cast<int>(std::max(1.0, std::min<double>(num_rows, batch_rows)));
+  }
+
+  CycladesScheduler::CycladesScheduler(int num_workers,
+                                       std::vector<SparseDataBlock<num_t>*> const & blocks,
+                                       int num_columns,
+                                       int batch_rows,
+                                       std::uint64_t seed)
+    : num_workers_(num_workers),
+      blocks_(blocks),
+      num_columns_(num_columns),
+      chunks_(getChunks(blocks)),
+      batch_chunks_(std::max(1, (batch_rows + kCycladesChunkRows - 1) / kCycladesChunkRows)),
+      num_batches_((chunks_.size() + batch_chunks_ - 1) / batch_chunks_),
+      seed_(seed),
+      draws_(0),
+      parents_(new std::atomic<int>[num_columns]),
+      workers_(num_workers),
+      barrier_(num_workers) {
+    CHECK_LT(0, num_workers);
+    for (int f = 0; f < num_columns_; f++) {
+      parents_[f].store(f, std::memory_order_relaxed);
+    }
+    for (Worker & worker : workers_) {
+      worker.outboxes.resize(num_workers_);
+    }
+    shuffleChunks();
+  }
+
+  bool CycladesScheduler::nextBatch(int worker) {
+    DCHECK_LT(worker, num_workers_);
+    Worker & self = workers_[worker];
+    // The features of a component were only touched by the worker it was given to, so the workers
+    // can release their last batch's features concurrently.
+    releaseFeatures(self.rows);
+    self.rows.clear();
+    if (self.batch == num_batches_) {
+      self.batch = 0;
+      if (worker == 0) {
+        // No worker reads the order until the next epoch's first batch, after the barrier.
+        shuffleChunks();
+      }
+      barrier_.wait();
+      return false;
+    }
+    barrier_.wait();
+
+    auto start = std::chrono::steady_clock::now();
+    int const first_chunk = self.batch * batch_chunks_;
+    int const num_chunks = std::min<int>(chunks_.size() - first_chunk, batch_chunks_);
+    std::pair<int, int> const share = EvenSplit(num_chunks, num_workers_, worker);
+    svector<num_t> row(0, nullptr);
+    // Rows which share a feature join a component through it.
+    for (int c = first_chunk + share.first; c < first_chunk + share.second; c++) {
+      RowSlice const & chunk = chunks_[c];
+      for (int r = chunk.begin; r < chunk.end; r++) {
+        blocks_[chunk.block]->getRowVectorFast(r, &row);
+        for (int i = 1; i < row.num_elements_; i++) {
+          unite(row.index_[0], row.index_[i]);
+        }
+      }
+    }
+    self.plan_seconds += secondsSince(start);
+    barrier_.wait();
+
+    start = std::chrono::steady_clock::now();
+    for (int c = first_chunk + share.first; c < first_chunk + share.second; c++) {
+      RowSlice const & chunk = chunks_[c];
+      for (int r = chunk.begin; r < chunk.end; r++) {
+        blocks_[chunk.block]->getRowVectorFast(r, &row);
+        // A row without features conflicts with nothing, so it stays with this worker.
+        int const owner = row.num_elements_ == 0
+                          ? worker
+                          : static_cast<int>(hashInt64(find(row.index_[0])) % num_workers_);
+        self.outboxes[owner].push_back(BatchRow(chunk.block, r));
+      }
+    }
+    self.plan_seconds += secondsSince(start);
+    barrier_.wait();
+
+    start = std::chrono::steady_clock::now();
+    // Each outbox is read and emptied only by its destination, and not written again until the
+    // next batch.
+    for (Worker & sender : workers_) {
+      std::vector<BatchRow> & outbox = sender.outboxes[worker];
+      self.rows.insert(self.rows.end(), outbox.begin(), outbox.end());
+      outbox.clear();
+    }
+    self.batch++;
+    self.plan_seconds += secondsSince(start);
+    return true;
+  }
+
+  double CycladesScheduler::takePlanSeconds() {
+    double seconds = 0;
+    for (Worker & worker : workers_) {
+      seconds += worker.plan_seconds;
+      worker.plan_seconds = 0;
+    }
+    return seconds / num_workers_;
+  }
+
+  int CycladesScheduler::find(int feature) {
+    while (true) {
+      int parent = parents_[feature].load(std::memory_order_relaxed);
+      if (parent == feature) {
+        return feature;
+      }
+      int const grandparent = parents_[parent].load(std::memory_order_relaxed);
+      if (grandparent != parent) {
+        // Path halving. Failing only means another thread moved the feature closer to its root.
+        parents_[feature].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+      }
+      feature = grandparent;
+    }
+  }
+
+  void CycladesScheduler::unite(int a, int b) {
+    while (true) {
+      a = find(a);
+      b = find(b);
+      if (a == b) {
+        return;
+      }
+      // Linking the higher root under the lower one cannot form a cycle.
+      if (a < b) {
+        std::swap(a, b);
+      }
+      int expected = a;
+      if (parents_[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+
+  void CycladesScheduler::releaseFeatures(std::vector<BatchRow> const & rows) {
+    svector<num_t> row(0, nullptr);
+    for (BatchRow const & batch_row : rows) {
+      getRow(batch_row, &row);
+      for (int i = 0; i < row.num_elements_; i++) {
+        parents_[row.index_[i]].store(row.index_[i], std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void CycladesScheduler::shuffleChunks() {
+    // Fisher-Yates, drawing from a hash of the seed and a counter.
+    for (int i = static_cast<int>(chunks_.size()) - 1; i > 0; i--) {
+      std::uint64_t const draw = hashInt64(seed_ + draws_++);
+      std::swap(chunks_[i], chunks_[draw % (i + 1)]);
+    }
+  }
+
+} // namespace obamadb
@@ -0,0 +1,161 @@
+#ifndef OBAMADB_CYCLADES_H_
+#define OBAMADB_CYCLADES_H_
+
+#include "storage/exvector.h"
+#include "storage/MatrixStats.h"
+#include "storage/Partitioner.h"
+#include "storage/SparseDataBlock.h"
+#include "storage/StorageConstants.h"
+#include "storage/ThreadPool.h"
+#include "storage/Utils.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace obamadb {
+
+  // Batches are sampled in runs of this many consecutive rows of a block, so that planning and
+  // training read the data mostly sequentially.
+  int const kCycladesChunkRows = 16;
+
+  // The number of other rows of its batch a row is expected to share a feature with when batches
+  // are sized automatically. Below 1 the conflict graph of a batch breaks into many small components.
+  double const kCycladesConflictsPerRow = 0.9;
+
+  /**
+   * A row of a block.
+   */
+  struct BatchRow {
+    BatchRow(int block, int row)
+      : block(block), row(row) {}
+
+    int block;
+    int row;
+  };
+
+  /**
+   * @return The number of other rows of a batch of the given size which a row is expected to share
+   *         at least one feature with, bounded above by counting each shared feature separately.
+   */
+  double CycladesExpectedConflicts(MatrixStats const & stats, int batch_rows);
+
+  /**
+   * @return The largest batch in which a row is expected to conflict with at most the given number
+   *         of other rows, at least 1 row.
+   */
+  int CycladesBatchRows(MatrixStats const & stats, double conflicts_per_row);
+
+  /**
+   * Schedules an epoch of SGD so that threads never update the same feature at once (Cyclades,
+   * Pan et al. 2016). The rows of an epoch are sampled, without replacement, into batches. Two rows
+   * of a batch conflict if they share a feature, and every connected component of the batch's
+   * conflict graph is given whole to one worker. Workers train on their components concurrently and
+   * then meet at a barrier before the next batch, so no update is lost to another thread.
+   *
+   * The components are found by all the workers together with a lock-free union-find over the
+   * features: each worker unites the features of its share of the batch's rows, then looks up the
+   * component of each of those rows and sends it to the component's worker. This costs a pass over
+   * the batch's nonzeros, spread over the workers, and three barriers per batch.
+   */
+  class CycladesScheduler {
+  public:
+    /**
+     * @param num_workers The number of workers which call nextBatch() together.
+     * @param blocks The training rows.
+     * @param num_columns The number of features.
+     * @param batch_rows The number of rows per batch, rounded up to whole chunks.
+     * @param seed Seeds the order in which rows are sampled into batches each epoch.
+     */
+    CycladesScheduler(int num_workers,
+                      std::vector<SparseDataBlock<num_t>*> const & blocks,
+                      int num_columns,
+                      int batch_rows,
+                      std::uint64_t seed);
+
+    /**
+     * Plans the next batch of the epoch. Every worker must call this until it returns false, and
+     * each call waits for all the workers to arrive, so a worker must have finished training on its
+     * rows of the last batch before it asks for the next.
+     * @param worker The id of the calling worker.
+     * @return False once the epoch has no batches left. The next call starts a new epoch.
+     */
+    bool nextBatch(int worker);
+
+    /**
+     * @return The worker's rows of the current batch. Rows of the same component are in sample order.
+     */
+    std::vector<BatchRow> const & getRows(int worker) const {
+      return workers_[worker].rows;
+    }
+
+    void getRow(BatchRow const & batch_row, svector<num_t> *row) const {
+      blocks_[batch_row.block]->getRowVectorFast(batch_row.row, row);
+    }
+
+    int getNumWorkers() const {
+      return num_workers_;
+    }
+
+    int getBatchRows() const {
+      return batch_chunks_ * kCycladesChunkRows;
+    }
+
+    int getNumBatches() const {
+      return num_batches_;
+    }
+
+    /**
+     * Must not be called while workers are planning.
+     * @return The mean time per worker spent finding components since the last call, excluding
+     *         time waiting at barriers.
+     */
+    double takePlanSeconds();
+
+  private:
+    struct Worker {
+      Worker() : batch(0), plan_seconds(0) {}
+
+      // The next batch of the epoch.
+      int batch;
+      // This worker's rows of the batch, by the worker whose component they belong to.
+      std::vector<std::vector<BatchRow>> outboxes;
+      // The rows given to this worker.
+      std::vector<BatchRow> rows;
+      double plan_seconds;
+      char padding[64];
+    };
+
+    int find(int feature);
+
+    void unite(int a, int b);
+
+    /**
+     * Returns the features of the rows to their own components.
+     */
+    void releaseFeatures(std::vector<BatchRow> const & rows);
+
+    void shuffleChunks();
+
+    int const num_workers_;
+    std::vector<SparseDataBlock<num_t>*> const blocks_;
+    int const num_columns_;
+    // Chunks in the epoch's sample order.
+    std::vector<RowSlice> chunks_;
+    int const batch_chunks_;
+    int const num_batches_;
+    std::uint64_t const seed_;
+    std::uint64_t draws_;
+    // The union-find forest over the features. A root is its own parent, and a parent always has a
+    // lower id than its child.
+    std::unique_ptr<std::atomic<int>[]> parents_;
+    std::vector<Worker> workers_;
+    threading::barrier_t barrier_;
+
+    DISABLE_COPY_AND_ASSIGN(CycladesScheduler);
+  };
+
+} // namespace obamadb
+
+#endif //OBAMADB_CYCLADES_H_
@@ -1 +1,52 @@
 #include "DataView.h"
+
+namespace obamadb {
+
+  namespace {
+    // The rows of a block are shuffled in chunks of this many consecutive rows.
+    int const kShuffleChunkRows = 32;
+  }
+
+  void DataView::reset() {
+    runs_.clear();
+    int const last_block = lastBlock(numBlocks());
+    if (!shuffle_) {
+      for (int b = begin_block_; b <= last_block; b++) {
+        runs_.push_back(Run(b, row_ranges_[b].first, row_ranges_[b].second));
+      }
+    } else {
+      std::vector<int> blocks;
+      for (int b = begin_block_; b <= last_block; b++) {
+        blocks.push_back(b);
+      }
+      shuffle(&blocks);
+      std::vector<int> chunks;
+      for (int b : blocks) {
+        int const begin = row_ranges_[b].first;
+        int const end = row_ranges_[b].second;
+        chunks.clear();
+        for (int c = 0; c < (end - begin + kShuffleChunkRows - 1) / kShuffleChunkRows; c++) {
+          chunks.push_back(c);
+        }
+        shuffle(&chunks);
+        for (int c : chunks) {
+          int const chunk_begin = begin + c * kShuffleChunkRows;
+          runs_.push_back(Run(b, chunk_begin, std::min(end, chunk_begin + kShuffleChunkRows)));
+        }
+      }
+    }
+    planned_ = true;
+    current_run_ = -1;
+    current_idx_ = 0;
+    current_end_ = 0;
+  }
+
+  void DataView::shuffle(std::vector<int> *values) {
+    // Fisher-Yates, drawing from a hash of the seed and a counter.
+    for (int i = static_cast<int>(values->size()) - 1; i > 0; i--) {
+      std::uint64_t const draw = hashInt64(shuffle_seed_ + shuffle_draws_++);
+      std::swap((*values)[i], (*values)[draw % (i + 1)]);
+    }
+  }
+
+}
@@ -2,53 +2,358 @@
 #define OBAMADB_DATAVIEW_H_
 
 #include "storage/DataBlock.h"
+#include "storage/DenseDataBlock.h"
 #include "storage/exvector.h"
 #include "storage/SparseDataBlock.h"
 #include "storage/StorageConstants.h"
+#include "storage/Utils.h"
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
 #include <vector>
 
 namespace obamadb {
 
+  /**
+   * Up to kMaxRows consecutive rows of a sparse block, read in one call.
+   */
+  struct SparseRowBatch {
+    static int const kMaxRows = 64;
+
+    int const * index(int r) const {
+      return indexes[r];
+    }
+
+    num_t const * row(int r) const {
+      return values[r];
+    }
+
+    int length(int r) const {
+      return lengths[r];
+    }
+
+    num_t label(int r) const {
+      return labels[r];
+    }
+
+    int size;
+    int const * indexes[kMaxRows];
+    num_t const * values[kMaxRows];
+    int lengths[kMaxRows];
+    num_t labels[kMaxRows];
+  };
+
+  /**
+   * Up to kMaxRows consecutive rows of a dense block. The rows are stored one after another, each
+   * followed by its label, so only the first row is recorded.
+   */
+  struct DenseRowBatch {
+    static int const kMaxRows = 64;
+
+    /**
+     * Dense rows have no index; value i belongs to column i.
+     */
+    std::nullptr_t index(int r) const {
+      (void) r;
+      return nullptr;
+    }
+
+    num_t const * row(int r) const {
+      return values + r * (num_columns + 1);
+    }
+
+    int length(int r) const {
+      (void) r;
+      return num_columns;
+    }
+
+    num_t label(int r) const {
+      return row(r)[num_columns];
+    }
+
+    int size;
+    int num_columns;
+    num_t const * values;
+  };
+
   class DataView {
   public:
     DataView(std::vector<SparseDataBlock<num_t> const *> blocks)
-      : blocks_(blocks), current_block_(0),current_idx_(0) {}
+      : DataView() {
+      for (auto block : blocks) {
+        appendBlock(block);
+      }
+    }
 
-    DataView() : blocks_(), current_block_(0), current_idx_(0) {}
+    DataView()
+      : blocks_(),
+        dense_blocks_(),
+        row_ranges_(),
+        begin_block_(0),
+        end_block_(-1),
+        shuffle_(false),
+        shuffle_seed_(0),
+        shuffle_draws_(0),
+        runs_(),
+        planned_(false),
+        current_run_(-1),
+        current_block_(0),
+        current_idx_(0),
+        current_end_(0) {}
 
     inline bool getNext(svector<num_t> * row) {
-      if (current_idx_ < blocks_[current_block_]->num_rows_) {
-        blocks_[current_block_]->getRowVectorFast(current_idx_++, row);
-        return true;
-      } else if (current_block_ < blocks_.size() - 1) {
-        current_block_++;
-        current_idx_ = 0;
-        return getNext(row);
+      while (current_idx_ >= current_end_) {
+        if (!nextRun()) {
+          return false;
+        }
+      }
+      blocks_[current_block_]->getRowVectorFast(current_idx_++, row);
+      return true;
+    }
+
+    /**
+     * Iterates over the rows of a view of dense blocks.
+     */
+    inline bool getNext(dvector<num_t> * row) {
+      while (current_idx_ >= current_end_) {
+        if (!nextRun()) {
+          return false;
+        }
+      }
+      dense_blocks_[current_block_]->getRowVectorFast(current_idx_++, row);
+      return true;
+    }
+
+    /**
+     * Reads a row ahead of the iteration without moving it, e.g. to prefetch what it will touch.
+     * @param distance 1 is the row the next getNext() returns.
+     * @return False if the row is beyond the current and the next run of rows.
+     */
+    inline bool peek(int distance, svector<num_t> * row) const {
+      int block = current_block_;
+      int idx = current_idx_ + distance - 1;
+      if (idx >= current_end_) {
+        if (current_run_ + 1 >= static_cast<int>(runs_.size())) {
+          return false;
+        }
+        Run const & next = runs_[current_run_ + 1];
+        block = next.block;
+        idx = next.begin + (idx - current_end_);
+        if (idx >= next.end) {
+          return false;
+        }
       }
+      blocks_[block]->getRowVectorFast(idx, row);
+      return true;
+    }
 
-      return false;
+    /**
+     * Reads up to max_rows of the next rows at once. The rows all come from the same run of one
+     * block, so a batch may hold fewer rows even when more remain.
+     * @param max_rows Must be positive.
+     * @return False once there are no rows left.
+     */
+    inline bool getNextBatch(int max_rows, SparseRowBatch * batch) {
+      while (current_idx_ >= current_end_) {
+        if (!nextRun()) {
+          return false;
+        }
+      }
+      int const size = batchSize(max_rows, SparseRowBatch::kMaxRows);
+      SparseDataBlock<num_t> const * block = blocks_[current_block_];
+      svector<num_t> row(0, nullptr);
+      for (int r = 0; r < size; r++) {
+        block->getRowVectorFast(current_idx_ + r, &row);
+        batch->indexes[r] = row.index_;
+        batch->values[r] = row.values_;
+        batch->lengths[r] = row.num_elements_;
+        batch->labels[r] = *row.class_;
+      }
+      batch->size = size;
+      current_idx_ += size;
+      return true;
+    }
+
+    inline bool getNextBatch(int max_rows, DenseRowBatch * batch) {
+      while (current_idx_ >= current_end_) {
+        if (!nextRun()) {
+          return false;
+        }
+      }
+      int const size = batchSize(max_rows, DenseRowBatch::kMaxRows);
+      dvector<num_t> row(0, nullptr);
+      dense_blocks_[current_block_]->getRowVectorFast(current_idx_, &row);
+      batch->values = row.values_;
+      batch->num_columns = row.num_elements_;
+      batch->size = size;
+      current_idx_ += size;
+      return true;
     }
 
     void appendBlock(SparseDataBlock<num_t> const * block) {
+      appendBlock(block, 0, block->num_rows_);
+    }
+
+    void appendBlock(DenseDataBlock<num_t> const * block) {
+      appendBlock(block, 0, block->num_rows_);
+    }
+
+    /**
+     * Appends the rows [begin_row, end_row) of a block, so that a block may be split between views.
+     */
+    void appendBlock(SparseDataBlock<num_t> const * block, int begin_row, int end_row) {
+      DCHECK(dense_blocks_.empty()) << "A view holds either sparse or dense blocks.";
+      DCHECK_LE(0, begin_row);
+      DCHECK_LE(begin_row, end_row);
+      DCHECK_LE(end_row, block->num_rows_);
       blocks_.push_back(block);
+      row_ranges_.push_back(std::make_pair(begin_row, end_row));
+      planned_ = false;
+    }
+
+    void appendBlock(DenseDataBlock<num_t> const * block, int begin_row, int end_row) {
+      DCHECK(blocks_.empty()) << "A view holds either sparse or dense blocks.";
+      DCHECK_LE(0, begin_row);
+      DCHECK_LE(begin_row, end_row);
+      DCHECK_LE(end_row, block->num_rows_);
+      dense_blocks_.push_back(block);
+      row_ranges_.push_back(std::make_pair(begin_row, end_row));
+      planned_ = false;
+    }
+
+    /**
+     * @return True if the view's blocks are dense, and so should be read with getNext(dvector*).
+     */
+    bool isDense() const {
+      return !dense_blocks_.empty();
+    }
+
+    /**
+     * @return The number of blocks, or slices of blocks, in the view, regardless of the range being
+     *         iterated.
+     */
+    int numBlocks() const {
+      return blocks_.size() + dense_blocks_.size();
+    }
+
+    /**
+     * Restricts iteration to the blocks [begin, end) and rewinds to the first row of begin.
+     */
+    void setBlockRange(int begin, int end) {
+      DCHECK_LE(0, begin);
+      DCHECK_LT(begin, end);
+      DCHECK_LE(end, numBlocks());
+      begin_block_ = begin;
+      end_block_ = end;
+      reset();
+    }
+
+    /**
+     * Visits the rows in a different order after each reset. The order of the blocks is permuted,
+     * and so is the order of the chunks of consecutive rows within each block, while the rows of a
+     * chunk are read in storage order. The data is not moved, and reads stay mostly sequential.
+     *
+     * @param seed Seeds the view's permutations, so that a run can be repeated.
+     */
+    void setShuffle(std::uint64_t seed) {
+      shuffle_ = true;
+      shuffle_seed_ = hashInt64(seed);
+      shuffle_draws_ = 0;
+      planned_ = false;
+    }
+
+    bool isShuffled() const {
+      return shuffle_;
     }
 
     void clear() {
       blocks_.clear();
+      dense_blocks_.clear();
+      row_ranges_.clear();
+      begin_block_ = 0;
+      end_block_ = -1;
+      planned_ = false;
     }
 
-    inline void reset() {
-      current_block_ = 0;
-      current_idx_ = 0;
-    }
+    /**
+     * Rewinds to the start of the range, which starts a new epoch's order if the view is shuffled.
+     */
+    void reset();
 
   protected:
+    /**
+     * A run of rows of one block which are visited in storage order.
+     */
+    struct Run {
+      Run(int block, int begin, int end)
+        : block(block), begin(begin), end(end) {}
+
+      int block;
+      int begin;
+      int end;
+    };
+
+    /**
+     * @return The index of the last block to iterate over.
+     */
+    inline int lastBlock(int num_blocks) const {
+      return (end_block_ < 0 ? num_blocks : end_block_) - 1;
+    }
+
+    /**
+     * Moves to the next run of the epoch.
+     * @return False when every run has been visited.
+     */
+    inline bool nextRun() {
+      if (!planned_) {
+        reset();
+      }
+      if (current_run_ + 1 >= static_cast<int>(runs_.size())) {
+        return false;
+      }
+      Run const & run = runs_[++current_run_];
+      current_block_ = run.block;
+      current_idx_ = run.begin;
+      current_end_ = run.end;
+      return true;
+    }
+
+    /**
+     * @return How many rows the next batch holds, which are all in the current run.
+     */
+    inline int batchSize(int max_rows, int capacity) const {
+      // An empty batch would not advance the view, so a caller looping over batches would spin.
+      DCHECK_GT(max_rows, 0);
+      int const rows = max_rows < capacity ? max_rows : capacity;
+      return current_end_ - current_idx_ < rows ? current_end_ - current_idx_ : rows;
+    }
+
+    /**
+     * Shuffles the values with the view's seeded generator.
+     */
+    void shuffle(std::vector<int> *values);
 
     std::vector<SparseDataBlock<num_t> const *> blocks_;
+    std::vector<DenseDataBlock<num_t> const *> dense_blocks_;
+    // The rows [first, second) of each block which belong to the view.
+    std::vector<std::pair<int, int>> row_ranges_;
+    // Iteration covers [begin_block_, end_block_), where an end of -1 means every block.
+    int begin_block_;
+    int end_block_;
+
+    bool shuffle_;
+    std::uint64_t shuffle_seed_;
+    std::uint64_t shuffle_draws_;
+
+    // The order of the current epoch, planned by reset().
+    std::vector<Run> runs_;
+    bool planned_;
+    int current_run_;
     int current_block_;
     int current_idx_;
+    int current_end_;
   };
 }
 
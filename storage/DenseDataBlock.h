@@ -92,6 +92,20 @@ namespace obamadb {
       return get(row, col);
     }
 
+    /**
+     * @return Number of non zero elements. Does not include classification column.
+     */
+    int numNonZeroElements() const {
+      int nnz = 0;
+      for (int row = 0; row < this->num_rows_; row++) {
+        T const *values = this->store_ + (this->sizeRow() * row);
+        for (int column = 0; column < this->num_columns_; column++) {
+          nnz += values[column] != 0;
+        }
+      }
+      return nnz;
+    }
+
     inline int numElements() const {
       return this->num_rows_ * this->sizeRow();
     }
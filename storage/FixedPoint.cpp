@@ -0,0 +1,206 @@
+#include "storage/FixedPoint.h"
+
+#include "storage/SparseDot.h"
+
+#include <cmath>
+#include <map>
+
+#include "glog/logging.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OBAMADB_X86 1
+#include <immintrin.h>
+#else
+#define OBAMADB_X86 0
+#endif
+
+namespace obamadb {
+
+  bool ParseModelPrecision(std::string const & name, ModelPrecision *precision) {
+    static std::map<std::string, ModelPrecision> const kPrecisions = {
+      {"fp32", ModelPrecision::kFloat32},
+      {"int16", ModelPrecision::kInt16},
+      {"int8", ModelPrecision::kInt8},
+    };
+    auto it = kPrecisions.find(name);
+    if (it == kPrecisions.end()) {
+      return false;
+    }
+    *precision = it->second;
+    return true;
+  }
+
+  std::string ModelPrecisionName(ModelPrecision precision) {
+    switch (precision) {
+      case ModelPrecision::kFloat32:
+        return "fp32";
+      case ModelPrecision::kInt16:
+        return "int16";
+      case ModelPrecision::kInt8:
+        return "int8";
+    }
+    return "unknown";
+  }
+
+  template<class T>
+  FixedPointModel<T>::FixedPointModel(fvector const & theta, float range)
+    : dimension_(theta.dimension_),
+      resolution_(range / std::numeric_limits<T>::max()),
+      values_(theta.dimension_ + kFixedPointPadding, 0),
+      seeds_(0) {
+    CHECK_LT(0, range);
+    int const limit = std::numeric_limits<T>::max();
+    for (int i = 0; i < dimension_; i++) {
+      float const steps = std::round(theta.values_[i] / resolution_);
+      values_[i] = static_cast<T>(std::max<float>(-limit, std::min<float>(limit, steps)));
+    }
+  }
+
+  template<class T>
+  void FixedPointModel<T>::copyWeights(fvector *theta) const {
+    CHECK_EQ(theta->dimension_, dimension_);
+    for (int i = 0; i < dimension_; i++) {
+      theta->values_[i] = values_[i] * resolution_;
+    }
+  }
+
+  template class FixedPointModel<std::int8_t>;
+  template class FixedPointModel<std::int16_t>;
+
+  namespace ml {
+
+    namespace {
+
+      template<class T>
+      inline num_t scalarDot(int const *index, num_t const *values, int begin, int length, T const *weights) {
+        num_t sum = 0;
+        if (index == nullptr) {
+          for (int i = begin; i < length; i++) {
+            sum += values[i] * weights[i];
+          }
+        } else {
+          for (int i = begin; i < length; i++) {
+            sum += values[i] * weights[index[i]];
+          }
+        }
+        return sum;
+      }
+
+    }  // namespace
+
+    num_t fixedPointDotScalar(int const *index, num_t const *values, int length, std::int8_t const *weights) {
+      return scalarDot(index, values, 0, length, weights);
+    }
+
+    num_t fixedPointDotScalar(int const *index, num_t const *values, int length, std::int16_t const *weights) {
+      return scalarDot(index, values, 0, length, weights);
+    }
+
+#if OBAMADB_X86
+    namespace {
+
+      /**
+       * Loads 8 weights, sign extended to 32 bit lanes.
+       */
+      template<class T>
+      struct AVX2Weights;
+
+      template<>
+      struct AVX2Weights<std::int8_t> {
+        __attribute__((target("avx2")))
+        static inline __m256i load(std::int8_t const *weights) {
+          return _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(weights)));
+        }
+
+        /**
+         * Each lane gathers the 4 bytes at its weight, and keeps the lowest.
+         */
+        __attribute__((target("avx2")))
+        static inline __m256i gather(std::int8_t const *weights, __m256i index) {
+          __m256i const words = _mm256_i32gather_epi32(reinterpret_cast<int const *>(weights), index, 1);
+          return _mm256_srai_epi32(_mm256_slli_epi32(words, 24), 24);
+        }
+      };
+
+      template<>
+      struct AVX2Weights<std::int16_t> {
+        __attribute__((target("avx2")))
+        static inline __m256i load(std::int16_t const *weights) {
+          return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const *>(weights)));
+        }
+
+        __attribute__((target("avx2")))
+        static inline __m256i gather(std::int16_t const *weights, __m256i index) {
+          __m256i const words = _mm256_i32gather_epi32(reinterpret_cast<int const *>(weights), index, 2);
+          return _mm256_srai_epi32(_mm256_slli_epi32(words, 16), 16);
+        }
+      };
+
+      template<class T>
+      __attribute__((target("avx2")))
+      num_t avx2Dot(int const *index, num_t const *values, int length, T const *weights) {
+        __m256 acc = _mm256_setzero_ps();
+        int i = 0;
+        if (index == nullptr) {
+          for (; i + 8 <= length; i += 8) {
+            __m256 const w = _mm256_cvtepi32_ps(AVX2Weights<T>::load(weights + i));
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(values + i), w));
+          }
+        } else {
+          for (; i + 8 <= length; i += 8) {
+            __m256i const columns = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(index + i));
+            __m256 const w = _mm256_cvtepi32_ps(AVX2Weights<T>::gather(weights, columns));
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(values + i), w));
+          }
+        }
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        return _mm_cvtss_f32(sum) + scalarDot(index, values, i, length, weights);
+      }
+
+    }  // namespace
+
+    num_t fixedPointDotAVX2(int const *index, num_t const *values, int length, std::int8_t const *weights) {
+      return avx2Dot(index, values, length, weights);
+    }
+
+    num_t fixedPointDotAVX2(int const *index, num_t const *values, int length, std::int16_t const *weights) {
+      return avx2Dot(index, values, length, weights);
+    }
+#else
+    num_t fixedPointDotAVX2(int const *index, num_t const *values, int length, std::int8_t const *weights) {
+      LOG(FATAL) << "AVX2 is not available on this architecture.";
+      return 0;
+    }
+
+    num_t fixedPointDotAVX2(int const *index, num_t const *values, int length, std::int16_t const *weights) {
+      LOG(FATAL) << "AVX2 is not available on this architecture.";
+      return 0;
+    }
+#endif
+
+    namespace {
+      bool useAVX2() {
+        static bool const kAVX2 = cpuSupportsAVX2();
+        return kAVX2;
+      }
+    }  // namespace
+
+    num_t fixedPointDot(int const *index, num_t const *values, int length, std::int8_t const *weights) {
+      if (useAVX2()) {
+        return fixedPointDotAVX2(index, values, length, weights);
+      }
+      return fixedPointDotScalar(index, values, length, weights);
+    }
+
+    num_t fixedPointDot(int const *index, num_t const *values, int length, std::int16_t const *weights) {
+      if (useAVX2()) {
+        return fixedPointDotAVX2(index, values, length, weights);
+      }
+      return fixedPointDotScalar(index, values, length, weights);
+    }
+
+  }  // namespace ml
+
+}  // namespace obamadb
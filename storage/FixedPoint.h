@@ -0,0 +1,174 @@
+#ifndef OBAMADB_FIXEDPOINT_H
+#define OBAMADB_FIXEDPOINT_H
+
+#include "storage/StorageConstants.h"
+#include "storage/Utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace obamadb {
+
+  /**
+   * How the weights of a trained model are stored.
+   */
+  enum class ModelPrecision {
+    kFloat32,  // 32 bit floats.
+    kInt16,    // 16 bit fixed point, see FixedPointModel.
+    kInt8,     // 8 bit fixed point.
+  };
+
+  /**
+   * @return False if the name does not name a precision.
+   */
+  bool ParseModelPrecision(std::string const & name, ModelPrecision *precision);
+
+  std::string ModelPrecisionName(ModelPrecision precision);
+
+  // Elements a FixedPointModel holds past its last weight, so that the gathers of the dot kernels,
+  // which read 4 bytes per weight, stay inside the model.
+  const int kFixedPointPadding = 4;
+
+  /**
+   * The uniform draws of stochastic rounding, one per update of a weight. A 64 bit linear
+   * congruential generator (with Knuth's MMIX constants) takes one multiply-add per draw, against
+   * the three xorshifted words of QuickRandom, and only its high bits, which are its best, are used.
+   */
+  class RoundingRandom {
+  public:
+    /**
+     * @param seed Generators with different seeds draw different sequences.
+     */
+    explicit RoundingRandom(std::uint64_t seed)
+      : state_(QuickRandom(seed).nextInt64()) {}
+
+    /**
+     * @return A draw from [0, 1) with 24 random bits, which a float holds exactly.
+     */
+    inline num_t nextUniform() {
+      state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL;
+      return (state_ >> 40) * (static_cast<num_t>(1) / (1 << 24));
+    }
+
+  private:
+    std::uint64_t state_;
+  };
+
+  /**
+   * Rounds down or up at random, with probabilities which make the expected result x, so that a sum
+   * of many rounded values is unbiased however small each value is.
+   * @param x Must fit in an int.
+   */
+  inline int stochasticRound(num_t x, RoundingRandom *rng) {
+    num_t const shifted = x + rng->nextUniform();
+    int const truncated = static_cast<int>(shifted);
+    // Truncation rounds negative values up.
+    return truncated - (shifted < truncated);
+  }
+
+  /**
+   * Adds a number of steps of the resolution to a fixed-point weight, rounded stochastically. The
+   * weight saturates at the type's limits rather than wrapping.
+   */
+  template<class T>
+  inline void addStochastic(T *weight, num_t steps, RoundingRandom *rng) {
+    int const limit = std::numeric_limits<T>::max();
+    steps = std::max<num_t>(-2 * limit, std::min<num_t>(2 * limit, steps));
+    int const sum = *weight + stochasticRound(steps, rng);
+    *weight = static_cast<T>(std::max(-limit, std::min(limit, sum)));
+  }
+
+  /**
+   * A model whose weights are stored as integer multiples of a fixed resolution (Buckwild, De Sa et
+   * al. 2015). An int8 weight moves a quarter, and an int16 weight half, of the bytes of a float
+   * through the caches and the coherence protocol, at the cost of the weights' range and precision.
+   * @param T std::int8_t or std::int16_t.
+   */
+  template<class T>
+  class FixedPointModel {
+  public:
+    /**
+     * @param theta The initial weights, rounded to the nearest multiple of the resolution.
+     * @param range The largest magnitude a weight can take. Larger weights saturate.
+     */
+    FixedPointModel(fvector const & theta, float range);
+
+    /**
+     * @return The weights, in multiples of the resolution, followed by kFixedPointPadding zeros.
+     */
+    T* getValues() {
+      return values_.data();
+    }
+
+    int getDimension() const {
+      return dimension_;
+    }
+
+    /**
+     * @return The weight of one unit of T.
+     */
+    float getResolution() const {
+      return resolution_;
+    }
+
+    /**
+     * @return A distinct seed per call, for the random number generators of the training threads.
+     */
+    std::uint64_t nextSeed() {
+      return seeds_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Copies the weights to a plain model, e.g. for evaluation. No task may be training.
+     */
+    void copyWeights(fvector *theta) const;
+
+  private:
+    int const dimension_;
+    float const resolution_;
+    std::vector<T> values_;
+    std::atomic<std::uint64_t> seeds_;
+
+    DISABLE_COPY_AND_ASSIGN(FixedPointModel);
+  };
+
+  extern template class FixedPointModel<std::int8_t>;
+  extern template class FixedPointModel<std::int16_t>;
+
+  /**
+   * Dot products of rows of floats with fixed-point weights, converting the weights to floats on the
+   * fly. The result is in multiples of the weights' resolution.
+   * @param index The row's column indices in increasing order, or nullptr for a dense row whose
+   *        value i belongs to column i.
+   */
+  namespace ml {
+
+    num_t fixedPointDotScalar(int const *index, num_t const *values, int length, std::int8_t const *weights);
+
+    num_t fixedPointDotScalar(int const *index, num_t const *values, int length, std::int16_t const *weights);
+
+    /**
+     * Converts 8 weights at a time with AVX2 instructions, gathering those of a sparse row. Only
+     * call if the CPU supports AVX2, and only with the weights of a FixedPointModel, whose padding
+     * the gathers may read.
+     */
+    num_t fixedPointDotAVX2(int const *index, num_t const *values, int length, std::int8_t const *weights);
+
+    num_t fixedPointDotAVX2(int const *index, num_t const *values, int length, std::int16_t const *weights);
+
+    /**
+     * Uses the fastest kernel the CPU supports, detected once.
+     */
+    num_t fixedPointDot(int const *index, num_t const *values, int length, std::int8_t const *weights);
+
+    num_t fixedPointDot(int const *index, num_t const *values, int length, std::int16_t const *weights);
+
+  }  // namespace ml
+
+}  // namespace obamadb
+
+#endif //OBAMADB_FIXEDPOINT_H
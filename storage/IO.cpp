@@ -1,6 +1,7 @@
 #include "storage/exvector.h"
 #include "storage/DataBlock.h"
 #include "storage/Matrix.h"
+#include "storage/MatrixStats.h"
 #include "storage/MLTask.h"
 #include "storage/SparseDataBlock.h"
 
@@ -8,6 +9,8 @@
 #include <iostream>
 #include <fstream>
 #include <fcntl.h>
+#include <sys/stat.h>
+#include <memory>
 #include <set>
 
 #include "glog/logging.h"
@@ -382,10 +385,49 @@ namespace obamadb {
       return blocks;
     }
 
-    Matrix *load(const std::string &filename) {
+    /**
+     * Gets the size and modification time of a file, which change when it is rewritten.
+     * @return False if the file could not be examined.
+     */
+    bool getFileVersion(const std::string &filename, std::int64_t *size, std::int64_t *mtime_ns) {
+      struct stat info;
+      if (stat(filename.c_str(), &info) != 0) {
+        return false;
+      }
+      *size = info.st_size;
+#ifdef __APPLE__
+      *mtime_ns = info.st_mtimespec.tv_sec * 1000000000LL + info.st_mtimespec.tv_nsec;
+#else
+      *mtime_ns = info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+#endif
+      return true;
+    }
+
+    /**
+     * Sets the matrix's statistics from a cache file if the file was computed from the same version
+     * of the data file and describes the same data.
+     * @return True if the cached statistics were used.
+     */
+    bool loadCachedStats(const std::string &stats_file, std::int64_t source_size, std::int64_t source_mtime_ns,
+                         Matrix *mat) {
+      std::unique_ptr<MatrixStats> stats(MatrixStats::Load(stats_file));
+      if (!stats
+          || stats->source_size != source_size
+          || stats->source_mtime_ns != source_mtime_ns
+          || stats->numRows() != mat->numRows_
+          || stats->numColumns() != mat->numColumns_
+          || stats->nnz != mat->getNNZ()) {
+        return false;
+      }
+      mat->setStats(stats.release());
+      return true;
+    }
+
+    Matrix *load(const std::string &filename, bool use_stats_cache) {
       std::string const synth_str("_synth_svm_");
       Matrix *mat = nullptr;
-      if (filename.find(synth_str) != std::string::npos) {
+      bool const synthetic = filename.find(synth_str) != std::string::npos;
+      if (synthetic) {
         LOG(INFO) << "Loading a synthetic dataset";
         // this file contains synthetic data params
         std::vector<obamadb::SparseDataBlock<num_t> *> blocks = load_synthetic_blocks(filename);
@@ -394,6 +436,24 @@ namespace obamadb {
         std::vector<obamadb::SparseDataBlock<num_t> *> blocks = loadBlocks<num_t>(filename);
         mat = new Matrix(blocks);
       }
+
+      std::string const stats_file = filename + kStatsFileSuffix;
+      std::int64_t source_size = -1;
+      std::int64_t source_mtime_ns = -1;
+      bool const cacheable = use_stats_cache && !synthetic
+                             && getFileVersion(filename, &source_size, &source_mtime_ns);
+      if (cacheable && loadCachedStats(stats_file, source_size, source_mtime_ns, mat)) {
+        DLOG(INFO) << "Using cached statistics from " << stats_file;
+        return mat;
+      }
+      std::unique_ptr<MatrixStats> stats(
+        MatrixStats::Compute(mat->blocks_, mat->dense_blocks_, mat->numRows_, mat->numColumns_));
+      if (cacheable) {
+        stats->source_size = source_size;
+        stats->source_mtime_ns = source_mtime_ns;
+        LOG_IF(WARNING, !stats->save(stats_file)) << "Unable to cache statistics to " << stats_file;
+      }
+      mat->setStats(stats.release());
       return mat;
     }
 
@@ -32,11 +32,19 @@ namespace obamadb {
     std::vector<SparseDataBlock<T>*> loadBlocks(const std::string &file_name);
 
     /**
-     * Load a sparse file representation of a dataset into a matrix.
+     * Load a sparse file representation of a dataset into a matrix. The matrix's statistics catalog
+     * is computed as part of loading.
      * @param filename The sparse datafile.
+     * @param use_stats_cache If true, the statistics are read from filename + kStatsFileSuffix when
+     *                        that file was written for the data file's current size and modification
+     *                        time and matches the loaded data, and otherwise computed and written
+     *                        there. Synthetic datasets are never cached.
      * @return Caller-owned matrix.
      */
-    Matrix* load(const std::string &filename);
+    Matrix* load(const std::string &filename, bool use_stats_cache = false);
+
+    // Suffix of the file which caches a data file's statistics.
+    const char kStatsFileSuffix[] = ".stats";
 
     void save(const std::string& file_name, const Matrix& mat);
 
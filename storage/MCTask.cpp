@@ -1,6 +1,8 @@
 #include "storage/exvector.h"
+#include "storage/Partitioner.h"
 
 #include <algorithm>
+#include <utility>
 #include <vector>
 
 #include "MCTask.h"
@@ -9,9 +11,26 @@
 namespace obamadb {
 
   void MCTask::execute(int threadId, void *state) {
-    int const allocSize = examples_->numElements()/total_threads_;
-    int const start_index = allocSize * threadId;
-    int const end_index = std::min(allocSize * (threadId + 1), examples_->numElements());
+    if (scheduler_ == nullptr) {
+      // Every example costs the same, so an even split is balanced, and covers the remainder.
+      std::pair<int, int> const range = EvenSplit(examples_->numElements(), total_threads_, threadId);
+      trainRange(range.first, range.second);
+      if (threadId == 0) {
+        shared_state_->step_size *= shared_state_->step_decay;
+      }
+      return;
+    }
+
+    threading::WorkItem item;
+    while (scheduler_->next(threadId, &item)) {
+      trainRange(item.begin, item.end);
+    }
+    if (scheduler_->finish(threadId)) {
+      shared_state_->step_size *= shared_state_->step_decay;
+    }
+  }
+
+  void MCTask::trainRange(int start_index, int end_index) {
     double const mean = shared_state_->mean;
     double const step_size = shared_state_->step_size;
     double const mu = shared_state_->mu;
@@ -23,8 +42,18 @@ namespace obamadb {
     dvector<num_t> lrow(0, nullptr);
     dvector<num_t> rrow(0, nullptr);
     dvector<num_t> lrow_temp;
+    int const prefetch_distance = shared_state_->prefetch_distance;
+    dvector<num_t> ahead(0, nullptr);
 
     for (int i = start_index; i < end_index; i++) {
+      // The factor rows of an example are effectively random, so fetch those of a later example.
+      if (prefetch_distance > 0 && i + prefetch_distance < end_index) {
+        MatrixEntry const &next = examples_->get(i + prefetch_distance);
+        mat_l->getRowVectorFast(next.row, &ahead);
+        prefetchForWrite(ahead.values_, sizeof(num_t) * ahead.num_elements_);
+        mat_r->getRowVectorFast(next.column, &ahead);
+        prefetchForWrite(ahead.values_, sizeof(num_t) * ahead.num_elements_);
+      }
       MatrixEntry const &entry = examples_->get(i);
       int row_index = entry.row;
       int col_index = entry.column;
@@ -45,9 +74,8 @@ namespace obamadb {
 
       lrow.copy(lrow_temp);
     }
-    if (threadId == 0) {
-      shared_state_->step_size *= shared_state_->step_decay;
-    }
+    // Each example is one rating.
+    threading::reportWork(end_index - start_index, end_index - start_index);
   }
 
   double MCTask::rmse(MCState const* state, UnorderedMatrix const * probe) {
@@ -4,6 +4,8 @@
 #include "storage/DenseDataBlock.h"
 #include "storage/exvector.h"
 #include "storage/MLTask.h"
+#include "storage/Prefetch.h"
+#include "storage/ThreadPool.h"
 #include "storage/UnorderedMatrix.h"
 #include "storage/Utils.h"
 
@@ -20,14 +22,16 @@ namespace obamadb {
       : mu(-1),
         step_size(0.001),
         step_decay(0.9),
-        degrees_l(training_matrix->numRows(), 0),
-        degrees_r(training_matrix->numColumns(), 0),
+        // UnorderedMatrix reports the largest row and column index rather than a count.
+        degrees_l(training_matrix->numRows() + 1, 0),
+        degrees_r(training_matrix->numColumns() + 1, 0),
         mean(0),
+        prefetch_distance(kDefaultPrefetchDistance),
         rank(rank),
         mat_l(nullptr),
         mat_r(nullptr){
-      mat_l.reset(new DenseDataBlock<num_t>(training_matrix->numRows(), rank));
-      mat_r.reset(new DenseDataBlock<num_t>(training_matrix->numColumns(), rank));
+      mat_l.reset(new DenseDataBlock<num_t>(training_matrix->numRows() + 1, rank));
+      mat_r.reset(new DenseDataBlock<num_t>(training_matrix->numColumns() + 1, rank));
       mat_l->randomize();
       mat_r->randomize();
 
@@ -47,6 +51,8 @@ namespace obamadb {
     std::vector<int> degrees_l;
     std::vector<int> degrees_r;
     double mean;
+    // How many examples ahead the factor rows are prefetched. 0 disables prefetching.
+    int prefetch_distance;
 
     int rank;
     std::unique_ptr<DenseDataBlock<num_t>> mat_l;
@@ -61,7 +67,22 @@ namespace obamadb {
       : MLTask(nullptr),
         total_threads_(total_threads),
         examples_(examples),
-        shared_state_(sharedState){ }
+        shared_state_(sharedState),
+        scheduler_(nullptr) { }
+
+    /**
+     * A task whose epochs are scheduled dynamically over ranges of the examples.
+     * @param scheduler Scheduler over the examples, shared by all tasks of the pool.
+     */
+    MCTask(int total_threads,
+           UnorderedMatrix const * examples,
+           MCState *sharedState,
+           threading::EpochScheduler *scheduler)
+      : MLTask(nullptr),
+        total_threads_(total_threads),
+        examples_(examples),
+        shared_state_(sharedState),
+        scheduler_(scheduler) { }
 
     MLAlgorithm getType() override {
       return MLAlgorithm::kMC;
@@ -71,9 +92,16 @@ namespace obamadb {
 
     static double rmse(MCState const* state, UnorderedMatrix const * probe);
 
+    /**
+     * Applies SGD updates for the examples [start_index, end_index).
+     */
+    void trainRange(int start_index, int end_index);
+
     int total_threads_;
     UnorderedMatrix const * examples_;
     MCState *shared_state_;
+    // Not owned. Null if each thread trains on a fixed share of the examples.
+    threading::EpochScheduler *scheduler_;
 
     DISABLE_COPY_AND_ASSIGN(MCTask);
   };
@@ -58,6 +58,14 @@ namespace obamadb {
         tptr[idx] = tptr[idx] + (vptr[i] * e);
       }
     }
+
+    void scale_and_add(num_t *theta, const dvector<num_t> &delta, const num_t e) {
+      num_t *const __restrict__ tptr = theta;
+      num_t const *__restrict__ const vptr = delta.values_;
+      for (int i = 0; i < delta.num_elements_; i++) {
+        tptr[i] = tptr[i] + (vptr[i] * e);
+      }
+    }
   }  // namespace ml
 
 } // namespace obamadb
\ No newline at end of file
@@ -35,6 +35,11 @@ namespace obamadb {
      */
     void scale_and_add(num_t *theta, const svector <num_t> &delta, const num_t e);
 
+    /**
+     * Dense scale and add into a model array.
+     */
+    void scale_and_add(num_t *theta, const dvector <num_t> &delta, const num_t e);
+
   }  // namespace ml
 
   enum class MLAlgorithm {
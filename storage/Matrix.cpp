@@ -9,11 +9,11 @@ namespace obamadb {
   {
     char buff[1000]; // TODO: buffer overflow possible.
     snprintf(buff, sizeof(buff),
-             "Matrix: %lu training blocks for a total size of %ldmb with %d examples (%d nnz elements) with %f sparsity\n",
-             matrix.blocks_.size(),
+             "Matrix: %lu training blocks for a total size of %ldmb with %d examples (%llu nnz elements) with %f sparsity\n",
+             matrix.blocks_.size() + matrix.dense_blocks_.size(),
              (long) (matrix.sizeBytes() / 1e6),
              matrix.numRows_,
-             matrix.getNNZ(),
+             (unsigned long long) matrix.getNNZ(),
              matrix.getSparsity());
     std::string buffAsStdStr = buff;
     os << buffAsStdStr;
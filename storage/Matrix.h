@@ -1,37 +1,21 @@
 #ifndef OBAMADB_MATRIX_H
 #define OBAMADB_MATRIX_H
 
+#include "storage/DenseDataBlock.h"
 #include "storage/exvector.h"
+#include "storage/MatrixStats.h"
+#include "storage/RandomProjection.h"
 #include "storage/SparseDataBlock.h"
+#include "storage/SparseDot.h"
 #include "storage/StorageConstants.h"
 #include "storage/ThreadPool.h"
 
 #include <algorithm>
 #include <memory>
-#include <mutex>
 #include <vector>
 
 namespace obamadb {
 
-  namespace {
-
-    inline num_t sparseDot(const svector<num_t> & a, const svector<signed char> & b) {
-      int ai = 0, bi = 0;
-      num_t sum_prod = 0;
-      while(ai < a.num_elements_ && bi < b.num_elements_) {
-        if(a.index_[ai] == b.index_[bi]) {
-          sum_prod += a.values_[ai] * b.values_[bi];
-          ai++; bi++;
-        } else if (a.index_[ai] < b.index_[bi]) {
-          ai++;
-        } else {
-          bi++;
-        }
-      }
-      return sum_prod;
-    }
-  }
-
   class Matrix {
   public:
     /**
@@ -40,7 +24,9 @@ namespace obamadb {
     Matrix(const std::vector<SparseDataBlock<num_t> *> &blocks)
       : numColumns_(0),
         numRows_(0),
-        blocks_() {
+        blocks_(),
+        dense_blocks_(),
+        stats_() {
       for (int i = 0; i < blocks.size(); i++) {
         addBlock(blocks[i]);
       }
@@ -52,12 +38,17 @@ namespace obamadb {
     Matrix()
       : numColumns_(0),
         numRows_(0),
-        blocks_() {}
+        blocks_(),
+        dense_blocks_(),
+        stats_() {}
 
     ~Matrix() {
       for(auto block : blocks_) {
         delete block;
       }
+      for(auto block : dense_blocks_) {
+        delete block;
+      }
     }
 
     /**
@@ -65,6 +56,8 @@ namespace obamadb {
      * @param block The sparse datablock to add.
      */
     void addBlock(SparseDataBlock<num_t> *block) {
+      DCHECK(dense_blocks_.empty()) << "A matrix holds either sparse or dense blocks.";
+      stats_.reset();
       if (block->getNumColumns() > numColumns_) {
         numColumns_ = block->getNumColumns();
         // each block should be the same dimension as the matrix.
@@ -76,12 +69,33 @@ namespace obamadb {
       blocks_.push_back(block);
     }
 
+    /**
+     * Takes ownership of a dense block. A matrix holds either sparse or dense blocks, not both.
+     * @param block The dense datablock to add.
+     */
+    void addBlock(DenseDataBlock<num_t> *block) {
+      DCHECK(blocks_.empty()) << "A matrix holds either sparse or dense blocks.";
+      DCHECK(dense_blocks_.empty() || block->getNumColumns() == numColumns_);
+      stats_.reset();
+      numColumns_ = block->getNumColumns();
+      numRows_ += block->getNumRows();
+      dense_blocks_.push_back(block);
+    }
+
+    /**
+     * @return True if the matrix's data is stored in dense blocks.
+     */
+    bool isDense() const {
+      return !dense_blocks_.empty();
+    }
+
     /**
      * Appends the row to the last block in the matrix's list of datablocks. If it does not fit, a new data
      * block will be created.
      * @param row Row to append
      */
     void addRow(const svector<num_t> &row) {
+      stats_.reset();
       if(blocks_.size() == 0 || !blocks_.back()->appendRow(row)) {
         blocks_.push_back(new SparseDataBlock<num_t>());
         bool appended = blocks_.back()->appendRow(row);
@@ -102,64 +116,184 @@ namespace obamadb {
       PMultiState(const Matrix * matA,
                   const SparseDataBlock<signed char> *matB,
                   num_t kNormalizingConstant,
-                  Matrix *result,
                   int total_threads)
         : matA_(matA),
           matB_(matB),
+          implicitB_(nullptr),
           kNormalizingConstant_(kNormalizingConstant),
-          result_(result),
           total_threads_(total_threads),
-          result_lock_() {}
+          dense_output_(false),
+          scheduler_(total_threads, matA->blocks_.size(), 1),
+          outputs_(matA->blocks_.size()),
+          dense_outputs_() {}
+
+      PMultiState(const Matrix * matA,
+                  const ImplicitProjection *implicitB,
+                  bool dense_output,
+                  int total_threads)
+        : matA_(matA),
+          matB_(nullptr),
+          implicitB_(implicitB),
+          kNormalizingConstant_(implicitB->normalizingConstant()),
+          total_threads_(total_threads),
+          dense_output_(dense_output),
+          scheduler_(total_threads, matA->blocks_.size(), 1),
+          outputs_(matA->blocks_.size()),
+          dense_outputs_(matA->blocks_.size()) {}
+
+      /**
+       * @return The number of columns of the product.
+       */
+      int numOutputColumns() const {
+        return implicitB_ != nullptr ? implicitB_->getK() : matB_->getNumRows();
+      }
 
       const Matrix * matA_;
+      // Exactly one of matB_ and implicitB_ is set.
       const SparseDataBlock<signed char>* matB_;
+      const ImplicitProjection* implicitB_;
       num_t kNormalizingConstant_;
-      Matrix *result_;
       int total_threads_;
-      std::mutex result_lock_;
+      // Only an implicit projection may produce dense output.
+      bool dense_output_;
+      // Work items are ranges of matA_'s blocks.
+      threading::EpochScheduler scheduler_;
+      // The result blocks for each of matA_'s blocks. Each entry is written only by the thread which
+      // processed that block, and entries are merged in input order once all threads finish.
+      std::vector<std::vector<SparseDataBlock<num_t>*>> outputs_;
+      std::vector<std::vector<DenseDataBlock<num_t>*>> dense_outputs_;
     };
 
-    static void parallelMultiplyHelper(int thread_id, void* state) {
-      PMultiState *pstate = reinterpret_cast<PMultiState *>(state);
-      const int numBlocks = pstate->matA_->blocks_.size();
-      const int blocks_per_thread = numBlocks / pstate->total_threads_;
-      int block_lower_lim = blocks_per_thread * thread_id;
-      int block_upper_lim = std::min(blocks_per_thread * (thread_id + 1), numBlocks);
+    /**
+     * Projects a single block of A into dense result blocks, appending them to output.
+     */
+    static void projectBlockDense(PMultiState const *pstate,
+                                  SparseDataBlock<num_t> const *block,
+                                  std::vector<DenseDataBlock<num_t>*> *output) {
+      svector<num_t> row_a(0, nullptr);
+      const int k = pstate->numOutputColumns();
+      // Size the result blocks so that a small input block does not leave a mostly empty result block.
+      const int rows_per_block = std::max(1, std::min((int) block->getNumRows(),
+                                                      (int) (kStorageBlockSize / (sizeof(num_t) * (k + 1)))));
+      dvector<num_t> row_c(k);
+      row_c.num_elements_ = k;
+
+      DenseDataBlock<num_t> *result_block = nullptr;
+      for (int j = 0; j < block->getNumRows(); j++) {
+        block->getRowVectorFast(j, &row_a);
+        pstate->implicitB_->project(row_a, row_c.values_);
+        for (int c = 0; c < k; c++) {
+          row_c.values_[c] *= pstate->kNormalizingConstant_;
+        }
+        *row_c.class_ = *row_a.class_;
+        if (result_block == nullptr || !result_block->appendRow(row_c)) {
+          if (result_block != nullptr) {
+            result_block->finalize();
+            output->push_back(result_block);
+          }
+          result_block = new DenseDataBlock<num_t>(rows_per_block, k);
+          bool appended = result_block->appendRow(row_c);
+          DCHECK(appended);
+        }
+      }
 
-      const std::vector<SparseDataBlock<num_t> *> &blocks_ = pstate->matA_->blocks_;
+      if (result_block != nullptr) {
+        result_block->finalize();
+        output->push_back(result_block);
+      }
+    }
+
+    /**
+     * Multiplies a single block of A, appending the result blocks to output.
+     */
+    static void multiplyBlock(PMultiState const *pstate,
+                              SparseDataBlock<num_t> const *block,
+                              std::vector<num_t> *projected,
+                              std::vector<SparseDataBlock<num_t>*> *output) {
       svector<num_t> row_a(0, nullptr);
       svector<signed char> row_b(0, nullptr);
+      const int num_output_columns = pstate->numOutputColumns();
 
       SparseDataBlock<num_t> *result_block = new SparseDataBlock<num_t>();
-      for (int i = block_lower_lim; i < block_upper_lim; i++) {
-        const SparseDataBlock<num_t> *block = blocks_[i];
-        for (int j = 0; j < block->getNumRows(); j++) {
-          svector<num_t> row_c;
-          block->getRowVectorFast(j, &row_a);
-          for (int k = 0; k < pstate->matB_->getNumRows(); k++) {
+      for (int j = 0; j < block->getNumRows(); j++) {
+        svector<num_t> row_c;
+        block->getRowVectorFast(j, &row_a);
+        if (pstate->implicitB_ != nullptr) {
+          pstate->implicitB_->project(row_a, projected->data());
+          for (int k = 0; k < num_output_columns; k++) {
+            if ((*projected)[k] != 0) {
+              row_c.push_back(k, (*projected)[k] * pstate->kNormalizingConstant_);
+            }
+          }
+        } else {
+          for (int k = 0; k < num_output_columns; k++) {
             pstate->matB_->getRowVectorFast(k, &row_b);
-            num_t f = sparseDot(row_a, row_b);
+            num_t f = ml::sparseDot(row_a, row_b);
             if (f != 0) {
               row_c.push_back(k, f * pstate->kNormalizingConstant_);
             }
           }
-          *row_c.class_ = *row_a.class_;
-          if (!result_block->appendRow(row_c)) {
-            pstate->result_lock_.lock();
-            pstate->result_->addBlock(result_block);
-            pstate->result_lock_.unlock();
-            result_block = new SparseDataBlock<num_t>();
-          }
+        }
+        *row_c.class_ = *row_a.class_;
+        if (!result_block->appendRow(row_c)) {
+          output->push_back(result_block);
+          result_block = new SparseDataBlock<num_t>();
+          bool appended = result_block->appendRow(row_c);
+          DCHECK(appended);
         }
       }
 
       if (result_block->getNumRows() != 0) {
-        pstate->result_lock_.lock();
-        pstate->result_->addBlock(result_block);
-        pstate->result_lock_.unlock();
+        output->push_back(result_block);
+      } else {
+        delete result_block;
       }
     }
 
+    static void parallelMultiplyHelper(int thread_id, void* state) {
+      PMultiState *pstate = reinterpret_cast<PMultiState *>(state);
+      const std::vector<SparseDataBlock<num_t> *> &blocks_ = pstate->matA_->blocks_;
+      std::vector<num_t> projected(pstate->implicitB_ != nullptr ? pstate->numOutputColumns() : 0);
+
+      threading::WorkItem item;
+      while (pstate->scheduler_.next(thread_id, &item)) {
+        for (int i = item.begin; i < item.end; i++) {
+          if (pstate->dense_output_) {
+            projectBlockDense(pstate, blocks_[i], &pstate->dense_outputs_[i]);
+          } else {
+            multiplyBlock(pstate, blocks_[i], &projected, &pstate->outputs_[i]);
+          }
+        }
+      }
+      pstate->scheduler_.finish(thread_id);
+    }
+
+    /**
+     * Runs a multiplication on a thread pool and merges the per-block results in input order, so
+     * the result does not depend on which thread processed which block.
+     * @param pstate A state with a scheduler covering all of the blocks of this matrix.
+     * @return Caller-owned matrix result of the multiplication.
+     */
+    Matrix* runParallelMultiply(PMultiState *pstate) const {
+      ThreadPool tp(Matrix::parallelMultiplyHelper, pstate, pstate->total_threads_);
+      tp.begin();
+      tp.cycle();
+      tp.stop();
+
+      Matrix *result = new Matrix();
+      for (auto const & output : pstate->outputs_) {
+        for (auto block : output) {
+          result->addBlock(block);
+        }
+      }
+      for (auto const & output : pstate->dense_outputs_) {
+        for (auto block : output) {
+          result->addBlock(block);
+        }
+      }
+      return result;
+    }
+
     /**
      * Do a row-by-row multiplication (normally we do a row-column multiplication, but here we
      * are much better optimized for row wise multiplications and so we do this method.
@@ -171,17 +305,35 @@ namespace obamadb {
      */
     Matrix* matrixMultiplyRowWise(const SparseDataBlock<signed char>* mat,
                                   num_t kNormalizingConstant) const {
-      Matrix *result = new Matrix();
       // Hack to make this parallel
-      int numThreads = std::min((size_t)threading::numCores(), blocks_.size());
+      int numThreads = std::max(std::min((size_t)threading::numCores(), blocks_.size()), (size_t) 1);
       DLOG(INFO) << "Parallelizing matrix multiplication with " << numThreads << " threads";
 
-      PMultiState * shared_state = new PMultiState(this, mat, kNormalizingConstant, result, numThreads);
-      ThreadPool tp(Matrix::parallelMultiplyHelper, shared_state, numThreads);
-      tp.begin();
-      tp.cycle();
-      tp.stop();
+      std::unique_ptr<PMultiState> shared_state(new PMultiState(this, mat, kNormalizingConstant, numThreads));
+      return runParallelMultiply(shared_state.get());
+    }
+
+    /**
+     * Row-wise multiplication by a projection matrix which is computed on demand rather than stored.
+     * The product is scaled by the projection's normalizing constant.
+     *
+     * @param projection The implicit projection matrix R.
+     * @param denseOutput If true, the result is stored in dense blocks.
+     * @return Caller-owned matrix result of A*R, which always has k columns.
+     */
+    Matrix* matrixMultiplyRowWise(const ImplicitProjection& projection, bool denseOutput) const {
+      int numThreads = std::max(std::min((size_t)threading::numCores(), blocks_.size()), (size_t) 1);
+      DLOG(INFO) << "Parallelizing implicit projection with " << numThreads << " threads";
 
+      std::unique_ptr<PMultiState> shared_state(new PMultiState(this, &projection, denseOutput, numThreads));
+      Matrix *result = runParallelMultiply(shared_state.get());
+
+      // Trailing columns may be zero in every row, but the shape must not depend on the data.
+      result->numColumns_ = projection.getK();
+      for (auto block : result->blocks_) {
+        block->num_columns_ = result->numColumns_;
+      }
+      DCHECK(!denseOutput || numRows_ == 0 || result->isDense());
       return result;
     }
 
@@ -217,6 +369,42 @@ namespace obamadb {
       return matrixMultiplyRowWise(projection_mat, compressionConstant);
     }
 
+    /**
+     * Performs a random projection with a projection matrix which is never stored. Entries of R
+     * are derived from a hash of (seed, i, j), so data of any width can be compressed. Another
+     * matrix (e.g. the test set) is compressed consistently by passing an ImplicitProjection with
+     * the same dimension, k and seed.
+     *
+     * @param projection The implicit projection matrix R.
+     * @return the compressed matrix (b).
+     */
+    Matrix* randomProjectionsCompress(const ImplicitProjection& projection) const {
+      return matrixMultiplyRowWise(projection, false);
+    }
+
+    /**
+     * As above, but the compressed matrix can be stored in dense blocks. Projected rows are
+     * usually nearly dense, and dense storage avoids an index per value.
+     *
+     * @param projection The implicit projection matrix R.
+     * @param denseOutput If true, the compressed matrix is stored in dense blocks.
+     * @return the compressed matrix (b).
+     */
+    Matrix* randomProjectionsCompress(const ImplicitProjection& projection, bool denseOutput) const {
+      return matrixMultiplyRowWise(projection, denseOutput);
+    }
+
+    /**
+     * @return The expected fraction of nonzero elements of this matrix after a projection.
+     */
+    double expectedProjectedDensity(const ImplicitProjection& projection) const {
+      double density_sum = 0;
+      for (int row_nnz : getStats().row_nnz) {
+        density_sum += projection.expectedDensity(row_nnz);
+      }
+      return numRows_ == 0 ? 0 : density_sum / numRows_;
+    }
+
     /**
      * Creates a random matrix which should be linearly seperable.
      *
@@ -241,26 +429,63 @@ namespace obamadb {
      * @return Fraction of elements which are zero.
      */
     double getSparsity() const {
-      std::uint64_t nnz = 0;
+      std::uint64_t nnz = getNNZ();
       std::uint64_t numElements = static_cast<std::uint64_t >(numColumns_) * static_cast<std::uint64_t >(numRows_);
-      for (auto block : blocks_) {
-        nnz += block->numNonZeroElements();
-      }
       return (double ) (numElements - nnz) / (double) numElements;
     }
 
     /**
-     * Number of non-zero elements
+     * Number of non-zero elements. Taken from the statistics catalog if it has been computed.
      * @return
      */
-    int getNNZ() const {
-      int nnz = 0;
+    std::uint64_t getNNZ() const {
+      if (stats_) {
+        return stats_->nnz;
+      }
+      std::uint64_t nnz = 0;
       for (auto block : blocks_) {
         nnz += block->numNonZeroElements();
       }
+      for (auto block : dense_blocks_) {
+        nnz += block->numNonZeroElements();
+      }
       return nnz;
     }
 
+    /**
+     * Computes the statistics catalog in one parallel pass over the blocks, replacing any previous
+     * statistics.
+     */
+    void computeStats() {
+      stats_.reset(MatrixStats::Compute(blocks_, dense_blocks_, numRows_, numColumns_));
+    }
+
+    /**
+     * Takes ownership of precomputed statistics, e.g. statistics loaded from a file.
+     * @param stats Statistics which must have the shape of this matrix.
+     */
+    void setStats(MatrixStats *stats) {
+      CHECK_EQ(numRows_, stats->numRows());
+      CHECK_EQ(numColumns_, stats->numColumns());
+      stats_.reset(stats);
+    }
+
+    bool hasStats() const {
+      return static_cast<bool>(stats_);
+    }
+
+    /**
+     * The statistics are computed on first use and dropped whenever the matrix changes. Computing
+     * them is not thread safe, so call computeStats() before sharing the matrix between threads.
+     * @return The statistics catalog of this matrix.
+     */
+    MatrixStats const & getStats() const {
+      if (!stats_) {
+        stats_.reset(MatrixStats::Compute(blocks_, dense_blocks_, numRows_, numColumns_));
+      }
+      return *stats_;
+    }
+
     /**
      * @return The total size of the owned data.
      */
@@ -269,6 +494,9 @@ namespace obamadb {
       for(auto block : blocks_) {
         size += block->block_size_bytes_;
       }
+      for(auto block : dense_blocks_) {
+        size += block->block_size_bytes_;
+      }
       return size;
     }
 
@@ -277,6 +505,11 @@ namespace obamadb {
     int numColumns_;
     int numRows_;
     std::vector<SparseDataBlock<num_t>*> blocks_;
+    std::vector<DenseDataBlock<num_t>*> dense_blocks_;
+
+  private:
+    // Dropped whenever blocks or rows are added.
+    mutable std::unique_ptr<MatrixStats> stats_;
 
     DISABLE_COPY_AND_ASSIGN(Matrix);
   };
@@ -0,0 +1,272 @@
+#include "storage/MatrixStats.h"
+
+#include "storage/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <memory>
+
+#include "glog/logging.h"
+
+namespace obamadb {
+
+  namespace {
+
+    /**
+     * Column statistics accumulated by a single thread over the blocks it processed.
+     */
+    struct ColumnPartial {
+      ColumnPartial(int num_columns)
+        : nnz(0),
+          degrees(num_columns, 0),
+          sums(num_columns, 0),
+          sums_sq(num_columns, 0),
+          mins(num_columns, std::numeric_limits<num_t>::max()),
+          maxes(num_columns, std::numeric_limits<num_t>::lowest()) {}
+
+      inline void add(int column, num_t value) {
+        degrees[column]++;
+        sums[column] += value;
+        sums_sq[column] += static_cast<double>(value) * value;
+        mins[column] = std::min(mins[column], value);
+        maxes[column] = std::max(maxes[column], value);
+      }
+
+      std::uint64_t nnz;
+      std::vector<int> degrees;
+      std::vector<double> sums;
+      std::vector<double> sums_sq;
+      std::vector<num_t> mins;
+      std::vector<num_t> maxes;
+    };
+
+    struct StatsState {
+      StatsState(std::vector<SparseDataBlock<num_t>*> const & blocks,
+                 std::vector<DenseDataBlock<num_t>*> const & dense_blocks,
+                 MatrixStats *stats,
+                 int num_threads)
+        : blocks(blocks),
+          dense_blocks(dense_blocks),
+          stats(stats),
+          num_threads(num_threads),
+          merging(false),
+          first_rows(),
+          scheduler(),
+          partials() {
+        // Rows are numbered in block order, so each block's rows start after all previous blocks'.
+        int first_row = 0;
+        for (auto block : blocks) {
+          first_rows.push_back(first_row);
+          first_row += block->getNumRows();
+        }
+        for (auto block : dense_blocks) {
+          first_rows.push_back(first_row);
+          first_row += block->getNumRows();
+        }
+        scheduler.reset(new threading::EpochScheduler(num_threads, first_rows.size(), 1));
+        for (int i = 0; i < num_threads; i++) {
+          partials.push_back(std::unique_ptr<ColumnPartial>(new ColumnPartial(stats->numColumns())));
+        }
+      }
+
+      std::vector<SparseDataBlock<num_t>*> const & blocks;
+      std::vector<DenseDataBlock<num_t>*> const & dense_blocks;
+      MatrixStats *stats;
+      int num_threads;
+      // The first cycle scans blocks, the second merges the partials.
+      bool merging;
+      std::vector<int> first_rows;
+      std::unique_ptr<threading::EpochScheduler> scheduler;
+      std::vector<std::unique_ptr<ColumnPartial>> partials;
+    };
+
+    void scanSparseBlock(SparseDataBlock<num_t> const * block,
+                         int first_row,
+                         ColumnPartial *partial,
+                         MatrixStats *stats) {
+      svector<num_t> row(0, nullptr);
+      for (int i = 0; i < block->getNumRows(); i++) {
+        block->getRowVectorFast(i, &row);
+        double norm_sq = 0;
+        for (int e = 0; e < row.numElements(); e++) {
+          num_t const value = row.values_[e];
+          partial->add(row.index_[e], value);
+          norm_sq += static_cast<double>(value) * value;
+        }
+        partial->nnz += row.numElements();
+        stats->row_nnz[first_row + i] = row.numElements();
+        stats->row_norms[first_row + i] = std::sqrt(norm_sq);
+      }
+    }
+
+    void scanDenseBlock(DenseDataBlock<num_t> const * block,
+                        int first_row,
+                        ColumnPartial *partial,
+                        MatrixStats *stats) {
+      dvector<num_t> row(0, nullptr);
+      for (int i = 0; i < block->getNumRows(); i++) {
+        block->getRowVectorFast(i, &row);
+        double norm_sq = 0;
+        int row_nnz = 0;
+        for (int c = 0; c < row.size(); c++) {
+          num_t const value = row.values_[c];
+          if (value != 0) {
+            partial->add(c, value);
+            norm_sq += static_cast<double>(value) * value;
+            row_nnz++;
+          }
+        }
+        partial->nnz += row_nnz;
+        stats->row_nnz[first_row + i] = row_nnz;
+        stats->row_norms[first_row + i] = std::sqrt(norm_sq);
+      }
+    }
+
+    /**
+     * Each thread reduces a contiguous range of columns across all threads' partials.
+     */
+    void mergePartials(int thread_id, StatsState *state) {
+      MatrixStats *stats = state->stats;
+      int const num_columns = stats->numColumns();
+      int const begin = (static_cast<std::int64_t>(num_columns) * thread_id) / state->num_threads;
+      int const end = (static_cast<std::int64_t>(num_columns) * (thread_id + 1)) / state->num_threads;
+      for (int c = begin; c < end; c++) {
+        num_t min = std::numeric_limits<num_t>::max();
+        num_t max = std::numeric_limits<num_t>::lowest();
+        for (auto const & partial : state->partials) {
+          stats->degrees[c] += partial->degrees[c];
+          stats->sums[c] += partial->sums[c];
+          stats->sums_sq[c] += partial->sums_sq[c];
+          min = std::min(min, partial->mins[c]);
+          max = std::max(max, partial->maxes[c]);
+        }
+        // Columns without any stored value report 0 rather than the sentinels.
+        stats->mins[c] = stats->degrees[c] == 0 ? 0 : min;
+        stats->maxes[c] = stats->degrees[c] == 0 ? 0 : max;
+      }
+    }
+
+    void statsHelper(int thread_id, void* state_ptr) {
+      StatsState *state = reinterpret_cast<StatsState*>(state_ptr);
+      if (state->merging) {
+        mergePartials(thread_id, state);
+        return;
+      }
+
+      ColumnPartial *partial = state->partials[thread_id].get();
+      int const num_sparse = state->blocks.size();
+      threading::WorkItem item;
+      while (state->scheduler->next(thread_id, &item)) {
+        for (int i = item.begin; i < item.end; i++) {
+          if (i < num_sparse) {
+            scanSparseBlock(state->blocks[i], state->first_rows[i], partial, state->stats);
+          } else {
+            scanDenseBlock(state->dense_blocks[i - num_sparse], state->first_rows[i], partial, state->stats);
+          }
+        }
+      }
+      state->scheduler->finish(thread_id);
+    }
+
+    // Identifies a stats file and its layout version.
+    std::uint32_t const kStatsMagic = 0x0BA5A002;
+
+    template<class T>
+    void writeVector(std::ofstream &file, std::vector<T> const & vec) {
+      file.write(reinterpret_cast<char const*>(vec.data()), sizeof(T) * vec.size());
+    }
+
+    template<class T>
+    void readVector(std::ifstream &file, std::vector<T> *vec) {
+      file.read(reinterpret_cast<char*>(vec->data()), sizeof(T) * vec->size());
+    }
+
+  } // namespace
+
+  MatrixStats* MatrixStats::Compute(std::vector<SparseDataBlock<num_t>*> const & blocks,
+                                    std::vector<DenseDataBlock<num_t>*> const & dense_blocks,
+                                    int num_rows,
+                                    int num_columns) {
+    DCHECK(blocks.empty() || dense_blocks.empty());
+    MatrixStats *stats = new MatrixStats(num_rows, num_columns);
+    int const num_blocks = blocks.size() + dense_blocks.size();
+    if (num_blocks == 0) {
+      return stats;
+    }
+
+    int const num_threads = std::max(std::min(threading::numCores(), num_blocks), 1);
+    StatsState state(blocks, dense_blocks, stats, num_threads);
+    DCHECK_EQ(num_rows, state.first_rows.back()
+                        + (dense_blocks.empty() ? blocks.back()->getNumRows() : dense_blocks.back()->getNumRows()));
+
+    ThreadPool tp(statsHelper, &state, num_threads);
+    tp.begin();
+    tp.cycle();
+    state.merging = true;
+    tp.cycle();
+    tp.stop();
+
+    for (auto const & partial : state.partials) {
+      stats->nnz += partial->nnz;
+    }
+    return stats;
+  }
+
+  bool MatrixStats::save(const std::string& file_name) const {
+    std::ofstream file(file_name, std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+      return false;
+    }
+    std::int32_t const num_rows = numRows();
+    std::int32_t const num_columns = numColumns();
+    file.write(reinterpret_cast<char const*>(&kStatsMagic), sizeof(kStatsMagic));
+    file.write(reinterpret_cast<char const*>(&num_rows), sizeof(num_rows));
+    file.write(reinterpret_cast<char const*>(&num_columns), sizeof(num_columns));
+    file.write(reinterpret_cast<char const*>(&nnz), sizeof(nnz));
+    file.write(reinterpret_cast<char const*>(&source_size), sizeof(source_size));
+    file.write(reinterpret_cast<char const*>(&source_mtime_ns), sizeof(source_mtime_ns));
+    writeVector(file, degrees);
+    writeVector(file, sums);
+    writeVector(file, sums_sq);
+    writeVector(file, mins);
+    writeVector(file, maxes);
+    writeVector(file, row_nnz);
+    writeVector(file, row_norms);
+    return file.good();
+  }
+
+  MatrixStats* MatrixStats::Load(const std::string& file_name) {
+    std::ifstream file(file_name, std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+      return nullptr;
+    }
+    std::uint32_t magic = 0;
+    std::int32_t num_rows = -1;
+    std::int32_t num_columns = -1;
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char*>(&num_rows), sizeof(num_rows));
+    file.read(reinterpret_cast<char*>(&num_columns), sizeof(num_columns));
+    if (!file.good() || magic != kStatsMagic || num_rows < 0 || num_columns < 0) {
+      return nullptr;
+    }
+
+    std::unique_ptr<MatrixStats> stats(new MatrixStats(num_rows, num_columns));
+    file.read(reinterpret_cast<char*>(&stats->nnz), sizeof(stats->nnz));
+    file.read(reinterpret_cast<char*>(&stats->source_size), sizeof(stats->source_size));
+    file.read(reinterpret_cast<char*>(&stats->source_mtime_ns), sizeof(stats->source_mtime_ns));
+    readVector(file, &stats->degrees);
+    readVector(file, &stats->sums);
+    readVector(file, &stats->sums_sq);
+    readVector(file, &stats->mins);
+    readVector(file, &stats->maxes);
+    readVector(file, &stats->row_nnz);
+    readVector(file, &stats->row_norms);
+    if (!file.good()) {
+      return nullptr;
+    }
+    return stats.release();
+  }
+
+} // namespace obamadb
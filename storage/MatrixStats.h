@@ -0,0 +1,90 @@
+#ifndef OBAMADB_MATRIXSTATS_H
+#define OBAMADB_MATRIXSTATS_H
+
+#include "storage/DenseDataBlock.h"
+#include "storage/SparseDataBlock.h"
+#include "storage/StorageConstants.h"
+#include "storage/Utils.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace obamadb {
+
+  /**
+   * A catalog of per-column and per-row statistics of a matrix, computed in a single parallel pass
+   * over its blocks. Consumers (SVM parameters, partitioning, projection) read it instead of
+   * rescanning the data.
+   *
+   * Column min and max are taken over the stored (nonzero) values only. The number of implicit
+   * zeros in a column is numRows() - degrees[column].
+   */
+  class MatrixStats {
+  public:
+    MatrixStats(int num_rows, int num_columns)
+      : nnz(0),
+        source_size(-1),
+        source_mtime_ns(-1),
+        degrees(num_columns, 0),
+        sums(num_columns, 0),
+        sums_sq(num_columns, 0),
+        mins(num_columns, 0),
+        maxes(num_columns, 0),
+        row_nnz(num_rows, 0),
+        row_norms(num_rows, 0) {}
+
+    /**
+     * Computes the statistics of a matrix on a pool of threads. Rows are numbered in block order.
+     * A matrix holds either sparse or dense blocks, so one of the block lists should be empty.
+     *
+     * @return Caller-owned statistics.
+     */
+    static MatrixStats* Compute(std::vector<SparseDataBlock<num_t>*> const & blocks,
+                                std::vector<DenseDataBlock<num_t>*> const & dense_blocks,
+                                int num_rows,
+                                int num_columns);
+
+    /**
+     * Writes the statistics in a binary format.
+     * @return False if the file could not be written.
+     */
+    bool save(const std::string& file_name) const;
+
+    /**
+     * @return Caller-owned statistics, or nullptr if the file does not exist or is malformed.
+     */
+    static MatrixStats* Load(const std::string& file_name);
+
+    int numRows() const {
+      return row_nnz.size();
+    }
+
+    int numColumns() const {
+      return degrees.size();
+    }
+
+    std::uint64_t nnz;
+
+    // The size in bytes and the modification time of the data file the statistics were computed
+    // from, which tell a cache of them that the file has changed. -1 if not known.
+    std::int64_t source_size;
+    std::int64_t source_mtime_ns;
+
+    // Per column.
+    std::vector<int> degrees; // number of nonzero values.
+    std::vector<double> sums;
+    std::vector<double> sums_sq;
+    std::vector<num_t> mins;
+    std::vector<num_t> maxes;
+
+    // Per row.
+    std::vector<int> row_nnz;
+    std::vector<num_t> row_norms; // L2 norm.
+
+    DISABLE_COPY_AND_ASSIGN(MatrixStats);
+  };
+
+} // namespace obamadb
+
+#endif //OBAMADB_MATRIXSTATS_H
@@ -0,0 +1,103 @@
+#include "storage/ModelReplicas.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include "glog/logging.h"
+
+namespace obamadb {
+
+  bool ParseReplicationPolicy(std::string const & name, ReplicationPolicy *policy) {
+    static std::map<std::string, ReplicationPolicy> const kPolicies = {
+      {"shared", ReplicationPolicy::kShared},
+      {"socket", ReplicationPolicy::kPerSocket},
+      {"core", ReplicationPolicy::kPerCore},
+    };
+    auto it = kPolicies.find(name);
+    if (it == kPolicies.end()) {
+      return false;
+    }
+    *policy = it->second;
+    return true;
+  }
+
+  std::string ReplicationPolicyName(ReplicationPolicy policy) {
+    switch (policy) {
+      case ReplicationPolicy::kShared:
+        return "shared";
+      case ReplicationPolicy::kPerSocket:
+        return "socket";
+      case ReplicationPolicy::kPerCore:
+        return "core";
+    }
+    return "unknown";
+  }
+
+  std::vector<int> AssignReplicas(ReplicationPolicy policy,
+                                  std::vector<int> const & cores,
+                                  threading::CpuTopology const & topology) {
+    // Cpus missing from the topology, e.g. when affinities wrap, count as their own socket and core.
+    std::map<int, std::pair<int, int>> locations;
+    for (threading::CpuInfo const & info : topology.getCpus()) {
+      locations[info.cpu] = std::make_pair(info.socket, info.core);
+    }
+
+    std::map<std::pair<int, int>, int> replica_ids;
+    std::vector<int> replicas;
+    for (int cpu : cores) {
+      auto it = locations.find(cpu);
+      std::pair<int, int> location = it == locations.end() ? std::make_pair(-1 - cpu, 0) : it->second;
+      if (policy == ReplicationPolicy::kShared) {
+        location = std::make_pair(0, 0);
+      } else if (policy == ReplicationPolicy::kPerSocket) {
+        location.second = 0;
+      }
+      auto const inserted = replica_ids.insert(std::make_pair(location, (int) replica_ids.size()));
+      replicas.push_back(inserted.first->second);
+    }
+    return replicas;
+  }
+
+  ModelReplicas::ModelReplicas(fvector const & model, std::vector<int> const & worker_replicas)
+    : worker_replicas_(worker_replicas),
+      replicas_(),
+      counters_(new RowCounter[worker_replicas.size()]),
+      num_workers_(worker_replicas.size()),
+      merges_(0) {
+    CHECK(!worker_replicas_.empty());
+    int const num_replicas = *std::max_element(worker_replicas_.begin(), worker_replicas_.end()) + 1;
+    for (int r = 0; r < num_replicas; r++) {
+      replicas_.push_back(std::unique_ptr<fvector>(new fvector(model)));
+    }
+  }
+
+  void ModelReplicas::average(fvector *model) {
+    int const num_replicas = replicas_.size();
+    int const dimension = replicas_[0]->dimension_;
+    num_t const scale = static_cast<num_t>(1) / num_replicas;
+    for (int i = 0; i < dimension; i++) {
+      num_t sum = 0;
+      for (int r = 0; r < num_replicas; r++) {
+        sum += replicas_[r]->values_[i];
+      }
+      num_t const mean = sum * scale;
+      for (int r = 0; r < num_replicas; r++) {
+        replicas_[r]->values_[i] = mean;
+      }
+      if (model != nullptr) {
+        model->values_[i] = mean;
+      }
+    }
+    merges_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::int64_t ModelReplicas::getRows() const {
+    std::int64_t rows = 0;
+    for (int w = 0; w < num_workers_; w++) {
+      rows += counters_[w].rows.load(std::memory_order_relaxed);
+    }
+    return rows;
+  }
+
+} // namespace obamadb
@@ -0,0 +1,109 @@
+#ifndef OBAMADB_MODELREPLICAS_H_
+#define OBAMADB_MODELREPLICAS_H_
+
+#include "storage/Topology.h"
+#include "storage/Utils.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace obamadb {
+
+  /**
+   * How many copies of the model the training workers update (DimmWitted, Zhang and Re 2014).
+   */
+  enum class ReplicationPolicy {
+    kShared,     // one model, updated by every worker.
+    kPerSocket,  // a replica per socket, updated by the workers bound to its cpus.
+    kPerCore,    // a replica per physical core, updated by the workers bound to its hyperthreads.
+  };
+
+  /**
+   * @return False if the name does not name a policy.
+   */
+  bool ParseReplicationPolicy(std::string const & name, ReplicationPolicy *policy);
+
+  std::string ReplicationPolicyName(ReplicationPolicy policy);
+
+  /**
+   * @param cores The cpu each worker is bound to.
+   * @return The replica of each worker. Replicas are numbered from 0 in order of their first worker.
+   */
+  std::vector<int> AssignReplicas(ReplicationPolicy policy,
+                                  std::vector<int> const & cores,
+                                  threading::CpuTopology const & topology);
+
+  /**
+   * Copies of a model, each updated Hogwild-style by its own group of workers, and merged by
+   * averaging. Workers on different sockets (or cores) then never write the same cache lines
+   * between merges.
+   */
+  class ModelReplicas {
+  public:
+    /**
+     * @param model The initial value of every replica.
+     * @param worker_replicas The replica of each worker, see AssignReplicas.
+     */
+    ModelReplicas(fvector const & model, std::vector<int> const & worker_replicas);
+
+    /**
+     * @return The replica the worker should update.
+     */
+    fvector* getReplica(int worker) {
+      return replicas_[worker_replicas_[worker]].get();
+    }
+
+    int getNumReplicas() const {
+      return replicas_.size();
+    }
+
+    /**
+     * Sets every replica to the replicas' mean. May run while workers update the replicas, in which
+     * case an update made to a feature between its averaging and its write-back is lost, as updates
+     * can be in Hogwild.
+     * @param model If not null, also set to the mean.
+     */
+    void average(fvector *model);
+
+    /**
+     * The worker's count of trained rows, for merging every so many rows. Only the worker writes it.
+     */
+    std::atomic<std::int64_t>* getRowCounter(int worker) {
+      return &counters_[worker].rows;
+    }
+
+    /**
+     * @return The rows trained by all the workers so far.
+     */
+    std::int64_t getRows() const;
+
+    /**
+     * @return The number of calls to average() so far.
+     */
+    int getNumMerges() const {
+      return merges_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct RowCounter {
+      RowCounter() : rows(0) {}
+
+      std::atomic<std::int64_t> rows;
+      char padding[64];
+    };
+
+    std::vector<int> const worker_replicas_;
+    std::vector<std::unique_ptr<fvector>> replicas_;
+    std::unique_ptr<RowCounter[]> counters_;
+    int const num_workers_;
+    std::atomic<int> merges_;
+
+    DISABLE_COPY_AND_ASSIGN(ModelReplicas);
+  };
+
+} // namespace obamadb
+
+#endif //OBAMADB_MODELREPLICAS_H_
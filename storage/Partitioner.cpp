@@ -0,0 +1,228 @@
+#include "storage/Partitioner.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <queue>
+
+#include "glog/logging.h"
+
+namespace obamadb {
+
+  namespace {
+
+    // The cost of visiting a row, whatever its length, in units of one nonzero.
+    std::int64_t const kRowOverhead = 1;
+
+    // Longest-first cuts blocks into pieces costing at most a part's share divided by this. Greedy
+    // assignment leaves the slowest part at most one piece above the mean.
+    int const kPiecesPerShare = 4;
+
+    /**
+     * A run of rows of one block and their total cost.
+     */
+    struct Piece {
+      Piece(RowSlice slice, std::int64_t cost)
+        : slice(slice), cost(cost) {}
+
+      RowSlice slice;
+      std::int64_t cost;
+    };
+
+    std::int64_t sumCosts(std::vector<std::int64_t> const & row_costs, int begin, int end) {
+      std::int64_t sum = 0;
+      for (int i = begin; i < end; i++) {
+        sum += row_costs[i];
+      }
+      return sum;
+    }
+
+    /**
+     * Cuts a sequence of rows into num_parts runs of about equal cost. Each row goes to the part
+     * holding its midpoint, so a part boundary is never more than half a row away from its ideal.
+     * @param visit Called with each row and its part, in row order.
+     */
+    void cutByPrefixSum(RowCosts const & costs,
+                        int first_block,
+                        int last_block,
+                        std::int64_t total,
+                        int num_parts,
+                        std::function<void(int block, int row, int part)> const & visit) {
+      std::int64_t prefix = 0;
+      for (int b = first_block; b <= last_block; b++) {
+        for (int r = 0; r < costs[b].size(); r++) {
+          std::int64_t const midpoint2 = 2 * prefix + costs[b][r];
+          int const part = static_cast<int>(std::min<std::int64_t>(num_parts - 1, midpoint2 * num_parts / (2 * total)));
+          visit(b, r, part);
+          prefix += costs[b][r];
+        }
+      }
+    }
+
+    /**
+     * Appends a row to a part, extending the part's last slice when the row follows it.
+     */
+    void appendRow(std::vector<RowSlice> *part, int block, int row) {
+      if (!part->empty() && part->back().block == block && part->back().end == row) {
+        part->back().end++;
+      } else {
+        part->push_back(RowSlice(block, row, row + 1));
+      }
+    }
+
+    std::vector<std::vector<RowSlice>> partitionRoundRobin(RowCosts const & costs, int num_parts) {
+      std::vector<std::vector<RowSlice>> parts(num_parts);
+      for (int b = 0; b < costs.size(); b++) {
+        parts[b % num_parts].push_back(RowSlice(b, 0, costs[b].size()));
+      }
+      return parts;
+    }
+
+    std::vector<std::vector<RowSlice>> partitionContiguous(RowCosts const & costs,
+                                                           std::int64_t total,
+                                                           int num_parts) {
+      std::vector<std::vector<RowSlice>> parts(num_parts);
+      if (costs.empty()) {
+        return parts;
+      }
+      cutByPrefixSum(costs, 0, costs.size() - 1, total, num_parts, [&parts](int block, int row, int part) {
+        appendRow(&parts[part], block, row);
+      });
+      return parts;
+    }
+
+    std::vector<std::vector<RowSlice>> partitionLongestFirst(RowCosts const & costs,
+                                                             std::int64_t total,
+                                                             int num_parts) {
+      std::int64_t const max_piece = std::max<std::int64_t>(1, total / (num_parts * kPiecesPerShare));
+      std::vector<Piece> pieces;
+      for (int b = 0; b < costs.size(); b++) {
+        std::int64_t const block_cost = sumCosts(costs[b], 0, costs[b].size());
+        if (block_cost <= max_piece) {
+          pieces.push_back(Piece(RowSlice(b, 0, costs[b].size()), block_cost));
+          continue;
+        }
+        int const num_pieces = static_cast<int>((block_cost + max_piece - 1) / max_piece);
+        std::vector<std::vector<RowSlice>> cut(num_pieces);
+        cutByPrefixSum(costs, b, b, block_cost, num_pieces, [&cut](int block, int row, int part) {
+          appendRow(&cut[part], block, row);
+        });
+        for (auto const & piece : cut) {
+          if (!piece.empty()) {
+            pieces.push_back(Piece(piece[0], sumCosts(costs[b], piece[0].begin, piece[0].end)));
+          }
+        }
+      }
+      std::stable_sort(pieces.begin(), pieces.end(), [](Piece const & a, Piece const & b) {
+        return a.cost > b.cost;
+      });
+
+      // (load, part), least loaded and then lowest numbered first.
+      typedef std::pair<std::int64_t, int> Load;
+      std::priority_queue<Load, std::vector<Load>, std::greater<Load>> loads;
+      for (int p = 0; p < num_parts; p++) {
+        loads.push(Load(0, p));
+      }
+      std::vector<std::vector<RowSlice>> parts(num_parts);
+      for (Piece const & piece : pieces) {
+        Load least = loads.top();
+        loads.pop();
+        parts[least.second].push_back(piece.slice);
+        loads.push(Load(least.first + piece.cost, least.second));
+      }
+      // Visit each part's rows in storage order.
+      for (auto & part : parts) {
+        std::sort(part.begin(), part.end(), [](RowSlice const & a, RowSlice const & b) {
+          return a.block < b.block || (a.block == b.block && a.begin < b.begin);
+        });
+      }
+      return parts;
+    }
+
+  } // namespace
+
+  bool ParsePartitionPolicy(std::string const & name, PartitionPolicy *policy) {
+    static std::map<std::string, PartitionPolicy> const kPolicies = {
+      {"round-robin", PartitionPolicy::kRoundRobin},
+      {"longest-first", PartitionPolicy::kLongestFirst},
+      {"contiguous", PartitionPolicy::kContiguous},
+    };
+    auto it = kPolicies.find(name);
+    if (it == kPolicies.end()) {
+      return false;
+    }
+    *policy = it->second;
+    return true;
+  }
+
+  std::string PartitionPolicyName(PartitionPolicy policy) {
+    switch (policy) {
+      case PartitionPolicy::kRoundRobin:
+        return "round-robin";
+      case PartitionPolicy::kLongestFirst:
+        return "longest-first";
+      case PartitionPolicy::kContiguous:
+        return "contiguous";
+    }
+    return "unknown";
+  }
+
+  RowCosts GetRowCosts(std::vector<SparseDataBlock<num_t>*> const & blocks, MatrixStats const & stats) {
+    RowCosts costs(blocks.size());
+    int row = 0;
+    for (int b = 0; b < blocks.size(); b++) {
+      for (int i = 0; i < blocks[b]->getNumRows(); i++) {
+        DCHECK_LT(row, stats.numRows());
+        costs[b].push_back(stats.row_nnz[row++] + kRowOverhead);
+      }
+    }
+    return costs;
+  }
+
+  RowCosts GetRowCosts(std::vector<DenseDataBlock<num_t>*> const & blocks, MatrixStats const & stats) {
+    RowCosts costs(blocks.size());
+    for (int b = 0; b < blocks.size(); b++) {
+      costs[b].assign(blocks[b]->getNumRows(), stats.numColumns() + kRowOverhead);
+    }
+    return costs;
+  }
+
+  std::vector<std::vector<RowSlice>> PartitionRows(RowCosts const & costs,
+                                                   int num_parts,
+                                                   PartitionPolicy policy) {
+    CHECK_LT(0, num_parts);
+    std::int64_t total = 0;
+    for (auto const & block_costs : costs) {
+      total += sumCosts(block_costs, 0, block_costs.size());
+    }
+    if (total == 0 && policy != PartitionPolicy::kRoundRobin) {
+      // Nothing to balance.
+      return partitionRoundRobin(costs, num_parts);
+    }
+
+    switch (policy) {
+      case PartitionPolicy::kRoundRobin:
+        return partitionRoundRobin(costs, num_parts);
+      case PartitionPolicy::kLongestFirst:
+        return partitionLongestFirst(costs, total, num_parts);
+      case PartitionPolicy::kContiguous:
+        return partitionContiguous(costs, total, num_parts);
+    }
+    LOG(FATAL) << "unknown partition policy";
+    return {};
+  }
+
+  std::vector<std::int64_t> GetPartCosts(RowCosts const & costs,
+                                         std::vector<std::vector<RowSlice>> const & parts) {
+    std::vector<std::int64_t> part_costs;
+    for (auto const & part : parts) {
+      std::int64_t cost = 0;
+      for (RowSlice const & slice : part) {
+        cost += sumCosts(costs[slice.block], slice.begin, slice.end);
+      }
+      part_costs.push_back(cost);
+    }
+    return part_costs;
+  }
+
+} // namespace obamadb
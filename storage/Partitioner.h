@@ -0,0 +1,91 @@
+#ifndef OBAMADB_PARTITIONER_H_
+#define OBAMADB_PARTITIONER_H_
+
+#include "storage/DenseDataBlock.h"
+#include "storage/MatrixStats.h"
+#include "storage/SparseDataBlock.h"
+#include "storage/StorageConstants.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace obamadb {
+
+  /**
+   * How the rows of a matrix are divided amongst the training threads.
+   */
+  enum class PartitionPolicy {
+    kRoundRobin,    // whole blocks dealt out by count, ignoring their cost.
+    kLongestFirst,  // blocks, the most costly first, each to the least loaded part. Blocks costing
+                    // more than a quarter of a part's share are first cut into pieces of about that.
+    kContiguous,    // the rows in block order cut into runs of equal cost, splitting blocks at row
+                    // granularity.
+  };
+
+  /**
+   * @return False if the name does not name a policy.
+   */
+  bool ParsePartitionPolicy(std::string const & name, PartitionPolicy *policy);
+
+  std::string PartitionPolicyName(PartitionPolicy policy);
+
+  /**
+   * The rows [begin, end) of a block.
+   */
+  struct RowSlice {
+    RowSlice(int block, int begin, int end)
+      : block(block), begin(begin), end(end) {}
+
+    int block;
+    int begin;
+    int end;
+  };
+
+  /**
+   * The cost of each row of each block, in the same units.
+   */
+  typedef std::vector<std::vector<std::int64_t>> RowCosts;
+
+  /**
+   * An SGD step on a sparse row costs about its number of nonzeros, plus a fixed overhead per row.
+   * @param stats Statistics of the matrix holding the blocks, which numbers rows in block order.
+   */
+  RowCosts GetRowCosts(std::vector<SparseDataBlock<num_t>*> const & blocks, MatrixStats const & stats);
+
+  /**
+   * A dense row costs its number of columns, whatever its values.
+   */
+  RowCosts GetRowCosts(std::vector<DenseDataBlock<num_t>*> const & blocks, MatrixStats const & stats);
+
+  /**
+   * Divides the rows of the blocks into parts. Every row belongs to exactly one part, and the slices
+   * of a part are ordered by block and row. A part may be empty if there are fewer rows than parts.
+   *
+   * @return The slices of each part.
+   */
+  std::vector<std::vector<RowSlice>> PartitionRows(RowCosts const & costs,
+                                                   int num_parts,
+                                                   PartitionPolicy policy);
+
+  /**
+   * @return The total cost of each part.
+   */
+  std::vector<std::int64_t> GetPartCosts(RowCosts const & costs,
+                                         std::vector<std::vector<RowSlice>> const & parts);
+
+  /**
+   * Splits [0, num_items) of equally costly items into contiguous ranges whose sizes differ by at
+   * most one.
+   * @return The range [first, second) of the given part.
+   */
+  inline std::pair<int, int> EvenSplit(int num_items, int num_parts, int part) {
+    std::int64_t const begin = static_cast<std::int64_t>(num_items) * part / num_parts;
+    std::int64_t const end = static_cast<std::int64_t>(num_items) * (part + 1) / num_parts;
+    return std::make_pair(static_cast<int>(begin), static_cast<int>(end));
+  }
+
+} // namespace obamadb
+
+#endif //OBAMADB_PARTITIONER_H_
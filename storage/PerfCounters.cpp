@@ -0,0 +1,144 @@
+#include "storage/PerfCounters.h"
+
+#include "storage/ThreadPool.h"
+
+#include <cstring>
+
+#if !APPLE
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace obamadb {
+
+  namespace {
+
+#if !APPLE
+    std::uint64_t cacheConfig(std::uint64_t cache, std::uint64_t op, std::uint64_t result) {
+      return cache | (op << 8) | (result << 16);
+    }
+
+    int openEvent(PerfEvent event) {
+      struct perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      switch (event) {
+        case kPerfCycles:
+          attr.type = PERF_TYPE_HARDWARE;
+          attr.config = PERF_COUNT_HW_CPU_CYCLES;
+          break;
+        case kPerfInstructions:
+          attr.type = PERF_TYPE_HARDWARE;
+          attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+          break;
+        case kPerfStalledCyclesBackend:
+          attr.type = PERF_TYPE_HARDWARE;
+          attr.config = PERF_COUNT_HW_STALLED_CYCLES_BACKEND;
+          break;
+        case kPerfL1DReadMisses:
+          attr.type = PERF_TYPE_HW_CACHE;
+          attr.config = cacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                                    PERF_COUNT_HW_CACHE_RESULT_MISS);
+          break;
+        case kPerfLLCMisses:
+          attr.type = PERF_TYPE_HARDWARE;
+          attr.config = PERF_COUNT_HW_CACHE_MISSES;
+          break;
+        case kPerfNodeMisses:
+          attr.type = PERF_TYPE_HW_CACHE;
+          attr.config = cacheConfig(PERF_COUNT_HW_CACHE_NODE, PERF_COUNT_HW_CACHE_OP_READ,
+                                    PERF_COUNT_HW_CACHE_RESULT_MISS);
+          break;
+        default:
+          return -1;
+      }
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      // The calling thread, on whichever cpu it runs.
+      return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+
+  } // namespace
+
+  PerfCounters::PerfCounters() {
+    for (int i = 0; i < kNumPerfEvents; i++) {
+#if APPLE
+      fds_[i] = -1;
+#else
+      fds_[i] = openEvent(static_cast<PerfEvent>(i));
+#endif
+      begin_[i] = 0;
+    }
+  }
+
+  PerfCounters::~PerfCounters() {
+    for (int i = 0; i < kNumPerfEvents; i++) {
+      if (fds_[i] >= 0) {
+        close(fds_[i]);
+      }
+    }
+  }
+
+  void PerfCounters::start() {
+    for (int i = 0; i < kNumPerfEvents; i++) {
+      if (fds_[i] >= 0) {
+        begin_[i] = read(static_cast<PerfEvent>(i));
+      }
+    }
+  }
+
+  PerfSample PerfCounters::stop() const {
+    PerfSample sample;
+    for (int i = 0; i < kNumPerfEvents; i++) {
+      if (fds_[i] >= 0) {
+        sample.values[i] = read(static_cast<PerfEvent>(i)) - begin_[i];
+      }
+    }
+    return sample;
+  }
+
+  bool PerfCounters::anyAvailable() const {
+    for (int i = 0; i < kNumPerfEvents; i++) {
+      if (fds_[i] >= 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::int64_t PerfCounters::read(PerfEvent event) const {
+    // value, time enabled, time running.
+    std::uint64_t values[3] = {0, 0, 0};
+    if (::read(fds_[event], values, sizeof(values)) != sizeof(values) || values[2] == 0) {
+      return 0;
+    }
+    if (values[2] < values[1]) {
+      // The counter was multiplexed, so extrapolate to the whole time it was enabled.
+      return static_cast<std::int64_t>(static_cast<double>(values[0]) * values[1] / values[2]);
+    }
+    return values[0];
+  }
+
+  char const * PerfCounters::EventName(PerfEvent event) {
+    switch (event) {
+      case kPerfCycles:
+        return "cycles";
+      case kPerfInstructions:
+        return "instructions";
+      case kPerfStalledCyclesBackend:
+        return "stalled_cycles_backend";
+      case kPerfL1DReadMisses:
+        return "l1d_read_misses";
+      case kPerfLLCMisses:
+        return "llc_misses";
+      case kPerfNodeMisses:
+        return "node_misses";
+      default:
+        return "unknown";
+    }
+  }
+
+} // namespace obamadb
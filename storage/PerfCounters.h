@@ -0,0 +1,96 @@
+#ifndef OBAMADB_PERFCOUNTERS_H_
+#define OBAMADB_PERFCOUNTERS_H_
+
+#include "storage/Utils.h"
+
+#include <cstdint>
+
+namespace obamadb {
+
+  /**
+   * Hardware events counted by PerfCounters.
+   */
+  enum PerfEvent {
+    kPerfCycles = 0,
+    kPerfInstructions,
+    kPerfStalledCyclesBackend,
+    kPerfL1DReadMisses,
+    kPerfLLCMisses,
+    kPerfNodeMisses, // accesses served by another NUMA node's memory.
+    kNumPerfEvents
+  };
+
+  /**
+   * Event counts over an interval. Events which could not be counted are -1.
+   */
+  struct PerfSample {
+    PerfSample() {
+      clear();
+    }
+
+    void clear() {
+      for (int i = 0; i < kNumPerfEvents; i++) {
+        values[i] = -1;
+      }
+    }
+
+    /**
+     * Adds the counts of another interval. An event is unavailable if it was in either.
+     */
+    void add(PerfSample const & other) {
+      for (int i = 0; i < kNumPerfEvents; i++) {
+        values[i] = values[i] < 0 || other.values[i] < 0 ? -1 : values[i] + other.values[i];
+      }
+    }
+
+    std::int64_t values[kNumPerfEvents];
+  };
+
+  /**
+   * Hardware performance counters of the thread which constructs it, read with perf_event_open. Each
+   * event is opened on its own, so that events which the kernel, the hardware or the permissions
+   * (see /proc/sys/kernel/perf_event_paranoid) do not allow are skipped while the others count.
+   * Counts are scaled when the kernel multiplexes the counters.
+   */
+  class PerfCounters {
+  public:
+    PerfCounters();
+
+    ~PerfCounters();
+
+    /**
+     * Starts an interval.
+     */
+    void start();
+
+    /**
+     * @return The counts since start().
+     */
+    PerfSample stop() const;
+
+    bool isAvailable(PerfEvent event) const {
+      return fds_[event] >= 0;
+    }
+
+    /**
+     * @return False if no event could be opened.
+     */
+    bool anyAvailable() const;
+
+    static char const * EventName(PerfEvent event);
+
+  private:
+    /**
+     * @return The scaled count of an open event.
+     */
+    std::int64_t read(PerfEvent event) const;
+
+    int fds_[kNumPerfEvents];
+    std::int64_t begin_[kNumPerfEvents];
+
+    DISABLE_COPY_AND_ASSIGN(PerfCounters);
+  };
+
+} // namespace obamadb
+
+#endif //OBAMADB_PERFCOUNTERS_H_
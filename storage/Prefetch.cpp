@@ -0,0 +1,30 @@
+#include "storage/Prefetch.h"
+
+#include <algorithm>
+
+#include "glog/logging.h"
+
+namespace obamadb {
+
+  PrefetchTuner::PrefetchTuner(std::vector<int> const & candidates)
+    : candidates_(candidates), times_() {
+    CHECK(!candidates_.empty());
+  }
+
+  PrefetchTuner::PrefetchTuner()
+    : PrefetchTuner({0, 2, 4, 8, 16, 32}) {}
+
+  int PrefetchTuner::distance() const {
+    if (!isTuned()) {
+      return candidates_[times_.size()];
+    }
+    return candidates_[std::min_element(times_.begin(), times_.end()) - times_.begin()];
+  }
+
+  void PrefetchTuner::record(double seconds) {
+    if (!isTuned()) {
+      times_.push_back(seconds);
+    }
+  }
+
+} // namespace obamadb
@@ -0,0 +1,84 @@
+#ifndef OBAMADB_PREFETCH_H_
+#define OBAMADB_PREFETCH_H_
+
+#include "storage/Utils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace obamadb {
+
+  // The number of rows ahead of the current one whose model entries are prefetched by default.
+  int const kDefaultPrefetchDistance = 8;
+
+  // Models smaller than this stay in cache, where prefetching only adds instructions.
+  std::size_t const kPrefetchMinModelBytes = 4 << 20;
+
+  /**
+   * @return The distance to prefetch at for a model of the given size, 0 if it fits in cache.
+   */
+  inline int prefetchDistanceFor(int distance, std::size_t model_bytes) {
+    return model_bytes < kPrefetchMinModelBytes ? 0 : distance;
+  }
+
+  /**
+   * Hints that the cache line holding an address will soon be written.
+   */
+  inline void prefetchForWrite(void const * address) {
+    __builtin_prefetch(address, 1, 3);
+  }
+
+  /**
+   * Hints that every cache line of [address, address + bytes) will soon be written.
+   */
+  inline void prefetchForWrite(void const * address, std::size_t bytes) {
+    std::uintptr_t const begin = reinterpret_cast<std::uintptr_t>(address) & ~std::uintptr_t(63);
+    std::uintptr_t const end = reinterpret_cast<std::uintptr_t>(address) + bytes;
+    for (std::uintptr_t line = begin; line < end; line += 64) {
+      prefetchForWrite(reinterpret_cast<void const *>(line));
+    }
+  }
+
+  /**
+   * Chooses a prefetch distance by timing whole epochs. Each candidate distance is used for one
+   * epoch, and then the distance whose epoch was fastest is kept. Prefetching does not change what
+   * is computed, so tuning costs no more than the epochs spent on slow candidates.
+   */
+  class PrefetchTuner {
+  public:
+    /**
+     * @param candidates Distances to try, in order. 0 disables prefetching.
+     */
+    PrefetchTuner(std::vector<int> const & candidates);
+
+    /**
+     * Tries 0 and powers of two up to 32.
+     */
+    PrefetchTuner();
+
+    /**
+     * @return The distance to use for the next epoch.
+     */
+    int distance() const;
+
+    /**
+     * Records the time of an epoch run with distance().
+     */
+    void record(double seconds);
+
+    /**
+     * @return True once every candidate has been timed.
+     */
+    bool isTuned() const {
+      return times_.size() >= candidates_.size();
+    }
+
+  private:
+    std::vector<int> candidates_;
+    std::vector<double> times_;
+  };
+
+} // namespace obamadb
+
+#endif //OBAMADB_PREFETCH_H_
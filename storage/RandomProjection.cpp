@@ -0,0 +1,19 @@
+#include "storage/RandomProjection.h"
+
+#include <cstring>
+
+namespace obamadb {
+
+  void ImplicitProjection::project(const svector<num_t> &row, num_t *dense_out) const {
+    memset(dense_out, 0, sizeof(num_t) * k_);
+    for (int e = 0; e < row.numElements(); e++) {
+      const int i = row.index_[e];
+      const num_t value = row.values_[e];
+      for (int j = 0; j < k_; j++) {
+        // R is mostly zeros, so add unconditionally rather than branch on the entry.
+        dense_out[j] += value * get(i, j);
+      }
+    }
+  }
+
+} // namespace obamadb
@@ -0,0 +1,104 @@
+#ifndef OBAMADB_RANDOMPROJECTION_H
+#define OBAMADB_RANDOMPROJECTION_H
+
+#include "storage/exvector.h"
+#include "storage/StorageConstants.h"
+#include "storage/Utils.h"
+
+#include <cmath>
+#include <cstdint>
+
+namespace obamadb {
+
+  /**
+   * A random projection matrix R with dimensions dimension x k which is never materialized. Each
+   * entry R[i][j] is computed on demand from a hash of (seed, i, j). Entries are in {-1, 0, 1} and
+   * appear with the same probabilities as those of GetRandomProjectionMatrix.
+   *
+   * Two projections with the same seed and k describe the same matrix, so a train and a test set
+   * can be projected consistently by sharing only the seed.
+   */
+  class ImplicitProjection {
+  public:
+    /**
+     * @param dimension The dimension (n columns) of the data set which we are compressing. Only used
+     *                  to choose the sparsity of R, column indices past it are still valid.
+     * @param k Determines the factor of compression for this data set (k << dimension).
+     * @param seed Identifies the projection matrix.
+     */
+    ImplicitProjection(int dimension, int k, std::uint64_t seed)
+      : dimension_(dimension),
+        k_(k),
+        seed_(seed),
+        hashed_seed_(hashInt64(seed)),
+        bound_neg1_(0),
+        bound_pos1_(0) {
+      CHECK_GT(dimension, 0);
+      CHECK_GT(k, 0);
+      std::uint32_t max_uint32 = 0;
+      max_uint32 -= 1;
+      bound_neg1_ = (1.0/(2.0*sqrt(dimension))) * max_uint32;
+      bound_pos1_ = bound_neg1_ * 2;
+    }
+
+    /**
+     * @param i Row of R, corresponds to a column of the data being projected.
+     * @param j Column of R, corresponds to a column of the projected data.
+     * @return The entry R[i][j], one of {-1, 0, 1}.
+     */
+    inline signed char get(int i, int j) const {
+      std::uint64_t const key = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(i)) << 32)
+                                | static_cast<std::uint32_t>(j);
+      std::uint32_t const rand = static_cast<std::uint32_t>(hashInt64(hashed_seed_ ^ key));
+      return rand < bound_neg1_ ? -1 : (rand < bound_pos1_ ? 1 : 0);
+    }
+
+    /**
+     * Computes row * R without normalization.
+     * @param row A row of the data being projected.
+     * @param dense_out Array of at least k elements which will hold the projected row.
+     */
+    void project(const svector<num_t> &row, num_t *dense_out) const;
+
+    /**
+     * The expected fraction of nonzero elements in a projected row. A projected element is zero
+     * when R has no nonzero entry in any of the row's columns.
+     * @param row_nnz Number of nonzero elements in the row before projection.
+     */
+    double expectedDensity(int row_nnz) const {
+      double const p_zero = 1.0 - 1.0 / sqrt(dimension_);
+      return 1.0 - std::pow(p_zero, row_nnz);
+    }
+
+    /**
+     * The constant by which A*R should be scaled so that distances are preserved in expectation.
+     * Entries of R have variance 1/sqrt(dimension), hence sqrt(sqrt(dimension) / k).
+     */
+    num_t normalizingConstant() const {
+      return static_cast<num_t>(std::sqrt(std::sqrt(static_cast<double>(dimension_)) / k_));
+    }
+
+    int getDimension() const {
+      return dimension_;
+    }
+
+    int getK() const {
+      return k_;
+    }
+
+    std::uint64_t getSeed() const {
+      return seed_;
+    }
+
+  private:
+    int dimension_;
+    int k_;
+    std::uint64_t seed_;
+    std::uint64_t hashed_seed_;
+    std::uint32_t bound_neg1_;
+    std::uint32_t bound_pos1_;
+  };
+
+} // namespace obamadb
+
+#endif //OBAMADB_RANDOMPROJECTION_H
@@ -1,5 +1,6 @@
 #include "storage/DataBlock.h"
 #include "storage/DataView.h"
+#include "storage/DenseDataBlock.h"
 #include "storage/exvector.h"
 #include "storage/MLTask.h"
 #include "storage/SparseDataBlock.h"
@@ -7,110 +8,1483 @@
 
 #include "storage/SVMTask.h"
 
-// comment this out depending on the test you are doing:
-// #define USE_HINGE 0
-// #define USE_SCALING 0
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <type_traits>
+#include <utility>
 
 namespace obamadb {
 
-  void SVMTask::execute(int threadId, void *svm_state) {
-    (void) svm_state; // silence compiler warning.
+  namespace {
 
-    data_view_->reset();
-    svector<num_t> row(0, nullptr);
-    num_t *theta = shared_theta_->values_;
-    const num_t mu = shared_params_->mu;
-    const num_t step_size = shared_params_->step_size;
-
-    // perform update with all the data in its view,
-    while (data_view_->getNext(&row)) {
-      num_t const y = *row.getClassification();
-      num_t wxy = ml::dot(row, theta);
-      wxy = wxy * y; // {-1, 1}
-
-#ifdef USE_HINGE
-      // apply the hinge function like in a normal SVM
-      if (wxy < 1) {
-        num_t const e = step_size * y;
-        // scale weights
-        ml::scaleAndAdd(theta, row, e);
+    inline int columnAt(int const *index, int i) {
+      return index[i];
+    }
+
+    /**
+     * A dense row's value i belongs to column i.
+     */
+    inline int columnAt(std::nullptr_t index, int i) {
+      (void) index;
+      return i;
+    }
+
+    /**
+     * Prefetches the model entries which a sparse row ahead of the current one will update, so that
+     * the random gathers from the model overlap with the current row's work.
+     * @param ahead Position of the row relative to the start of the batch, which may be past its end.
+     * @param scratch Row vector for reading rows after the batch.
+     * @param state The thread's update state, which may also prefetch its state of the entries.
+     */
+    template<class Model, class State>
+    inline void prefetchAhead(DataView const *data_view,
+                              SparseRowBatch const &batch,
+                              int ahead,
+                              svector<num_t> *scratch,
+                              Model const *model,
+                              State const &state) {
+      int const *index;
+      int length;
+      if (ahead < batch.size) {
+        index = batch.index(ahead);
+        length = batch.length(ahead);
+      } else if (data_view->peek(ahead - batch.size + 1, scratch)) {
+        index = scratch->index_;
+        length = scratch->num_elements_;
+      } else {
+        return;
+      }
+      for (int i = 0; i < length; i++) {
+        prefetchForWrite(model + index[i]);
+        state.prefetch(index[i]);
+      }
+    }
+
+    /**
+     * A dense row updates the model in order, which the hardware prefetches already.
+     */
+    template<class Model, class State>
+    inline void prefetchAhead(DataView const *data_view,
+                              DenseRowBatch const &batch,
+                              int ahead,
+                              svector<num_t> *scratch,
+                              Model const *model,
+                              State const &state) {
+      (void) data_view;
+      (void) batch;
+      (void) ahead;
+      (void) scratch;
+      (void) model;
+      (void) state;
+    }
+
+    /**
+     * @return The weight of a feature of a plain model.
+     */
+    inline num_t* weightAt(num_t *model, int column) {
+      return model + column;
+    }
+
+    /**
+     * @return The weight of a feature of an AdaGrad model.
+     */
+    inline num_t* weightAt(AdaGradEntry *model, int column) {
+      return &model[column].weight;
+    }
+
+    /**
+     * The hinge loss, whose gradient is zero for rows classified with a margin of at least 1.
+     */
+    struct HingeLoss {
+      // Rows with a zero step are skipped.
+      static constexpr bool kSkipsRows = true;
+
+      /**
+       * @param wxy The row's margin, y * w.x.
+       * @param step The step size times the row's label.
+       * @return The multiple of the row to add to the model.
+       */
+      static inline num_t scale(num_t wxy, num_t step) {
+        return wxy < 1 ? step : 0;
+      }
+    };
+
+    /**
+     * The hinge loss, except that rows beyond the margin still take a small step back, so that every
+     * row writes the model as in the memory-access experiments of the Hogwild paper.
+     */
+    struct AlwaysUpdateLoss {
+      static constexpr bool kSkipsRows = false;
+
+      static inline num_t scale(num_t wxy, num_t step) {
+        return wxy < 1 ? step : step * -1 * 1e-3;
+      }
+    };
+
+    /**
+     * Model updates as plain loads and stores. Concurrent updates of a feature may be lost (Hogwild).
+     */
+    struct RacyConsistency {
+      struct Guard {
+        explicit Guard(SVMParams const *params) {
+          (void) params;
+        }
+      };
+
+      static inline num_t load(num_t const *x) {
+        return *x;
+      }
+
+      static inline void add(num_t *x, num_t delta) {
+        *x += delta;
+      }
+
+      static inline void scale(num_t *x, num_t factor) {
+        *x *= factor;
+      }
+
+      static inline num_t exchange(num_t *x, num_t value) {
+        num_t const old = *x;
+        *x = value;
+        return old;
+      }
+    };
+
+    /**
+     * Each feature is updated with a compare-and-swap, so no update is lost, although a row's
+     * margin may be computed from a model other rows are half way through updating.
+     */
+    struct AtomicConsistency {
+      typedef RacyConsistency::Guard Guard;
+
+      static inline num_t load(num_t const *x) {
+        num_t value;
+        __atomic_load(x, &value, __ATOMIC_RELAXED);
+        return value;
+      }
+
+      static inline void add(num_t *x, num_t delta) {
+        num_t expected = load(x);
+        num_t desired = expected + delta;
+        while (!__atomic_compare_exchange(x, &expected, &desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+          desired = expected + delta;
+        }
+      }
+
+      static inline void scale(num_t *x, num_t factor) {
+        num_t expected = load(x);
+        num_t desired = expected * factor;
+        while (!__atomic_compare_exchange(x, &expected, &desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+          desired = expected * factor;
+        }
+      }
+
+      static inline num_t exchange(num_t *x, num_t value) {
+        num_t old;
+        __atomic_exchange(x, &value, &old, __ATOMIC_RELAXED);
+        return old;
+      }
+    };
+
+    /**
+     * Each row's step, from computing its margin to its last write, holds the model's lock, so the
+     * steps are serializable.
+     */
+    struct LockedConsistency {
+      struct Guard {
+        explicit Guard(SVMParams const *params)
+          : lock(params->model_lock) {}
+
+        std::lock_guard<std::mutex> lock;
+      };
+
+      static inline num_t load(num_t const *x) {
+        return *x;
+      }
+
+      static inline void add(num_t *x, num_t delta) {
+        *x += delta;
+      }
+
+      static inline void scale(num_t *x, num_t factor) {
+        *x *= factor;
+      }
+
+      static inline num_t exchange(num_t *x, num_t value) {
+        return RacyConsistency::exchange(x, value);
+      }
+    };
+
+    /**
+     * The rows trained, for regularizers which depend on them. Rows are reserved a batch at a time,
+     * and the clock ticks after each row.
+     */
+    struct NoClock {
+      explicit NoClock(SVMParams const *params) {
+        (void) params;
+      }
+
+      inline void reserve(int rows) {
+        (void) rows;
+      }
+
+      inline void tick() {}
+
+      inline void prefetch(int column) const {
+        (void) column;
+      }
+    };
+
+    struct NoRegularization {
+      typedef NoClock Clock;
+
+      /**
+       * @return The feature's weight, brought up to date.
+       */
+      template<class Consistency, class Model>
+      static inline num_t load(Model *model, int column, Clock const & clock) {
+        (void) clock;
+        return Consistency::load(weightAt(model, column));
+      }
+
+      /**
+       * Applies any shrinkage deferred since the feature was last read, before it is written.
+       */
+      template<class Consistency, class Model>
+      static inline void catchUp(Model *model, int column, Clock const & clock) {
+        (void) model;
+        (void) column;
+        (void) clock;
+      }
+
+      template<class Consistency, class Index, class Model>
+      static inline void apply(Index index, int length, Model *model, SVMParams const *params) {
+        (void) index;
+        (void) length;
+        (void) model;
+        (void) params;
+      }
+    };
+
+    /**
+     * L2 regularization, applied only to the features a row updates, each shrunk in proportion to
+     * how few rows hold it (Hogwild's sparse separable regularizer).
+     */
+    struct DegreeScaling {
+      typedef NoClock Clock;
+
+      template<class Consistency, class Model>
+      static inline num_t load(Model *model, int column, Clock const & clock) {
+        return NoRegularization::load<Consistency>(model, column, clock);
+      }
+
+      template<class Consistency, class Model>
+      static inline void catchUp(Model *model, int column, Clock const & clock) {
+        NoRegularization::catchUp<Consistency>(model, column, clock);
+      }
+
+      template<class Consistency, class Index, class Model>
+      static inline void apply(Index index, int length, Model *model, SVMParams const *params) {
+        num_t const scalar = params->step_size * params->mu;
+        for (int i = length; i-- > 0;) {
+          const int idx_j = columnAt(index, i);
+          num_t const deg = params->degrees[idx_j];
+          Consistency::scale(weightAt(model, idx_j), 1 - scalar / deg);
+        }
+      }
+    };
+
+    /**
+     * L2 regularization of the whole model, each feature shrunk when it is next read, see LazyL2.
+     */
+    struct LazyL2Regularization {
+      struct Clock {
+        explicit Clock(SVMParams const *params)
+          : lazy_l2(params->lazy_l2.get()),
+            decay(lazy_l2->getRowDecay()),
+            scale(1),
+            inverse(1) {}
+
+        inline void reserve(int rows) {
+          scale = lazy_l2->getScale(lazy_l2->reserve(rows));
+          inverse = 1 / scale;
+        }
+
+        inline void tick() {
+          scale *= decay;
+          inverse /= decay;
+        }
+
+        inline void prefetch(int column) const {
+          prefetchForWrite(lazy_l2->getStamps() + column);
+        }
+
+        LazyL2 *lazy_l2;
+        double const decay;
+        // The model's global scale at the current row, and its inverse.
+        double scale;
+        double inverse;
+      };
+
+      template<class Consistency, class Model>
+      static inline num_t load(Model *model, int column, Clock const & clock) {
+        // Exchanging the stamp hands each interval's shrinkage to exactly one reader. A thread
+        // whose clock lags another's may grow the feature back by a fraction of a batch's shrinkage.
+        num_t const stamp = Consistency::exchange(clock.lazy_l2->getStamps() + column,
+                                                  static_cast<num_t>(clock.inverse));
+        num_t *weight = weightAt(model, column);
+        Consistency::scale(weight, static_cast<num_t>(clock.scale * stamp));
+        return Consistency::load(weight);
       }
-#else
-      // always apply the hinge loss, for memory-access
-      if (wxy < 1) {
-        num_t const e = step_size * y;
+
+      template<class Consistency, class Model>
+      static inline void catchUp(Model *model, int column, Clock const & clock) {
+        load<Consistency>(model, column, clock);
+      }
+
+      template<class Consistency, class Index, class Model>
+      static inline void apply(Index index, int length, Model *model, SVMParams const *params) {
+        NoRegularization::apply<Consistency>(index, length, model, params);
+      }
+    };
+
+    /**
+     * @return w.x of a row of a float model, each weight brought up to date as it is read.
+     */
+    template<class Consistency, class Regularizer, class Index, class Model>
+    inline num_t regularizedDot(Index index,
+                                num_t const *__restrict__ values,
+                                int length,
+                                Model *model,
+                                typename Regularizer::Clock const & clock) {
+      num_t wx = 0;
+      for (int i = 0; i < length; i++) {
+        wx += values[i] * Regularizer::template load<Consistency>(model, columnAt(index, i), clock);
+      }
+      return wx;
+    }
+
+    /**
+     * The per-thread state of optimizers which keep none.
+     */
+    struct NoOptimizerState {
+      explicit NoOptimizerState(SVMParams const *params) {
+        (void) params;
+      }
+    };
+
+    /**
+     * Every feature steps by the global step size times its gradient.
+     */
+    struct PlainSgd {
+      typedef num_t Model;
+      typedef NoOptimizerState State;
+
+      static Model* getModel(fvector *theta, SVMParams const *params) {
+        (void) params;
+        return theta->values_;
+      }
+
+      /**
+       * @return w.x of a row.
+       */
+      template<class Consistency, class Regularizer, class Index>
+      static inline num_t dot(Index index,
+                              num_t const *__restrict__ values,
+                              int length,
+                              Model *model,
+                              typename Regularizer::Clock const & clock,
+                              State *state) {
+        (void) state;
+        return regularizedDot<Consistency, Regularizer>(index, values, length, model, clock);
+      }
+
+      /**
+       * @return The step folded into the multiple of the row each row adds to the model.
+       */
+      static inline num_t rowStep(SVMParams const *params) {
+        return params->step_size;
+      }
+
+      /**
+       * @param delta The feature's gradient times the row step.
+       */
+      template<class Consistency>
+      static inline void update(Model *model, int column, num_t delta, SVMParams const *params, State *state) {
+        (void) params;
+        (void) state;
+        Consistency::add(model + column, delta);
+      }
+    };
+
+    /**
+     * AdaGrad: each feature steps by the global step size over the root of its summed squared
+     * gradients, so rare features keep taking larger steps than common ones.
+     */
+    struct AdaGrad {
+      typedef AdaGradEntry Model;
+      typedef NoOptimizerState State;
+
+      // Keeps a feature's first step finite should its gradient be zero.
+      static constexpr num_t kEpsilon = 1e-8;
+
+      static Model* getModel(fvector *theta, SVMParams const *params) {
+        DCHECK(params->adagrad);
+        DCHECK_EQ(theta->dimension_, params->adagrad->getDimension());
+        return params->adagrad->getEntries();
+      }
+
+      template<class Consistency, class Regularizer, class Index>
+      static inline num_t dot(Index index,
+                              num_t const *__restrict__ values,
+                              int length,
+                              Model *model,
+                              typename Regularizer::Clock const & clock,
+                              State *state) {
+        (void) state;
+        return regularizedDot<Consistency, Regularizer>(index, values, length, model, clock);
+      }
+
+      static inline num_t rowStep(SVMParams const *params) {
+        (void) params;
+        return 1;
+      }
+
+      template<class Consistency>
+      static inline void update(Model *model, int column, num_t delta, SVMParams const *params, State *state) {
+        (void) state;
+        AdaGradEntry *entry = model + column;
+        Consistency::add(&entry->accumulator, delta * delta);
+        num_t const accumulator = Consistency::load(&entry->accumulator);
+        Consistency::add(&entry->weight, params->step_size * delta / std::sqrt(accumulator + kEpsilon));
+      }
+    };
+
+    constexpr num_t AdaGrad::kEpsilon;
+
+    inline FixedPointModel<std::int8_t>* getFixedPointModel(SVMParams const *params, std::int8_t const *tag) {
+      (void) tag;
+      return params->fixed_point8.get();
+    }
+
+    inline FixedPointModel<std::int16_t>* getFixedPointModel(SVMParams const *params, std::int16_t const *tag) {
+      (void) tag;
+      return params->fixed_point16.get();
+    }
+
+    /**
+     * Plain SGD of a FixedPointModel. Each update is rounded stochastically to a whole number of the
+     * model's resolution, so an update smaller than the resolution still moves the weight by it with
+     * proportional probability, and the weights follow the float model's in expectation.
+     */
+    template<class T>
+    struct FixedPointSgd {
+      typedef T Model;
+
+      /**
+       * A thread's random number generator, seeded apart from the other threads'.
+       */
+      struct State {
+        explicit State(SVMParams const *params)
+          : rng(getFixedPointModel(params, static_cast<T const *>(nullptr))->nextSeed()),
+            resolution(getFixedPointModel(params, static_cast<T const *>(nullptr))->getResolution()),
+            inverse(1 / resolution) {}
+
+        RoundingRandom rng;
+        num_t const resolution;
+        num_t const inverse;
+      };
+
+      static Model* getModel(fvector *theta, SVMParams const *params) {
+        FixedPointModel<T> *fixed_point = getFixedPointModel(params, static_cast<T const *>(nullptr));
+        DCHECK(fixed_point != nullptr);
+        DCHECK_EQ(theta->dimension_, fixed_point->getDimension());
+        return fixed_point->getValues();
+      }
+
+      template<class Consistency, class Regularizer, class Index>
+      static inline num_t dot(Index index,
+                              num_t const *__restrict__ values,
+                              int length,
+                              Model *model,
+                              typename Regularizer::Clock const & clock,
+                              State *state) {
+        static_assert(std::is_same<Regularizer, NoRegularization>::value,
+                      "a fixed-point model is not regularized");
+        (void) clock;
+        return state->resolution * ml::fixedPointDot(index, values, length, model);
+      }
+
+      static inline num_t rowStep(SVMParams const *params) {
+        return params->step_size;
+      }
+
+      template<class Consistency>
+      static inline void update(Model *model, int column, num_t delta, SVMParams const *params, State *state) {
+        static_assert(std::is_same<Consistency, RacyConsistency>::value,
+                      "a fixed-point model is updated with plain loads and stores");
+        (void) params;
+        addStochastic(model + column, delta * state->inverse, &state->rng);
+      }
+    };
+
+    /**
+     * The SGD updates of one combination of loss, regularization, consistency and optimizer. Every
+     * choice is made at compile time, so the loops over a row carry no branches on the configuration.
+     */
+    template<class Loss, class Regularizer, class Consistency, class Optimizer>
+    struct SgdUpdate {
+      typedef typename Regularizer::Clock Clock;
+      typedef typename Optimizer::Model Model;
+
+      /**
+       * What a thread keeps between its rows: the regularizer's clock and the optimizer's state.
+       */
+      struct ThreadState {
+        explicit ThreadState(SVMParams const *params)
+          : clock(params),
+            optimizer(params) {}
+
+        inline void reserve(int rows) {
+          clock.reserve(rows);
+        }
+
+        inline void tick() {
+          clock.tick();
+        }
+
+        inline void prefetch(int column) const {
+          clock.prefetch(column);
+        }
+
+        Clock clock;
+        typename Optimizer::State optimizer;
+      };
+
+      /**
+       * @return The model the tasks update, whose weights may be stored other than in theta.
+       */
+      static Model* getModel(fvector *theta, SVMParams const *params) {
+        return Optimizer::getModel(theta, params);
+      }
+
+      /**
+       * @param index The row's column indices, or nullptr for a dense row.
+       * @return The multiple of the row to add to the model, 0 if the row adds nothing.
+       */
+      template<class Index>
+      static inline num_t stepScale(Index index,
+                                    num_t const *__restrict__ values,
+                                    int length,
+                                    num_t y,
+                                    Model *model,
+                                    SVMParams const *params,
+                                    ThreadState *state) {
+        num_t wxy = Optimizer::template dot<Consistency, Regularizer>(index, values, length, model, state->clock,
+                                                                       &state->optimizer);
+        wxy = wxy * y; // {-1, 1}
+        return Loss::scale(wxy, Optimizer::rowStep(params) * y);
+      }
+
+      /**
+       * The SGD update of one row.
+       */
+      template<class Index>
+      static inline void step(Index index,
+                              num_t const *__restrict__ values,
+                              int length,
+                              num_t y,
+                              Model *model,
+                              SVMParams const *params,
+                              ThreadState *state) {
+        typename Consistency::Guard guard(params);
+        num_t const e = stepScale(index, values, length, y, model, params, state);
+        if (Loss::kSkipsRows && e == 0) {
+          return;
+        }
         // scale weights
-        ml::scale_and_add(theta, row, e);
+        for (int i = 0; i < length; i++) {
+          Optimizer::template update<Consistency>(model, columnAt(index, i), values[i] * e, params,
+                                                  &state->optimizer);
+        }
+        Regularizer::template apply<Consistency>(index, length, model, params);
+      }
+
+      /**
+       * As step, but the update is added to a thread-local gradient rather than to the model. The
+       * row's read may still write the model, as lazy regularization brings features up to date.
+       */
+      template<class Index>
+      static inline void accumulate(Index index,
+                                    num_t const *__restrict__ values,
+                                    int length,
+                                    num_t y,
+                                    Model *model,
+                                    SVMParams const *params,
+                                    ThreadState *state,
+                                    GradientBuffer *gradient) {
+        typename Consistency::Guard guard(params);
+        num_t const e = stepScale(index, values, length, y, model, params, state);
+        if (Loss::kSkipsRows && e == 0) {
+          return;
+        }
+        for (int i = 0; i < length; i++) {
+          gradient->add(columnAt(index, i), values[i] * e);
+        }
+      }
+
+      /**
+       * Adds a mini-batch's gradient to the model, writing each feature it touched once, and clears
+       * it. Regularization shrinks each touched feature once. Deferred shrinkage is brought up to
+       * the current row first, so that the gradient is not shrunk by the rows before it was added.
+       */
+      static void apply(GradientBuffer *gradient, Model *model, SVMParams const *params, ThreadState *state) {
+        typename Consistency::Guard guard(params);
+        std::vector<int> const & columns = gradient->columns();
+        for (int column : columns) {
+          Regularizer::template catchUp<Consistency>(model, column, state->clock);
+          Optimizer::template update<Consistency>(model, column, gradient->take(column), params, &state->optimizer);
+        }
+        Regularizer::template apply<Consistency>(columns.data(), columns.size(), model, params);
+        gradient->clear();
+      }
+    };
+
+    /**
+     * One pass of SGD over all the rows of a view, read a batch at a time.
+     * @param Batch The batch type of the view's storage.
+     * @param gradient If not null, rows are summed into it and applied to the model every
+     *        params->minibatch_rows rows. Otherwise each row updates the model directly.
+     * @param rows_done If not null, advanced by the number of rows of each batch once it is trained.
+     */
+    template<class Update, class Batch>
+    void sgdEpoch(DataView *data_view,
+                  typename Update::Model *model,
+                  SVMParams const *params,
+                  GradientBuffer *gradient,
+                  std::atomic<std::int64_t> *rows_done) {
+      int const prefetch_distance = params->prefetch_distance;
+      int const minibatch_rows = params->minibatch_rows;
+      svector<num_t> scratch(0, nullptr);
+      Batch batch;
+      typename Update::ThreadState state(params);
+      std::int64_t rows = 0;
+      std::int64_t nonzeros = 0;
+      int pending_rows = 0;
+
+      // perform update with all the data in its view,
+      while (data_view->getNextBatch(Batch::kMaxRows, &batch)) {
+        rows += batch.size;
+        state.reserve(batch.size);
+        for (int r = 0; r < batch.size; r++, state.tick()) {
+          if (prefetch_distance > 0) {
+            prefetchAhead(data_view, batch, r + prefetch_distance, &scratch, model, state);
+          }
+          nonzeros += batch.length(r);
+          if (gradient == nullptr) {
+            Update::step(batch.index(r), batch.row(r), batch.length(r), batch.label(r), model, params, &state);
+            continue;
+          }
+          Update::accumulate(batch.index(r), batch.row(r), batch.length(r), batch.label(r), model, params, &state,
+                             gradient);
+          if (++pending_rows == minibatch_rows) {
+            Update::apply(gradient, model, params, &state);
+            pending_rows = 0;
+          }
+        }
+        if (rows_done != nullptr) {
+          rows_done->store(rows_done->load(std::memory_order_relaxed) + batch.size, std::memory_order_relaxed);
+        }
+      }
+      if (pending_rows > 0) {
+        Update::apply(gradient, model, params, &state);
+      }
+      threading::reportWork(rows, nonzeros);
+    }
+
+    /**
+     * Trains on the remaining rows of a view, choosing the batch type by the view's storage.
+     */
+    template<class Update>
+    void trainView(DataView *data_view,
+                   typename Update::Model *model,
+                   SVMParams const *params,
+                   GradientBuffer *gradient,
+                   std::atomic<std::int64_t> *rows_done) {
+      if (data_view->isDense()) {
+        sgdEpoch<Update, DenseRowBatch>(data_view, model, params, gradient, rows_done);
       } else {
-        num_t const e = step_size * y * -1 * 1e-3;
-        // scale weights
-        ml::scale_and_add(theta, row, e);
+        sgdEpoch<Update, SparseRowBatch>(data_view, model, params, gradient, rows_done);
       }
-#endif
+    }
 
-#ifdef USE_SCALING
-      num_t const scalar = step_size * mu;
-      // scale only the values which were updated.
-      for (int i = row.numElements(); i-- > 0;) {
-        const int idx_j = row.index_[i];
-        num_t const deg = shared_params_->degrees[idx_j];
-        theta[idx_j] *= 1 - scalar / deg;
+    /**
+     * One epoch of conflict-free batches. A worker's rows of a batch are whole components of the
+     * batch's conflict graph, so no other worker updates their features until the next batch.
+     */
+    template<class Update>
+    void cycladesEpoch(CycladesScheduler *cyclades,
+                       int worker,
+                       typename Update::Model *model,
+                       SVMParams const *params) {
+      svector<num_t> row(0, nullptr);
+      typename Update::ThreadState state(params);
+      std::int64_t rows = 0;
+      std::int64_t nonzeros = 0;
+      while (cyclades->nextBatch(worker)) {
+        std::vector<BatchRow> const & batch_rows = cyclades->getRows(worker);
+        state.reserve(batch_rows.size());
+        for (BatchRow const & batch_row : batch_rows) {
+          cyclades->getRow(batch_row, &row);
+          rows++;
+          nonzeros += row.num_elements_;
+          Update::step(row.index_, row.values_, row.num_elements_, *row.class_, model, params, &state);
+          state.tick();
+        }
       }
-#endif
+      threading::reportWork(rows, nonzeros);
     }
 
-    if (threadId == 0) {
-      shared_params_->step_size = step_size * shared_params_->step_decay;
+    /**
+     * Prefetches every model's weights of the features of a row ahead in the batch.
+     */
+    inline void prefetchModels(SparseRowBatch const &batch, int ahead, num_t const *model, int stride) {
+      if (ahead >= batch.size) {
+        return;
+      }
+      int const *index = batch.index(ahead);
+      for (int i = 0; i < batch.length(ahead); i++) {
+        prefetchForWrite(model + index[i] * stride, stride * sizeof(num_t));
+      }
+    }
+
+    inline void prefetchModels(DenseRowBatch const &batch, int ahead, num_t const *model, int stride) {
+      (void) batch;
+      (void) ahead;
+      (void) model;
+      (void) stride;
     }
+
+    /**
+     * The SGD update of one row for every model of a MultiSVMModel. The models are visited a vector
+     * of kLanes at a time, so the loops over the models have a constant trip count and vectorize.
+     * @param steps Each model's step size.
+     * @param shrinks Each model's step size times mu, when scaling by degree.
+     */
+    template<class Loss, bool kScaleByDegree, class Index>
+    inline void multiStep(Index index,
+                          num_t const *__restrict__ values,
+                          int length,
+                          num_t y,
+                          num_t *__restrict__ model,
+                          int stride,
+                          num_t const *__restrict__ steps,
+                          num_t const *__restrict__ shrinks,
+                          int const *degrees) {
+      int const kLanes = MultiSVMModel::kLanes;
+      for (int lane = 0; lane < stride; lane += kLanes) {
+        num_t wxy[kLanes] = {};
+        for (int i = 0; i < length; i++) {
+          num_t const *w = model + columnAt(index, i) * stride + lane;
+          for (int k = 0; k < kLanes; k++) {
+            wxy[k] += values[i] * w[k];
+          }
+        }
+        num_t e[kLanes];
+        bool updates = false;
+        for (int k = 0; k < kLanes; k++) {
+          e[k] = Loss::scale(wxy[k] * y, steps[lane + k] * y);
+          updates |= e[k] != 0;
+        }
+        if (Loss::kSkipsRows && !updates) {
+          continue;
+        }
+        for (int i = 0; i < length; i++) {
+          num_t *w = model + columnAt(index, i) * stride + lane;
+          for (int k = 0; k < kLanes; k++) {
+            w[k] += values[i] * e[k];
+          }
+        }
+        if (kScaleByDegree) {
+          // As in SgdUpdate::step, a model the row is skipped by is not shrunk.
+          num_t row_shrinks[kLanes];
+          for (int k = 0; k < kLanes; k++) {
+            row_shrinks[k] = Loss::kSkipsRows && e[k] == 0 ? 0 : shrinks[lane + k];
+          }
+          for (int i = 0; i < length; i++) {
+            int const column = columnAt(index, i);
+            num_t const deg = degrees[column];
+            num_t *w = model + column * stride + lane;
+            for (int k = 0; k < kLanes; k++) {
+              w[k] *= 1 - row_shrinks[k] / deg;
+            }
+          }
+        }
+      }
+    }
+
+    /**
+     * One pass over a view, updating every model of a MultiSVMModel with each row.
+     */
+    template<class Loss, bool kScaleByDegree, class Batch>
+    void multiEpoch(DataView *data_view, MultiSVMModel *multi_model, MultiSVMParams const *params) {
+      int const stride = multi_model->getStride();
+      num_t *model = multi_model->getValues();
+      int const prefetch_distance = params->prefetch_distance;
+      // Local copies, which the compiler can tell the model's stores do not change.
+      std::vector<num_t> const steps(params->step_sizes);
+      std::vector<num_t> shrinks(stride);
+      for (int k = 0; k < stride; k++) {
+        shrinks[k] = params->step_sizes[k] * params->mus[k];
+      }
+      Batch batch;
+      std::int64_t rows = 0;
+      std::int64_t nonzeros = 0;
+      while (data_view->getNextBatch(Batch::kMaxRows, &batch)) {
+        rows += batch.size;
+        for (int r = 0; r < batch.size; r++) {
+          if (prefetch_distance > 0) {
+            prefetchModels(batch, r + prefetch_distance, model, stride);
+          }
+          nonzeros += batch.length(r);
+          multiStep<Loss, kScaleByDegree>(batch.index(r), batch.row(r), batch.length(r), batch.label(r),
+                                          model, stride, steps.data(), shrinks.data(),
+                                          params->degrees.data());
+        }
+      }
+      threading::reportWork(rows, nonzeros);
+    }
+
+    template<class Loss, bool kScaleByDegree>
+    void multiTrainView(DataView *data_view, MultiSVMModel *model, MultiSVMParams const *params) {
+      if (data_view->isDense()) {
+        multiEpoch<Loss, kScaleByDegree, DenseRowBatch>(data_view, model, params);
+      } else {
+        multiEpoch<Loss, kScaleByDegree, SparseRowBatch>(data_view, model, params);
+      }
+    }
+
+    template<class Loss>
+    void multiTrainView(DataView *data_view, MultiSVMModel *model, MultiSVMParams const *params) {
+      switch (params->regularization) {
+        case SVMRegularization::kNone:
+          multiTrainView<Loss, false>(data_view, model, params);
+          return;
+        case SVMRegularization::kDegreeScaling:
+          multiTrainView<Loss, true>(data_view, model, params);
+          return;
+        default:
+          LOG(FATAL) << "multi-model training does not support "
+                     << SVMRegularizationName(params->regularization) << " regularization";
+      }
+    }
+
+    /**
+     * A thread's share of an evaluation: its sums, and the margins of each class for the AUC.
+     */
+    struct EvalPartial {
+      SVMMetrics metrics;
+      std::vector<num_t> positive_margins;
+      std::vector<num_t> negative_margins;
+    };
+
+    /**
+     * Adds a block's rows to a partial, computing each row's margin once for every metric.
+     * @param auc If true, also keeps each row's margin.
+     */
+    template<class Block, class V>
+    void evaluateBlock(const fvector &theta, const Block &block, bool auc, EvalPartial *partial) {
+      V row(0, nullptr);
+      std::int64_t misclassified = 0;
+      double hinge_loss = 0;
+      double squared_loss = 0;
+      for (int i = 0; i < block.getNumRows(); i++) {
+        block.getRowVectorFast(i, &row);
+        const num_t dot_prod = ml::dot(row, theta.values_);
+        const num_t classification = *row.class_;
+        DCHECK(classification == 1 || classification == -1) << "Expected binary classification.";
+
+        misclassified += (classification == 1 && dot_prod < 0) || (classification == -1 && dot_prod >= 0);
+        const num_t slack = 1 - dot_prod * classification;
+        hinge_loss += std::max(slack, static_cast<num_t >(0.0));
+        squared_loss += static_cast<double>(slack) * slack;
+        if (auc) {
+          (classification == 1 ? partial->positive_margins : partial->negative_margins).push_back(dot_prod);
+        }
+      }
+      partial->metrics.rows += block.getNumRows();
+      partial->metrics.misclassified += misclassified;
+      partial->metrics.hinge_loss += hinge_loss;
+      partial->metrics.squared_loss += squared_loss;
+    }
+
+    template<class Block, class Partial>
+    struct BlockPassState {
+      BlockPassState(std::vector<Block *> const &blocks,
+                     std::function<void(Block const &, Partial *)> const &block_fn,
+                     int num_threads)
+        : blocks(blocks),
+          block_fn(block_fn),
+          scheduler(num_threads, blocks.size(), 1),
+          slots(num_threads) {}
+
+      // Keeps each thread's partial on cache lines of its own.
+      struct Slot {
+        Partial partial;
+        char padding[64];
+      };
+
+      std::vector<Block *> const &blocks;
+      std::function<void(Block const &, Partial *)> const &block_fn;
+      threading::EpochScheduler scheduler;
+      std::vector<Slot> slots;
+    };
+
+    /**
+     * Visits every block once, spreading the blocks over a pool of threads, each of which adds the
+     * blocks it visits to a partial of its own.
+     * @return The threads' partials.
+     */
+    template<class Partial, class Block>
+    std::vector<Partial> forEachBlock(std::vector<Block *> const &blocks,
+                                      int num_threads,
+                                      std::function<void(Block const &, Partial *)> const &block_fn) {
+      num_threads = std::max(1, std::min<int>(num_threads, blocks.size()));
+      if (num_threads == 1) {
+        std::vector<Partial> partials(1);
+        for (Block const *block : blocks) {
+          block_fn(*block, &partials[0]);
+        }
+        return partials;
+      }
+
+      BlockPassState<Block, Partial> state(blocks, block_fn, num_threads);
+      ThreadPool tp([](int thread_id, void *state_ptr) {
+        BlockPassState<Block, Partial> *state = reinterpret_cast<BlockPassState<Block, Partial>*>(state_ptr);
+        threading::WorkItem item;
+        while (state->scheduler.next(thread_id, &item)) {
+          for (int i = item.begin; i < item.end; i++) {
+            state->block_fn(*state->blocks[i], &state->slots[thread_id].partial);
+          }
+        }
+        state->scheduler.finish(thread_id);
+      }, &state, num_threads);
+      tp.begin();
+      tp.cycle();
+      tp.stop();
+
+      std::vector<Partial> partials;
+      for (auto &slot : state.slots) {
+        partials.push_back(std::move(slot.partial));
+      }
+      return partials;
+    }
+
+    /**
+     * @return The probability that a positive row's margin exceeds a negative row's, ties counting
+     *         half, or NaN if either class has no rows. Sorts the margins.
+     */
+    double areaUnderCurve(std::vector<num_t> *positive_margins, std::vector<num_t> *negative_margins) {
+      if (positive_margins->empty() || negative_margins->empty()) {
+        return std::numeric_limits<double>::quiet_NaN();
+      }
+      std::sort(positive_margins->begin(), positive_margins->end());
+      std::sort(negative_margins->begin(), negative_margins->end());
+      std::vector<num_t> const &negatives = *negative_margins;
+      double pairs = 0;
+      std::size_t below = 0;
+      std::size_t tied = 0;
+      for (num_t margin : *positive_margins) {
+        while (below < negatives.size() && negatives[below] < margin) {
+          below++;
+        }
+        tied = std::max(tied, below);
+        while (tied < negatives.size() && negatives[tied] == margin) {
+          tied++;
+        }
+        pairs += below + 0.5 * (tied - below);
+      }
+      return pairs / (static_cast<double>(positive_margins->size()) * negatives.size());
+    }
+
+    template<class Block, class V>
+    SVMMetrics evaluateBlocks(const fvector &theta, std::vector<Block *> const &blocks, int num_threads, bool auc) {
+      std::vector<EvalPartial> partials = forEachBlock<EvalPartial, Block>(
+        blocks, num_threads, [&theta, auc](Block const &block, EvalPartial *partial) {
+          evaluateBlock<Block, V>(theta, block, auc, partial);
+        });
+
+      SVMMetrics metrics;
+      std::vector<num_t> positive_margins;
+      std::vector<num_t> negative_margins;
+      for (EvalPartial const &partial : partials) {
+        metrics.rows += partial.metrics.rows;
+        metrics.misclassified += partial.metrics.misclassified;
+        metrics.hinge_loss += partial.metrics.hinge_loss;
+        metrics.squared_loss += partial.metrics.squared_loss;
+        positive_margins.insert(positive_margins.end(), partial.positive_margins.begin(),
+                                partial.positive_margins.end());
+        negative_margins.insert(negative_margins.end(), partial.negative_margins.begin(),
+                                partial.negative_margins.end());
+      }
+      if (auc) {
+        metrics.auc = areaUnderCurve(&positive_margins, &negative_margins);
+      }
+      return metrics;
+    }
+
+  }  // namespace
+
+  bool ParseSVMLoss(std::string const & name, SVMLoss *loss) {
+    static std::map<std::string, SVMLoss> const kLosses = {
+      {"hinge", SVMLoss::kHinge},
+      {"always-update", SVMLoss::kAlwaysUpdate},
+    };
+    auto it = kLosses.find(name);
+    if (it == kLosses.end()) {
+      return false;
+    }
+    *loss = it->second;
+    return true;
   }
 
-  int SVMTask::numMisclassified(const fvector &theta, const SparseDataBlock<num_t> &block) {
-    svector<num_t> row(0, nullptr);
-    int misclassified = 0;
-    for (int i = 0; i < block.getNumRows(); i++) {
-      block.getRowVectorFast(i, &row);
-      const num_t dot_prod = ml::dot(row, theta.values_);
-      const num_t classification = *row.getClassification();
-      DCHECK(classification == 1 || classification == -1) << "Expected binary classification.";
+  std::string SVMLossName(SVMLoss loss) {
+    switch (loss) {
+      case SVMLoss::kHinge:
+        return "hinge";
+      case SVMLoss::kAlwaysUpdate:
+        return "always-update";
+    }
+    return "unknown";
+  }
+
+  bool ParseSVMRegularization(std::string const & name, SVMRegularization *regularization) {
+    static std::map<std::string, SVMRegularization> const kRegularizations = {
+      {"none", SVMRegularization::kNone},
+      {"degree-scaling", SVMRegularization::kDegreeScaling},
+      {"lazy-l2", SVMRegularization::kLazyL2},
+    };
+    auto it = kRegularizations.find(name);
+    if (it == kRegularizations.end()) {
+      return false;
+    }
+    *regularization = it->second;
+    return true;
+  }
+
+  std::string SVMRegularizationName(SVMRegularization regularization) {
+    switch (regularization) {
+      case SVMRegularization::kNone:
+        return "none";
+      case SVMRegularization::kDegreeScaling:
+        return "degree-scaling";
+      case SVMRegularization::kLazyL2:
+        return "lazy-l2";
+    }
+    return "unknown";
+  }
+
+  bool ParseUpdateConsistency(std::string const & name, UpdateConsistency *consistency) {
+    static std::map<std::string, UpdateConsistency> const kConsistencies = {
+      {"racy", UpdateConsistency::kRacy},
+      {"atomic", UpdateConsistency::kAtomic},
+      {"locked", UpdateConsistency::kLocked},
+    };
+    auto it = kConsistencies.find(name);
+    if (it == kConsistencies.end()) {
+      return false;
+    }
+    *consistency = it->second;
+    return true;
+  }
+
+  std::string UpdateConsistencyName(UpdateConsistency consistency) {
+    switch (consistency) {
+      case UpdateConsistency::kRacy:
+        return "racy";
+      case UpdateConsistency::kAtomic:
+        return "atomic";
+      case UpdateConsistency::kLocked:
+        return "locked";
+    }
+    return "unknown";
+  }
+
+  bool ParseSVMOptimizer(std::string const & name, SVMOptimizer *optimizer) {
+    static std::map<std::string, SVMOptimizer> const kOptimizers = {
+      {"sgd", SVMOptimizer::kSgd},
+      {"adagrad", SVMOptimizer::kAdaGrad},
+    };
+    auto it = kOptimizers.find(name);
+    if (it == kOptimizers.end()) {
+      return false;
+    }
+    *optimizer = it->second;
+    return true;
+  }
+
+  std::string SVMOptimizerName(SVMOptimizer optimizer) {
+    switch (optimizer) {
+      case SVMOptimizer::kSgd:
+        return "sgd";
+      case SVMOptimizer::kAdaGrad:
+        return "adagrad";
+    }
+    return "unknown";
+  }
+
+  void SVMTask::execute(int threadId, void *svm_state) {
+    (void) svm_state; // silence compiler warning.
+
+    (this->*getEpochFn(shared_params_->policy))(threadId);
+  }
+
+  template<class Update>
+  void SVMTask::trainEpoch(int threadId) {
+    typename Update::Model *model = Update::getModel(shared_theta_, shared_params_);
+    if (cyclades_ != nullptr) {
+      cycladesEpoch<Update>(cyclades_, worker_, model, shared_params_);
+      // The epoch ends at a barrier, after which no worker updates the model.
+      if (worker_ == 0) {
+        shared_params_->step_size = shared_params_->step_size * shared_params_->step_decay;
+      }
+      return;
+    }
+
+    GradientBuffer *gradient = nullptr;
+    if (shared_params_->minibatch_rows > 1) {
+      if (!gradient_ || gradient_->getNumColumns() != shared_theta_->dimension_) {
+        gradient_.reset(new GradientBuffer(shared_theta_->dimension_));
+      }
+      gradient = gradient_.get();
+    }
+
+    if (scheduler_ == nullptr) {
+      data_view_->reset();
+      trainView<Update>(data_view_, model, shared_params_, gradient, rows_done_);
+      if (threadId == 0) {
+        shared_params_->step_size = shared_params_->step_size * shared_params_->step_decay;
+      }
+      return;
+    }
+
+    threading::WorkItem item;
+    while (scheduler_->next(worker_, &item)) {
+      data_view_->setBlockRange(item.begin, item.end);
+      trainView<Update>(data_view_, model, shared_params_, gradient, rows_done_);
+    }
+    // Thread 0 may finish before others start, so the last thread out decays the step size.
+    if (scheduler_->finish(worker_)) {
+      shared_params_->step_size = shared_params_->step_size * shared_params_->step_decay;
+    }
+  }
+
+  template<class Loss, class Regularizer, class Consistency>
+  SVMTask::EpochFn SVMTask::selectOptimizer(SVMUpdatePolicy const & policy) {
+    switch (policy.optimizer) {
+      case SVMOptimizer::kSgd:
+        return &SVMTask::trainEpoch<SgdUpdate<Loss, Regularizer, Consistency, PlainSgd>>;
+      case SVMOptimizer::kAdaGrad:
+        return &SVMTask::trainEpoch<SgdUpdate<Loss, Regularizer, Consistency, AdaGrad>>;
+    }
+    LOG(FATAL) << "unknown SVM optimizer";
+    return nullptr;
+  }
 
-      misclassified += (classification == 1 && dot_prod < 0) || (classification == -1 && dot_prod >= 0);
+  template<class Loss, class Regularizer>
+  SVMTask::EpochFn SVMTask::selectConsistency(SVMUpdatePolicy const & policy) {
+    switch (policy.consistency) {
+      case UpdateConsistency::kRacy:
+        return selectOptimizer<Loss, Regularizer, RacyConsistency>(policy);
+      case UpdateConsistency::kAtomic:
+        return selectOptimizer<Loss, Regularizer, AtomicConsistency>(policy);
+      case UpdateConsistency::kLocked:
+        return selectOptimizer<Loss, Regularizer, LockedConsistency>(policy);
     }
-    return misclassified;
+    LOG(FATAL) << "unknown update consistency";
+    return nullptr;
   }
 
-  double SVMTask::fractionMisclassified(const fvector &theta, std::vector<SparseDataBlock<num_t> *> const &blocks) {
-    long total_misclassified = 0;
-    long total_examples = 0;
-    for (int i = 0; i < blocks.size(); i++) {
-      SparseDataBlock<num_t> const *block = blocks[i];
-      total_misclassified += SVMTask::numMisclassified(theta, *block);
-      total_examples += block->getNumRows();
+  template<class Loss>
+  SVMTask::EpochFn SVMTask::selectRegularization(SVMUpdatePolicy const & policy) {
+    switch (policy.regularization) {
+      case SVMRegularization::kNone:
+        return selectConsistency<Loss, NoRegularization>(policy);
+      case SVMRegularization::kDegreeScaling:
+        return selectConsistency<Loss, DegreeScaling>(policy);
+      case SVMRegularization::kLazyL2:
+        return selectConsistency<Loss, LazyL2Regularization>(policy);
     }
-    return (double) total_misclassified / (double) total_examples;
+    LOG(FATAL) << "unknown SVM regularization";
+    return nullptr;
+  }
+
+  template<class Loss>
+  SVMTask::EpochFn SVMTask::selectPrecision(SVMUpdatePolicy const & policy) {
+    if (policy.precision == ModelPrecision::kFloat32) {
+      return selectRegularization<Loss>(policy);
+    }
+    CHECK(policy.regularization == SVMRegularization::kNone
+          && policy.consistency == UpdateConsistency::kRacy
+          && policy.optimizer == SVMOptimizer::kSgd)
+      << "a fixed-point model is trained with racy plain SGD and no regularization";
+    switch (policy.precision) {
+      case ModelPrecision::kInt16:
+        return &SVMTask::trainEpoch<SgdUpdate<Loss, NoRegularization, RacyConsistency, FixedPointSgd<std::int16_t>>>;
+      case ModelPrecision::kInt8:
+        return &SVMTask::trainEpoch<SgdUpdate<Loss, NoRegularization, RacyConsistency, FixedPointSgd<std::int8_t>>>;
+      default:
+        break;
+    }
+    LOG(FATAL) << "unknown model precision";
+    return nullptr;
+  }
+
+  SVMTask::EpochFn SVMTask::getEpochFn(SVMUpdatePolicy const & policy) {
+    switch (policy.loss) {
+      case SVMLoss::kHinge:
+        return selectPrecision<HingeLoss>(policy);
+      case SVMLoss::kAlwaysUpdate:
+        return selectPrecision<AlwaysUpdateLoss>(policy);
+    }
+    LOG(FATAL) << "unknown SVM loss";
+    return nullptr;
+  }
+
+  int SVMTask::numMisclassified(const fvector &theta, const SparseDataBlock<num_t> &block) {
+    EvalPartial partial;
+    evaluateBlock<SparseDataBlock<num_t>, svector<num_t>>(theta, block, false, &partial);
+    return partial.metrics.misclassified;
+  }
+
+  int SVMTask::numMisclassified(const fvector &theta, const DenseDataBlock<num_t> &block) {
+    EvalPartial partial;
+    evaluateBlock<DenseDataBlock<num_t>, dvector<num_t>>(theta, block, false, &partial);
+    return partial.metrics.misclassified;
+  }
+
+  SVMMetrics SVMTask::evaluate(const fvector &theta,
+                               std::vector<SparseDataBlock<num_t> *> const &blocks,
+                               int num_threads,
+                               bool auc) {
+    return evaluateBlocks<SparseDataBlock<num_t>, svector<num_t>>(theta, blocks, num_threads, auc);
+  }
+
+  SVMMetrics SVMTask::evaluate(const fvector &theta,
+                               std::vector<DenseDataBlock<num_t> *> const &blocks,
+                               int num_threads,
+                               bool auc) {
+    return evaluateBlocks<DenseDataBlock<num_t>, dvector<num_t>>(theta, blocks, num_threads, auc);
+  }
+
+  double SVMTask::fractionMisclassified(const fvector &theta,
+                                        std::vector<SparseDataBlock<num_t> *> const &blocks,
+                                        int num_threads) {
+    return evaluate(theta, blocks, num_threads).fractionMisclassified();
+  }
+
+  double SVMTask::fractionMisclassified(const fvector &theta,
+                                        std::vector<DenseDataBlock<num_t> *> const &blocks,
+                                        int num_threads) {
+    return evaluate(theta, blocks, num_threads).fractionMisclassified();
   }
 
   double SVMTask::rmsError(const fvector &theta, std::vector<SparseDataBlock<num_t> *> const &blocks) {
     return std::sqrt(SVMTask::fractionMisclassified(theta, blocks));
   }
 
-  double SVMTask::rmsErrorLoss(const fvector &theta, std::vector<SparseDataBlock<num_t> *> const &blocks) {
-    double total_examples = 0;
-    double loss = 0;
-    svector<num_t> row(0, nullptr);
-    for (int i = 0; i < blocks.size(); i++) {
-      SparseDataBlock<num_t> const &block = *blocks[i];
+  double SVMTask::rmsErrorLoss(const fvector &theta,
+                               std::vector<SparseDataBlock<num_t> *> const &blocks,
+                               int num_threads) {
+    return evaluate(theta, blocks, num_threads).rmsErrorLoss();
+  }
 
-      for (int i = 0; i < block.getNumRows(); i++) {
-        block.getRowVector(i, &row);
-        const num_t dot_prod = ml::dot(row, theta.values_);
-        const num_t classification = *row.getClassification();
-        DCHECK(classification == 1 || classification == -1);
-        loss += std::max(1 - dot_prod * classification, static_cast<num_t >(0.0));
+  double SVMTask::rmsErrorLoss(const fvector &theta,
+                               std::vector<DenseDataBlock<num_t> *> const &blocks,
+                               int num_threads) {
+    return evaluate(theta, blocks, num_threads).rmsErrorLoss();
+  }
+
+  double SVMMetrics::fractionMisclassified() const {
+    return static_cast<double>(misclassified) / rows;
+  }
+
+  double SVMMetrics::rmsErrorLoss() const {
+    return std::sqrt(hinge_loss) / std::sqrt(static_cast<double>(rows));
+  }
+
+  double SVMMetrics::meanSquaredLoss() const {
+    return squared_loss / rows;
+  }
+
+  LazyL2::LazyL2(int num_columns, std::int64_t num_rows, float mu, float step_size)
+    : stamps_(num_columns, 1),
+      clock_(0),
+      num_rows_(num_rows),
+      mu_(mu),
+      log_decay_(0) {
+    CHECK_LT(0, num_rows);
+    setDecay(step_size);
+  }
+
+  double LazyL2::getScale(std::int64_t clock) const {
+    return std::exp(clock * log_decay_);
+  }
+
+  double LazyL2::getRowDecay() const {
+    return std::exp(log_decay_);
+  }
+
+  void LazyL2::renormalize(fvector *theta, float step_size) {
+    CHECK_EQ(theta->dimension_, stamps_.size());
+    double const scale = getScale(clock_.load(std::memory_order_relaxed));
+    for (int i = 0; i < theta->dimension_; i++) {
+      theta->values_[i] *= static_cast<num_t>(scale * stamps_[i]);
+      stamps_[i] = 1;
+    }
+    clock_.store(0, std::memory_order_relaxed);
+    setDecay(step_size);
+  }
+
+  void LazyL2::setDecay(float step_size) {
+    double const shrinkage = static_cast<double>(step_size) * mu_ / num_rows_;
+    CHECK_GT(1, shrinkage) << "a row would shrink the model to zero";
+    log_decay_ = std::log1p(-shrinkage);
+    // The scale falls by about exp(-step_size * mu) an epoch, and its inverse must fit the stamps
+    // until the epoch's renormalization.
+    CHECK_GT(80, -log_decay_ * num_rows_) << "an epoch of L2 shrinkage overflows the stamps";
+  }
+
+  AdaGradModel::AdaGradModel(fvector const & theta)
+    : entries_(theta.dimension_) {
+    setWeights(theta);
+  }
+
+  void AdaGradModel::copyWeights(fvector *theta) const {
+    CHECK_EQ(theta->dimension_, entries_.size());
+    for (int i = 0; i < theta->dimension_; i++) {
+      theta->values_[i] = entries_[i].weight;
+    }
+  }
+
+  void AdaGradModel::setWeights(fvector const & theta) {
+    CHECK_EQ(theta.dimension_, entries_.size());
+    for (int i = 0; i < theta.dimension_; i++) {
+      entries_[i].weight = theta.values_[i];
+    }
+  }
+
+  bool ParseSVMSweep(std::string const & list, std::vector<SVMSweepSetting> *settings) {
+    std::vector<SVMSweepSetting> parsed;
+    std::stringstream stream(list);
+    std::string pair;
+    while (std::getline(stream, pair, ',')) {
+      char const *begin = pair.c_str();
+      char *end;
+      float const step_size = std::strtof(begin, &end);
+      if (end == begin || *end != ':') {
+        return false;
+      }
+      begin = end + 1;
+      float const mu = std::strtof(begin, &end);
+      if (end == begin || *end != '\0' || step_size <= 0 || mu < 0) {
+        return false;
       }
-      total_examples += block.getNumRows();
+      parsed.push_back(SVMSweepSetting(step_size, mu));
+    }
+    if (parsed.empty()) {
+      return false;
     }
-    return std::sqrt(loss) / std::sqrt(total_examples);
+    *settings = parsed;
+    return true;
   }
 
-} // namespace obamadb
+  constexpr int MultiSVMModel::kLanes;
+
+  MultiSVMModel::MultiSVMModel(fvector const & initial, int num_models)
+    : dimension_(initial.dimension_),
+      num_models_(num_models),
+      stride_((num_models + kLanes - 1) / kLanes * kLanes),
+      values_(static_cast<std::size_t>(initial.dimension_) * stride_, 0) {
+    CHECK_LT(0, num_models);
+    for (int i = 0; i < dimension_; i++) {
+      std::fill(values_.begin() + i * stride_, values_.begin() + i * stride_ + num_models_, initial.values_[i]);
+    }
+  }
+
+  void MultiSVMModel::copyModel(int model, fvector *theta) const {
+    CHECK_EQ(theta->dimension_, dimension_);
+    CHECK_LT(model, num_models_);
+    for (int i = 0; i < dimension_; i++) {
+      theta->values_[i] = values_[i * stride_ + model];
+    }
+  }
 
+  MultiSVMParams::MultiSVMParams(std::vector<SVMSweepSetting> const & settings,
+                                 int stride,
+                                 float step_decay,
+                                 std::vector<int> const & degrees)
+    : step_sizes(stride, 0),
+      mus(stride, 0),
+      step_decay(step_decay),
+      prefetch_distance(kDefaultPrefetchDistance),
+      loss(SVMLoss::kAlwaysUpdate),
+      regularization(SVMRegularization::kNone),
+      degrees(degrees) {
+    CHECK_LE(settings.size(), stride);
+    for (int k = 0; k < settings.size(); k++) {
+      step_sizes[k] = settings[k].step_size;
+      mus[k] = settings[k].mu;
+    }
+  }
+
+  void MultiSVMTask::execute(int thread_id, void *ml_state) {
+    (void) ml_state;
+    data_view_->reset();
+    switch (params_->loss) {
+      case SVMLoss::kHinge:
+        multiTrainView<HingeLoss>(data_view_, model_, params_);
+        break;
+      case SVMLoss::kAlwaysUpdate:
+        multiTrainView<AlwaysUpdateLoss>(data_view_, model_, params_);
+        break;
+    }
+    if (thread_id == 0) {
+      for (num_t & step_size : params_->step_sizes) {
+        step_size *= params_->step_decay;
+      }
+    }
+  }
+
+  void FinishSVMEpoch(SVMParams *params, fvector *theta) {
+    if (params->adagrad) {
+      params->adagrad->copyWeights(theta);
+    }
+    if (params->fixed_point8) {
+      params->fixed_point8->copyWeights(theta);
+    }
+    if (params->fixed_point16) {
+      params->fixed_point16->copyWeights(theta);
+    }
+    if (params->lazy_l2) {
+      params->lazy_l2->renormalize(theta, params->step_size);
+      if (params->adagrad) {
+        params->adagrad->setWeights(*theta);
+      }
+    }
+  }
+
+  SVMParams *DefaultSVMParams(MatrixStats const & stats) {
+    SVMParams *params = new SVMParams(1, 0.1, 0.99);
+    params->degrees = stats.degrees;
+    return params;
+  }
+
+} // namespace obamadb
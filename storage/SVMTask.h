@@ -1,15 +1,203 @@
 #ifndef OBAMADB_SVMTASK_H
 #define OBAMADB_SVMTASK_H
 
+#include "storage/Cyclades.h"
 #include "storage/DataBlock.h"
 #include "storage/DataView.h"
+#include "storage/DenseDataBlock.h"
 #include "storage/exvector.h"
+#include "storage/FixedPoint.h"
 #include "storage/MLTask.h"
+#include "storage/MatrixStats.h"
+#include "storage/Prefetch.h"
 #include "storage/SparseDataBlock.h"
+#include "storage/ThreadPool.h"
 #include "storage/Utils.h"
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 namespace obamadb {
 
+  /**
+   * The loss whose gradient each row steps along.
+   */
+  enum class SVMLoss {
+    kHinge,         // rows beyond the margin are skipped.
+    kAlwaysUpdate,  // rows beyond the margin take a small step back, so every row writes the model.
+  };
+
+  enum class SVMRegularization {
+    kNone,
+    kDegreeScaling,  // the features a row updates shrink in inverse proportion to their degrees.
+    kLazyL2,         // every feature shrinks each row, applied when the feature is next read.
+  };
+
+  /**
+   * How concurrent updates of the shared model are made.
+   */
+  enum class UpdateConsistency {
+    kRacy,    // plain loads and stores; concurrent updates of a feature may be lost (Hogwild).
+    kAtomic,  // each feature is updated with a compare-and-swap.
+    kLocked,  // each row's step holds a lock on the whole model.
+  };
+
+  /**
+   * How each feature's step is sized.
+   */
+  enum class SVMOptimizer {
+    kSgd,      // every feature steps by the global step size.
+    kAdaGrad,  // each feature's step shrinks with the root of its summed squared gradients.
+  };
+
+  /**
+   * @return False if the name does not name a loss.
+   */
+  bool ParseSVMLoss(std::string const & name, SVMLoss *loss);
+
+  std::string SVMLossName(SVMLoss loss);
+
+  bool ParseSVMRegularization(std::string const & name, SVMRegularization *regularization);
+
+  std::string SVMRegularizationName(SVMRegularization regularization);
+
+  bool ParseUpdateConsistency(std::string const & name, UpdateConsistency *consistency);
+
+  std::string UpdateConsistencyName(UpdateConsistency consistency);
+
+  bool ParseSVMOptimizer(std::string const & name, SVMOptimizer *optimizer);
+
+  std::string SVMOptimizerName(SVMOptimizer optimizer);
+
+  /**
+   * Which SGD update the tasks run. Every combination is compiled, and a task picks one per epoch.
+   */
+  struct SVMUpdatePolicy {
+    SVMUpdatePolicy()
+      : loss(SVMLoss::kAlwaysUpdate),
+        regularization(SVMRegularization::kNone),
+        consistency(UpdateConsistency::kRacy),
+        optimizer(SVMOptimizer::kSgd),
+        precision(ModelPrecision::kFloat32) {}
+
+    SVMLoss loss;
+    SVMRegularization regularization;
+    UpdateConsistency consistency;
+    SVMOptimizer optimizer;
+    // A fixed-point model is only trained with racy plain SGD and no regularization.
+    ModelPrecision precision;
+  };
+
+  /**
+   * L2 regularization of every feature on every row, applied just in time. Each row shrinks the
+   * whole model by the same factor, so the shrinkage a feature owes is the ratio of the model's
+   * global scale now to its scale when the feature was last read. The global scale follows from a
+   * clock counting the rows trained, and each feature keeps the inverse of the scale it was last
+   * brought up to, so that bringing it up to date takes a multiplication rather than a division.
+   * A row's cost is then proportional to its nonzeros, as without regularization.
+   */
+  class LazyL2 {
+  public:
+    /**
+     * @param num_columns The model's dimension.
+     * @param num_rows The rows of an epoch. Each row shrinks the model by 1 - step_size * mu / num_rows,
+     *        so an epoch shrinks it by about exp(-step_size * mu).
+     */
+    LazyL2(int num_columns, std::int64_t num_rows, float mu, float step_size);
+
+    /**
+     * Advances the clock.
+     * @return The clock of the first of the rows.
+     */
+    inline std::int64_t reserve(int rows) {
+      return clock_.fetch_add(rows, std::memory_order_relaxed);
+    }
+
+    /**
+     * @return The model's global scale at a clock of this epoch.
+     */
+    double getScale(std::int64_t clock) const;
+
+    /**
+     * @return The factor each row shrinks the model by.
+     */
+    double getRowDecay() const;
+
+    /**
+     * Each feature's inverse scale when it was last brought up to date.
+     */
+    num_t* getStamps() {
+      return stamps_.data();
+    }
+
+    /**
+     * Applies every feature's outstanding shrinkage and restarts the clock, so the global scale
+     * cannot underflow, nor the stamps overflow, over many epochs. No task may be training.
+     * @param step_size The step size of the coming epoch.
+     */
+    void renormalize(fvector *theta, float step_size);
+
+  private:
+    void setDecay(float step_size);
+
+    std::vector<num_t> stamps_;
+    std::atomic<std::int64_t> clock_;
+    std::int64_t const num_rows_;
+    float const mu_;
+    // The log of the factor each row shrinks the model by.
+    double log_decay_;
+
+    DISABLE_COPY_AND_ASSIGN(LazyL2);
+  };
+
+  /**
+   * A feature's weight and its AdaGrad accumulator. They are stored side by side, so that the cache
+   * line an update misses on holds both, and AdaGrad misses the cache as often as plain SGD.
+   */
+  struct AdaGradEntry {
+    num_t weight;
+    // The sum of the feature's squared gradients.
+    num_t accumulator;
+  };
+
+  /**
+   * The model trained by SVMOptimizer::kAdaGrad, with the weights interleaved with the accumulators.
+   */
+  class AdaGradModel {
+  public:
+    /**
+     * @param theta The initial weights. The accumulators start at zero.
+     */
+    explicit AdaGradModel(fvector const & theta);
+
+    AdaGradEntry* getEntries() {
+      return entries_.data();
+    }
+
+    int getDimension() const {
+      return entries_.size();
+    }
+
+    /**
+     * Copies the weights to a plain model, e.g. for evaluation. No task may be training.
+     */
+    void copyWeights(fvector *theta) const;
+
+    /**
+     * Sets the weights from a plain model, keeping the accumulators. No task may be training.
+     */
+    void setWeights(fvector const & theta);
+
+  private:
+    std::vector<AdaGradEntry> entries_;
+
+    DISABLE_COPY_AND_ASSIGN(AdaGradModel);
+  };
+
   /**
    * Single params shared between many SVM tasks/workers.
    */
@@ -20,12 +208,125 @@ namespace obamadb {
       : mu(mu),
         step_size(step_size),
         step_decay(step_decay),
-        degrees() {}
+        prefetch_distance(kDefaultPrefetchDistance),
+        minibatch_rows(1),
+        policy(),
+        degrees(),
+        lazy_l2(),
+        adagrad(),
+        fixed_point8(),
+        fixed_point16(),
+        model_lock() {}
 
     float mu;
     float step_size;
     float step_decay;
+    // How many rows ahead the model entries of a sparse row are prefetched. 0 disables prefetching.
+    int prefetch_distance;
+    // How many rows each worker sums updates over before adding them to the shared model. 1 updates
+    // the model after every row.
+    int minibatch_rows;
+    SVMUpdatePolicy policy;
     std::vector<int> degrees;
+    // The state of SVMRegularization::kLazyL2. Null under other regularizations.
+    std::unique_ptr<LazyL2> lazy_l2;
+    // The model SVMOptimizer::kAdaGrad trains in place of the tasks' theta. Null under plain SGD.
+    std::unique_ptr<AdaGradModel> adagrad;
+    // The model trained in place of the tasks' theta under ModelPrecision::kInt8 or kInt16.
+    std::unique_ptr<FixedPointModel<std::int8_t>> fixed_point8;
+    std::unique_ptr<FixedPointModel<std::int16_t>> fixed_point16;
+    // Held by each step under UpdateConsistency::kLocked.
+    mutable std::mutex model_lock;
+  };
+
+  /**
+   * A worker's sum of row updates over a mini-batch. The sums are kept in a dense buffer so that a
+   * feature updated by several rows of the mini-batch is added up locally, and written to the shared
+   * model once.
+   */
+  class GradientBuffer {
+  public:
+    explicit GradientBuffer(int num_columns)
+      : sums_(num_columns, 0),
+        listed_(num_columns, false),
+        columns_() {}
+
+    inline void add(int column, num_t value) {
+      // Listed once however its sum moves, as each listed feature is also regularized once.
+      if (!listed_[column]) {
+        listed_[column] = true;
+        columns_.push_back(column);
+      }
+      sums_[column] += value;
+    }
+
+    /**
+     * @return The features added to since the last clear().
+     */
+    std::vector<int> const & columns() const {
+      return columns_;
+    }
+
+    /**
+     * @return The feature's sum, which is reset to zero.
+     */
+    num_t take(int column) {
+      num_t const sum = sums_[column];
+      sums_[column] = 0;
+      return sum;
+    }
+
+    /**
+     * Forgets the listed features. Their sums must all have been taken.
+     */
+    void clear() {
+      for (int column : columns_) {
+        listed_[column] = false;
+      }
+      columns_.clear();
+    }
+
+    int getNumColumns() const {
+      return sums_.size();
+    }
+
+  private:
+    std::vector<num_t> sums_;
+    // Whether each feature is in columns_.
+    std::vector<bool> listed_;
+    std::vector<int> columns_;
+
+    DISABLE_COPY_AND_ASSIGN(GradientBuffer);
+  };
+
+  /**
+   * The quality of a model on a set of rows, see SVMTask::evaluate.
+   */
+  struct SVMMetrics {
+    SVMMetrics()
+      : rows(0),
+        misclassified(0),
+        hinge_loss(0),
+        squared_loss(0),
+        auc(-1) {}
+
+    double fractionMisclassified() const;
+
+    /**
+     * @return The root of the mean hinge loss.
+     */
+    double rmsErrorLoss() const;
+
+    double meanSquaredLoss() const;
+
+    std::int64_t rows;
+    std::int64_t misclassified;
+    // Sums over the rows of max(0, 1 - y w.x) and of (1 - y w.x)^2.
+    double hinge_loss;
+    double squared_loss;
+    // The area under the ROC curve of the rows' margins w.x. -1 if not computed, NaN if the rows
+    // are all of one class.
+    double auc;
   };
 
   class SVMTask : MLTask {
@@ -35,7 +336,61 @@ namespace obamadb {
             SVMParams *sharedParams)
       : MLTask(dataView),
         shared_theta_(sharedTheta),
-        shared_params_(sharedParams) {}
+        shared_params_(sharedParams),
+        scheduler_(nullptr),
+        cyclades_(nullptr),
+        worker_(0),
+        gradient_(),
+        rows_done_(nullptr) {}
+
+    /**
+     * A task whose epochs are scheduled dynamically. The view should hold every training block, and
+     * each epoch the task trains on whichever block ranges it pulls from the scheduler.
+     * @param scheduler Scheduler over the blocks of the view, shared by all tasks of the pool.
+     * @param worker The task's id amongst the scheduler's workers, which need not be its thread's
+     *        id in the pool.
+     */
+    SVMTask(DataView *dataView,
+            fvector *sharedTheta,
+            SVMParams *sharedParams,
+            threading::EpochScheduler *scheduler,
+            int worker)
+      : MLTask(dataView),
+        shared_theta_(sharedTheta),
+        shared_params_(sharedParams),
+        scheduler_(scheduler),
+        cyclades_(nullptr),
+        worker_(worker),
+        gradient_(),
+        rows_done_(nullptr) {}
+
+    /**
+     * A task which trains on the components of conflict-free batches. Its view is not read.
+     * @param cyclades Scheduler of the batches, shared by all tasks of the pool.
+     * @param worker The task's id amongst the scheduler's workers.
+     */
+    SVMTask(DataView *dataView,
+            fvector *sharedTheta,
+            SVMParams *sharedParams,
+            CycladesScheduler *cyclades,
+            int worker)
+      : MLTask(dataView),
+        shared_theta_(sharedTheta),
+        shared_params_(sharedParams),
+        scheduler_(nullptr),
+        cyclades_(cyclades),
+        worker_(worker),
+        gradient_(),
+        rows_done_(nullptr) {}
+
+    /**
+     * Makes the task add the rows it has trained to a counter after each batch of rows, e.g. so that
+     * model replicas can be merged every so many rows.
+     * @param rows_done Not owned. Only this task may write it.
+     */
+    void setRowCounter(std::atomic<std::int64_t> *rows_done) {
+      rows_done_ = rows_done;
+    }
 
     MLAlgorithm getType() override {
       return MLAlgorithm::kSVM;
@@ -54,13 +409,38 @@ namespace obamadb {
      */
     static int numMisclassified(const fvector &theta, const SparseDataBlock<num_t> &block);
 
+    static int numMisclassified(const fvector &theta, const DenseDataBlock<num_t> &block);
+
+    /**
+     * Computes every metric of SVMMetrics in one pass over the blocks, from each row's margin.
+     * @param num_threads Number of threads the blocks are spread over, each of which sums its own
+     *        blocks' metrics.
+     * @param auc If true, also computes the AUC, for which every row's margin is kept and sorted.
+     */
+    static SVMMetrics evaluate(const fvector &theta,
+                               std::vector<SparseDataBlock<num_t> *> const &blocks,
+                               int num_threads = 1,
+                               bool auc = false);
+
+    static SVMMetrics evaluate(const fvector &theta,
+                               std::vector<DenseDataBlock<num_t> *> const &blocks,
+                               int num_threads = 1,
+                               bool auc = false);
+
     /**
      * Gets the fraction of misclassified examples.
      * @param theta The trained weights.
      * @param block A sample of the data.
+     * @param num_threads Number of threads the blocks are spread over.
      * @return Fraction of misclassified examples.
      */
-    static double fractionMisclassified(const fvector &theta, std::vector<SparseDataBlock<num_t> *> const &block);
+    static double fractionMisclassified(const fvector &theta,
+                                        std::vector<SparseDataBlock<num_t> *> const &block,
+                                        int num_threads = 1);
+
+    static double fractionMisclassified(const fvector &theta,
+                                        std::vector<DenseDataBlock<num_t> *> const &block,
+                                        int num_threads = 1);
 
     /**
      * Root mean squared error.
@@ -72,16 +452,186 @@ namespace obamadb {
     /**
     * @param theta
     * @param blocks
+    * @param num_threads Number of threads the blocks are spread over.
     * @return
     */
-    static double rmsErrorLoss(const fvector &theta, std::vector<SparseDataBlock<num_t> *> const &blocks);
+    static double rmsErrorLoss(const fvector &theta,
+                               std::vector<SparseDataBlock<num_t> *> const &blocks,
+                               int num_threads = 1);
+
+    static double rmsErrorLoss(const fvector &theta,
+                               std::vector<DenseDataBlock<num_t> *> const &blocks,
+                               int num_threads = 1);
 
     fvector *shared_theta_;
     SVMParams *shared_params_;
+    // Not owned. Null if the task trains on its whole view every epoch.
+    threading::EpochScheduler *scheduler_;
+    // Not owned. Null unless the task's epochs are scheduled in conflict-free batches.
+    CycladesScheduler *cyclades_;
+    int worker_;
+    // The task's mini-batch gradient, allocated when mini-batches are first used.
+    std::unique_ptr<GradientBuffer> gradient_;
+    // Not owned. Null if the task's progress is not counted.
+    std::atomic<std::int64_t> *rows_done_;
+
+  private:
+    typedef void (SVMTask::*EpochFn)(int);
+
+    /**
+     * Trains one epoch with every choice of the update policy fixed at compile time.
+     * @param Update An SgdUpdate, see SVMTask.cpp.
+     */
+    template<class Update>
+    void trainEpoch(int thread_id);
+
+    /**
+     * @return trainEpoch instantiated for the policy. The select functions each fix one more of the
+     *         policy's choices as a template argument.
+     */
+    static EpochFn getEpochFn(SVMUpdatePolicy const & policy);
+
+    template<class Loss>
+    static EpochFn selectPrecision(SVMUpdatePolicy const & policy);
+
+    template<class Loss>
+    static EpochFn selectRegularization(SVMUpdatePolicy const & policy);
+
+    template<class Loss, class Regularizer>
+    static EpochFn selectConsistency(SVMUpdatePolicy const & policy);
+
+    template<class Loss, class Regularizer, class Consistency>
+    static EpochFn selectOptimizer(SVMUpdatePolicy const & policy);
 
     DISABLE_COPY_AND_ASSIGN(SVMTask);
   };
 
+  /**
+   * The hyperparameters of one model of a multi-model run.
+   */
+  struct SVMSweepSetting {
+    SVMSweepSetting(float step_size, float mu)
+      : step_size(step_size),
+        mu(mu) {}
+
+    float step_size;
+    float mu;
+  };
+
+  /**
+   * @param list Comma separated step_size:mu pairs, e.g. "0.1:1,0.05:1".
+   * @return False if the list is empty or malformed.
+   */
+  bool ParseSVMSweep(std::string const & list, std::vector<SVMSweepSetting> *settings);
+
+  /**
+   * Several SVM models of the same dimension, stored feature-major: a feature's weights in all the
+   * models are adjacent. A row then updates every model with one short contiguous run of memory
+   * per feature, so training K models costs one scan of the data and one gather per nonzero.
+   */
+  class MultiSVMModel {
+  public:
+    // The models are padded to a multiple of this many, which fill a 256-bit vector of floats.
+    static constexpr int kLanes = 8;
+
+    /**
+     * @param initial The initial value of every model.
+     */
+    MultiSVMModel(fvector const & initial, int num_models);
+
+    /**
+     * @return The weights, getStride() per feature.
+     */
+    num_t* getValues() {
+      return values_.data();
+    }
+
+    int getDimension() const {
+      return dimension_;
+    }
+
+    int getNumModels() const {
+      return num_models_;
+    }
+
+    /**
+     * @return The number of weights per feature, the number of models rounded up to kLanes.
+     */
+    int getStride() const {
+      return stride_;
+    }
+
+    /**
+     * Copies one model out, e.g. for evaluation. No task may be training.
+     */
+    void copyModel(int model, fvector *theta) const;
+
+  private:
+    int const dimension_;
+    int const num_models_;
+    int const stride_;
+    std::vector<num_t> values_;
+
+    DISABLE_COPY_AND_ASSIGN(MultiSVMModel);
+  };
+
+  /**
+   * Params shared between the tasks training a MultiSVMModel. Each model has its own step size and
+   * mu. The padding models have a step size of 0, so are never changed.
+   */
+  struct MultiSVMParams {
+    MultiSVMParams(std::vector<SVMSweepSetting> const & settings,
+                   int stride,
+                   float step_decay,
+                   std::vector<int> const & degrees);
+
+    // Per model, including the padding.
+    std::vector<num_t> step_sizes;
+    std::vector<num_t> mus;
+    float step_decay;
+    int prefetch_distance;
+    // Shared by all the models. Only kNone and kDegreeScaling are supported.
+    SVMLoss loss;
+    SVMRegularization regularization;
+    std::vector<int> degrees;
+  };
+
+  /**
+   * Trains every model of a MultiSVMModel on its view, Hogwild-style, reading each row once.
+   */
+  class MultiSVMTask : MLTask {
+  public:
+    MultiSVMTask(DataView *dataView,
+                 MultiSVMModel *model,
+                 MultiSVMParams *params)
+      : MLTask(dataView),
+        model_(model),
+        params_(params) {}
+
+    MLAlgorithm getType() override {
+      return MLAlgorithm::kSVM;
+    }
+
+    /**
+     * One epoch over the view. Thread 0 then decays the step sizes.
+     */
+    void execute(int thread_id, void *ml_state) override;
+
+  private:
+    MultiSVMModel *model_;
+    MultiSVMParams *params_;
+
+    DISABLE_COPY_AND_ASSIGN(MultiSVMTask);
+  };
+
+  /**
+   * Brings a model up to date with the training state kept outside it, after an epoch and before
+   * the model is read: the outstanding lazy L2 shrinkage, and the weights of an AdaGrad or a
+   * fixed-point model.
+   * No task may be training.
+   */
+  void FinishSVMEpoch(SVMParams *params, fvector *theta);
+
 /**
  * Constructs the SVM to the parameters used in the HW! paper.
  * @return Caller-owned SVM params.
@@ -112,6 +662,14 @@ namespace obamadb {
 
     return params;
   };
+
+/**
+ * As above, but the column degrees are taken from a matrix's statistics catalog rather than
+ * counted by another scan of the data. Works for both sparse and dense training sets.
+ * @return Caller-owned SVM params.
+ */
+  SVMParams *DefaultSVMParams(MatrixStats const & stats);
+
 } // namespace obamadb
 
 #endif //OBAMADB_SVMTASK_H
@@ -0,0 +1,63 @@
+#ifndef OBAMADB_SPARSEDOT_H
+#define OBAMADB_SPARSEDOT_H
+
+#include "storage/exvector.h"
+#include "storage/StorageConstants.h"
+
+/**
+ * Sparse-sparse dot products. Both vectors' indices must be sorted in increasing order and unique,
+ * so the dot product is a sum over the intersection of the two index lists.
+ */
+namespace obamadb {
+
+  namespace ml {
+
+    /**
+     * Branchy merge of the two index lists, one element at a time.
+     */
+    num_t sparseDotScalar(const svector<num_t> &a, const svector<signed char> &b);
+
+    /**
+     * For each element of the shorter list, does an exponential then binary search in the longer
+     * list. Fast when one list is much longer than the other.
+     */
+    num_t sparseDotGalloping(const svector<num_t> &a, const svector<signed char> &b);
+
+    /**
+     * Compares blocks of 8 indices from each list against each other with AVX2 instructions, and
+     * advances whichever block has the smaller maximum. Only call if the CPU supports AVX2.
+     */
+    num_t sparseDotAVX2(const svector<num_t> &a, const svector<signed char> &b);
+
+    /**
+     * As sparseDotAVX2, with blocks of 16. Only call if the CPU supports AVX-512F.
+     */
+    num_t sparseDotAVX512(const svector<num_t> &a, const svector<signed char> &b);
+
+    /**
+     * @return True if the running CPU supports the given kernel.
+     */
+    bool cpuSupportsAVX2();
+
+    bool cpuSupportsAVX512();
+
+    /**
+     * Chooses a kernel for each pair by the ratio of the lists' lengths. Very skewed pairs use
+     * galloping search, others use the fastest block kernel the CPU supports (detected once from
+     * CPUID).
+     */
+    num_t sparseDot(const svector<num_t> &a, const svector<signed char> &b);
+
+    /**
+     * @return The name of the block kernel which sparseDot dispatches to.
+     */
+    const char* sparseDotBlockKernelName();
+
+    // Pairs whose longer list is at least this many times longer than the shorter one use galloping.
+    const int kGallopingRatio = 32;
+
+  }  // namespace ml
+
+}  // namespace obamadb
+
+#endif //OBAMADB_SPARSEDOT_H
@@ -1,18 +1,90 @@
 #include "storage/Utils.h"
 
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+
 #include "glog/logging.h"
 #include <gflags/gflags.h>
 
 #include "ThreadPool.h"
 
+#if !APPLE
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 DECLARE_string(core_affinities);
 
 namespace obamadb {
 
   namespace threading {
+    namespace {
+      std::atomic<int> DefaultBarrierSpinBudget(kDefaultBarrierSpinBudget);
+      std::atomic<PlacementPolicy> Placement(PlacementPolicy::kOnePerPhysicalCore);
+      std::atomic<bool> PerfCountersEnabled(false);
+    }
+
+    void setDefaultBarrierSpinBudget(int spins) {
+      CHECK_GE(spins, 0);
+      DefaultBarrierSpinBudget.store(spins);
+    }
+
+    int getDefaultBarrierSpinBudget() {
+      return DefaultBarrierSpinBudget.load();
+    }
+
+    void setPlacementPolicy(PlacementPolicy policy) {
+      Placement.store(policy);
+    }
+
+    PlacementPolicy getPlacementPolicy() {
+      return Placement.load();
+    }
+
+    void setPerfCountersEnabled(bool enabled) {
+      PerfCountersEnabled.store(enabled);
+    }
+
+    bool getPerfCountersEnabled() {
+      return PerfCountersEnabled.load(std::memory_order_relaxed);
+    }
+
+    CpuTopology const & getTopology() {
+      static CpuTopology const topology = CpuTopology::Discover();
+      return topology;
+    }
+
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t),
+                  "A generation is used as a futex word.");
+
+    void Generation::sleep(std::uint32_t seen) {
+      // The waker reads sleepers_ after advancing and we read the value after bumping sleepers_,
+      // so at least one of us sees the other's write and no wake-up is lost.
+      sleepers_.fetch_add(1, std::memory_order_seq_cst);
+      while (value_.load(std::memory_order_seq_cst) == seen) {
+#if APPLE
+        std::this_thread::yield();
+#else
+        // Returns at once if the value has already moved on.
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&value_), FUTEX_WAIT_PRIVATE,
+                seen, nullptr, nullptr, 0);
+#endif
+      }
+      sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void Generation::wakeAll() {
+#if !APPLE
+      syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&value_), FUTEX_WAKE_PRIVATE,
+              INT_MAX, nullptr, nullptr, 0);
+#endif
+    }
+
     int getCoreAffinity() {
       if (FLAGS_core_affinities.compare("-1") == 0) {
-        return NumThreadsAffinitized++;
+        std::vector<int> const order = getTopology().placement(getPlacementPolicy());
+        return order[NumThreadsAffinitized++ % order.size()];
       } else if (CoreAffinities.size() == 0) {
         std::vector<int> parsedAffinities = GetIntList(FLAGS_core_affinities);
         CoreAffinities.insert(CoreAffinities.begin(), parsedAffinities.begin(), parsedAffinities.end());
@@ -22,26 +94,286 @@ namespace obamadb {
       NumThreadsAffinitized++;
       return assigned;
     }
+
+    WorkStealingQueue::WorkStealingQueue(int num_workers)
+      : queues_() {
+      CHECK_GT(num_workers, 0);
+      for (int i = 0; i < num_workers; i++) {
+        queues_.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+      }
+    }
+
+    void WorkStealingQueue::fill(int num_units, int grain) {
+      CHECK_GT(grain, 0);
+      int const num_workers = queues_.size();
+      for (int w = 0; w < num_workers; w++) {
+        // Use 64 bit intermediates so large unit counts do not overflow.
+        int const lower = (static_cast<std::int64_t>(num_units) * w) / num_workers;
+        int const upper = (static_cast<std::int64_t>(num_units) * (w + 1)) / num_workers;
+        for (int begin = lower; begin < upper; begin += grain) {
+          push(w, WorkItem(begin, std::min(begin + grain, upper)));
+        }
+      }
+    }
+
+    void WorkStealingQueue::push(int worker, WorkItem const & item) {
+      WorkerQueue &queue = *queues_[worker];
+      std::lock_guard<std::mutex> lock(queue.lock);
+      queue.items.push_back(item);
+    }
+
+    bool WorkStealingQueue::pop(int worker, WorkItem *item) {
+      DCHECK_LE(0, worker);
+      DCHECK_LT(worker, getNumWorkers());
+      {
+        WorkerQueue &own = *queues_[worker];
+        std::lock_guard<std::mutex> lock(own.lock);
+        if (!own.items.empty()) {
+          *item = own.items.front();
+          own.items.pop_front();
+          return true;
+        }
+      }
+      int const num_workers = queues_.size();
+      for (int i = 1; i < num_workers; i++) {
+        WorkerQueue &victim = *queues_[(worker + i) % num_workers];
+        std::lock_guard<std::mutex> lock(victim.lock);
+        if (!victim.items.empty()) {
+          *item = victim.items.back();
+          victim.items.pop_back();
+          return true;
+        }
+      }
+      return false;
+    }
+
+    EpochScheduler::EpochScheduler(int num_workers, int num_units, int grain)
+      : queue_(num_workers),
+        num_units_(num_units),
+        grain_(grain),
+        finished_(0) {
+      queue_.fill(num_units_, grain_);
+    }
+
+    bool EpochScheduler::finish(int worker) {
+      DCHECK_LE(0, worker);
+      DCHECK_LT(worker, queue_.getNumWorkers());
+      (void) worker;
+      if (finished_.fetch_add(1, std::memory_order_acq_rel) + 1 < queue_.getNumWorkers()) {
+        return false;
+      }
+      // Every other worker has run out of items, so the queues can be refilled.
+      finished_.store(0, std::memory_order_relaxed);
+      queue_.fill(num_units_, grain_);
+      return true;
+    }
   }
 
-  void *WorkerLoop(void *worker_params) {
-    ThreadMeta *meta = reinterpret_cast<ThreadMeta*>(worker_params);
-    int assigned_core = threading::getCoreAffinity();
-    threading::setCoreAffinity(assigned_core);
-    int epoch = 0;
+  namespace {
+    WorkerPool *GlobalWorkerPool = nullptr;
+    thread_local WorkerPool *ThreadWorkerPool = nullptr;
+    // The state of the pool worker running on this thread.
+    thread_local ThreadMeta *CurrentWorker = nullptr;
+
+    double millisBetween(std::chrono::steady_clock::time_point start,
+                         std::chrono::steady_clock::time_point end) {
+      return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+  }
+
+  WorkerPool::WorkerPool(int num_workers)
+    : WorkerPool(ChooseCores(num_workers)) {}
+
+  WorkerPool::WorkerPool(std::vector<int> const & cores)
+    : meta_info_(),
+      threads_(),
+      job_fns_(nullptr),
+      job_states_(nullptr),
+      job_size_(0),
+      pending_(0),
+      completed_seen_(0),
+      completed_(),
+      stop_(false),
+      acquired_(false),
+      spin_budget_(threading::spinBudgetFor(cores.size() + 1, threading::getDefaultBarrierSpinBudget())) {
+    CHECK_GT(cores.size(), 0);
+    for (int i = 0; i < cores.size(); i++) {
+      meta_info_.push_back(std::unique_ptr<ThreadMeta>(new ThreadMeta(i, cores[i])));
+    }
+    for (int i = 0; i < cores.size(); i++) {
+      threads_.push_back(std::thread(&WorkerPool::workerLoop, this, i));
+    }
+  }
+
+  WorkerPool::~WorkerPool() {
+    DCHECK_EQ(0, getNumRunning()) << "Destroying a pool with a running job.";
+    stop_.store(true, std::memory_order_release);
+    for (auto & meta : meta_info_) {
+      meta->submitted.advance();
+    }
+    for (auto & thread : threads_) {
+      thread.join();
+    }
+  }
+
+  std::vector<int> WorkerPool::ChooseCores(int num_workers) {
+    // Choose cores here rather than in the workers, so the binding does not depend on start order.
+    std::vector<int> cores;
+    for (int i = 0; i < num_workers; i++) {
+      cores.push_back(threading::getCoreAffinity());
+    }
+    return cores;
+  }
+
+  void WorkerPool::submit(std::vector<std::function<void(int, void*)>> const & fns,
+                          std::vector<void*> const & states) {
+    CHECK_EQ(fns.size(), states.size());
+    CHECK_LE(fns.size(), meta_info_.size()) << "The job has more tasks than the pool has workers.";
+    DCHECK_EQ(0, getNumRunning()) << "Only one job runs at a time.";
+    job_fns_ = &fns;
+    job_states_ = &states;
+    job_size_ = fns.size();
+    completed_seen_ = completed_.load();
+    pending_.store(job_size_, std::memory_order_relaxed);
+    // Advancing publishes the job to the worker.
+    for (int i = 0; i < job_size_; i++) {
+      meta_info_[i]->submitted.advance();
+    }
+  }
+
+  void WorkerPool::wait() {
+    if (job_size_ > 0) {
+      completed_.awaitChange(completed_seen_, spin_budget_);
+      auto last_finish = meta_info_[0]->finished_at;
+      for (int i = 1; i < job_size_; i++) {
+        last_finish = std::max(last_finish, meta_info_[i]->finished_at);
+      }
+      for (int i = 0; i < job_size_; i++) {
+        meta_info_[i]->stats.wait_ms = millisBetween(meta_info_[i]->finished_at, last_finish);
+      }
+    }
+    job_size_ = 0;
+  }
+
+  void WorkerPool::workerLoop(int worker) {
+    ThreadMeta &meta = *meta_info_[worker];
+    threading::setCoreAffinity(meta.core);
+    CurrentWorker = &meta;
+    // Start from the initial generation rather than loading it, as a job may already be submitted.
+    std::uint32_t seen = 0;
     while (true) {
-      meta->barrier1->wait();
-      if (meta->stop) {
+      meta.submitted.awaitChange(seen, spin_budget_);
+      seen++;
+      if (stop_.load(std::memory_order_acquire)) {
         break;
+      }
+      meta.stats = WorkerStats();
+      auto const start = std::chrono::steady_clock::now();
+      if (threading::getPerfCountersEnabled()) {
+        if (meta.counters == nullptr) {
+          meta.counters.reset(new PerfCounters());
+        }
+        meta.counters->start();
+        (*job_fns_)[worker](worker, (*job_states_)[worker]);
+        meta.perf = meta.counters->stop();
       } else {
-        meta->fn_execute_(meta->thread_id, meta->state_);
+        (*job_fns_)[worker](worker, (*job_states_)[worker]);
+      }
+      meta.finished_at = std::chrono::steady_clock::now();
+      meta.stats.compute_ms = millisBetween(start, meta.finished_at);
+      if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        completed_.advance();
+      }
+    }
+  }
+
+  WorkerPool* WorkerPool::Global() {
+    return GlobalWorkerPool;
+  }
+
+  void WorkerPool::SetGlobal(WorkerPool *pool) {
+    GlobalWorkerPool = pool;
+  }
+
+  CycleReport CycleReport::Summarize(std::vector<WorkerStats> const & workers) {
+    CycleReport report;
+    if (workers.empty()) {
+      return report;
+    }
+    std::vector<double> times;
+    double total_ms = 0;
+    report.fastest = 0;
+    report.slowest = 0;
+    report.min_rows = workers[0].rows;
+    report.max_rows = workers[0].rows;
+    report.min_nonzeros = workers[0].nonzeros;
+    report.max_nonzeros = workers[0].nonzeros;
+    for (int i = 0; i < workers.size(); i++) {
+      WorkerStats const & worker = workers[i];
+      times.push_back(worker.compute_ms);
+      total_ms += worker.compute_ms;
+      if (worker.compute_ms < workers[report.fastest].compute_ms) {
+        report.fastest = i;
+      }
+      if (worker.compute_ms > workers[report.slowest].compute_ms) {
+        report.slowest = i;
+      }
+      report.max_wait_ms = std::max(report.max_wait_ms, worker.wait_ms);
+      report.min_rows = std::min(report.min_rows, worker.rows);
+      report.max_rows = std::max(report.max_rows, worker.rows);
+      report.min_nonzeros = std::min(report.min_nonzeros, worker.nonzeros);
+      report.max_nonzeros = std::max(report.max_nonzeros, worker.nonzeros);
+    }
+    std::sort(times.begin(), times.end());
+    int const n = times.size();
+    report.min_ms = times.front();
+    report.max_ms = times.back();
+    report.median_ms = n % 2 == 1 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+    double const mean_ms = total_ms / n;
+    report.imbalance = mean_ms > 0 ? report.max_ms / mean_ms : 1;
+    return report;
+  }
+
+  WorkerPool* WorkerPool::Current() {
+    return ThreadWorkerPool != nullptr ? ThreadWorkerPool : GlobalWorkerPool;
+  }
+
+  void WorkerPool::SetForThread(WorkerPool *pool) {
+    ThreadWorkerPool = pool;
+  }
+
+  void ThreadPool::begin() {
+    CHECK(own_pool_ == nullptr) << "Only call begin once.";
+    WorkerPool *current = WorkerPool::Current();
+    if (current == nullptr || current->getNumWorkers() < getNumWorkers()) {
+      own_pool_.reset(new WorkerPool(getNumWorkers()));
+    }
+  }
+
+  WorkerPool* ThreadPool::acquirePool() {
+    if (own_pool_ == nullptr) {
+      WorkerPool *current = WorkerPool::Current();
+      if (current != nullptr && current->getNumWorkers() >= getNumWorkers() && current->tryAcquire()) {
+        return current;
       }
-      meta->barrier2->wait();
-      epoch++;
+      // The current pool is busy and may stay so, e.g. when running the job which started this
+      // ThreadPool, so keep the private pool for later cycles.
+      own_pool_.reset(new WorkerPool(getNumWorkers()));
     }
-    return NULL;
+    return own_pool_.get();
+  }
+
+  void ThreadPool::stop() {
+    DCHECK(pool_.load() == nullptr) << "Stopping a pool during a cycle.";
+    own_pool_.reset();
   }
 
+  void threading::reportWork(std::int64_t rows, std::int64_t nonzeros) {
+    if (CurrentWorker != nullptr) {
+      CurrentWorker->stats.rows += rows;
+      CurrentWorker->stats.nonzeros += nonzeros;
+    }
+  }
 
   int threading::numCores() {
 #if APPLE
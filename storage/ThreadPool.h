@@ -7,15 +7,23 @@
 #define APPLE 0
 #endif
 
-#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <printf.h>
 #include <mutex>
+#include <memory>
 #include <thread>
 #include <unistd.h>
 #include <vector>
 
+#include "storage/PerfCounters.h"
+#include "storage/Topology.h"
+#include "storage/Utils.h"
+
 #include "glog/logging.h"
 #include <gflags/gflags.h>
 
@@ -26,38 +34,170 @@ namespace obamadb {
   // Keep the threading mac-compadible.
   namespace threading {
 
+    int numCores();
+
+    /**
+     * Default number of pause iterations a barrier waiter spins before it sleeps.
+     */
+    int const kDefaultBarrierSpinBudget = 2000;
+
+    /**
+     * Sets the spin budget of barriers created afterwards. A budget of 0 makes waiters sleep at once.
+     */
+    void setDefaultBarrierSpinBudget(int spins);
+
+    int getDefaultBarrierSpinBudget();
+
+    /**
+     * Sets the order in which getCoreAffinity hands out cpus when no core affinities are given.
+     */
+    void setPlacementPolicy(PlacementPolicy policy);
+
+    PlacementPolicy getPlacementPolicy();
+
+    /**
+     * @return The machine's topology, read from sysfs on first use.
+     */
+    CpuTopology const & getTopology();
+
+    /**
+     * Sets whether workers read hardware performance counters around each job they run.
+     */
+    void setPerfCountersEnabled(bool enabled);
+
+    bool getPerfCountersEnabled();
+
+    /**
+     * Adds to the rows and nonzeros the calling pool worker has processed in its current job. Does
+     * nothing on other threads.
+     */
+    void reportWork(std::int64_t rows, std::int64_t nonzeros);
+
+    /**
+     * Hints to the core that the thread is in a spin loop.
+     */
+    inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#elif defined(__aarch64__)
+      asm volatile("yield");
+#endif
+    }
+
+    /**
+     * A counter which threads can wait on to change. Waiters spin for a bounded number of iterations
+     * and then sleep on a futex, so a change which comes quickly is seen without a syscall and a
+     * long wait does not burn a core.
+     */
+    class Generation {
+    public:
+      Generation()
+        : value_(0),
+          sleepers_(0) {}
+
+      std::uint32_t load() const {
+        return value_.load(std::memory_order_acquire);
+      }
+
+      /**
+       * Increments the generation and wakes every waiter. Writes made before advancing are visible
+       * to threads which see the new generation.
+       */
+      void advance() {
+        value_.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+          wakeAll();
+        }
+      }
+
+      /**
+       * Blocks until the generation differs from seen.
+       * @param seen A generation previously returned by load().
+       * @param spinBudget Pause iterations before sleeping.
+       */
+      void awaitChange(std::uint32_t seen, int spinBudget) {
+        for (int i = 0; i < spinBudget; i++) {
+          if (value_.load(std::memory_order_acquire) != seen) {
+            return;
+          }
+          cpuRelax();
+        }
+        sleep(seen);
+      }
+
+    private:
+      void sleep(std::uint32_t seen);
+
+      void wakeAll();
+
+      std::atomic<std::uint32_t> value_;
+      std::atomic<int> sleepers_;
+
+      DISABLE_COPY_AND_ASSIGN(Generation);
+    };
+
+    /**
+     * The spin budget for waiting amongst a number of threads. Spinning is disabled when there are
+     * more threads than cores, as a spinning waiter would then delay the very threads it waits on.
+     */
+    inline int spinBudgetFor(int threads, int spinBudget) {
+      return threads > numCores() ? 0 : spinBudget;
+    }
+
+    /**
+     * A reusable barrier. Arrival is a single atomic decrement, and waiters wait on the barrier's
+     * generation, spinning briefly before they sleep.
+     *
+     * The generation acts as the barrier's sense: a waiter is released once the generation differs
+     * from the one it arrived in, so consecutive uses of the barrier cannot be confused.
+     */
     class barrier_t {
     public:
       barrier_t(int totalWaiters)
-        : mutex_(),
-          cond_(),
-          count_(totalWaiters),
-          epoch_(0),
-          threshold_(totalWaiters) {}
+        : barrier_t(totalWaiters, getDefaultBarrierSpinBudget()) {}
+
+      /**
+       * @param totalWaiters Number of threads which must arrive to break the barrier.
+       * @param spinBudget Pause iterations before a waiter sleeps. See spinBudgetFor.
+       */
+      barrier_t(int totalWaiters, int spinBudget)
+        : count_(totalWaiters),
+          generation_(),
+          threshold_(totalWaiters),
+          spin_budget_(spinBudgetFor(totalWaiters, spinBudget)) {}
 
       void wait() {
-        int epoch_stackvar = epoch_;
-        std::unique_lock<std::mutex> lock{mutex_};
-        if (!--count_) {
-          epoch_++;
-          count_ = threshold_;
-          cond_.notify_all();
-        } else {
-          cond_.wait(lock, [this, epoch_stackvar] { return epoch_stackvar != epoch_; });
+        std::uint32_t const generation = generation_.load();
+        if (count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          // Reset before the release, threads only arrive for the next use after seeing it.
+          count_.store(threshold_, std::memory_order_relaxed);
+          generation_.advance();
+          return;
         }
+        generation_.awaitChange(generation, spin_budget_);
+      }
+
+      /**
+       * @return The number of threads which have yet to arrive at the barrier.
+       */
+      int count() const {
+        return count_.load(std::memory_order_acquire);
       }
 
-      int count() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return count_;
+      int getSpinBudget() const {
+        return spin_budget_;
       }
 
     private:
-      std::mutex mutex_;
-      std::condition_variable cond_;
-      int count_;
-      int epoch_; // # times broken.
+      // Arrivals write count_ while waiters poll generation_, so keep them on separate cache lines.
+      std::atomic<int> count_;
+      char padding1_[64];
+      Generation generation_;
+      char padding2_[64];
       int const threshold_;
+      int const spin_budget_;
+
+      DISABLE_COPY_AND_ASSIGN(barrier_t);
     };
 
    /**
@@ -87,64 +227,333 @@ namespace obamadb {
     static std::vector<int> CoreAffinities;
 
     /**
-     * Choose the optimal core. This is experimental. In the future we should get this automatically from
-     * lib numa like in
-     * https://github.com/apache/incubator-quickstep/pull/126/commits/248cec27341fa8f19658d0705c1dca3fec0ff550
+     * Choose the next core. Cores are taken in turn from the core_affinities flag, or when it is not
+     * given, from the machine's topology in the order of the placement policy.
      * @return The core to bind to.
      */
     int getCoreAffinity();
 
-    int numCores();
+    /**
+     * A contiguous range [begin, end) of units of work, e.g. a range of block indices.
+     */
+    struct WorkItem {
+      WorkItem() : begin(0), end(0) {}
+
+      WorkItem(int begin, int end) : begin(begin), end(end) {}
+
+      int begin;
+      int end;
+    };
+
+    /**
+     * A set of per-worker double ended queues of work items. A worker pops items from the front of
+     * its own queue and when that runs dry, it steals from the back of another worker's queue.
+     * Stealing from the back leaves the victim the items nearest to the ones it is working on.
+     */
+    class WorkStealingQueue {
+    public:
+      WorkStealingQueue(int num_workers);
+
+      /**
+       * Splits [0, num_units) into items of at most grain units. Each worker's queue initially holds
+       * a contiguous run of items, and every unit is covered exactly once.
+       * @param num_units Total units of work.
+       * @param grain Maximum units per item.
+       */
+      void fill(int num_units, int grain);
+
+      void push(int worker, WorkItem const & item);
+
+      /**
+       * Gets the next item for a worker, stealing if the worker's own queue is empty.
+       * @param worker The id of the calling worker.
+       * @param item Set to the next item.
+       * @return False if no work remains in any queue.
+       */
+      bool pop(int worker, WorkItem *item);
+
+      int getNumWorkers() const {
+        return queues_.size();
+      }
+
+    private:
+      struct WorkerQueue {
+        std::mutex lock;
+        std::deque<WorkItem> items;
+        char padding[64]; // keeps neighboring queues' locks off of the same cache line.
+      };
+
+      std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    };
+
+    /**
+     * Schedules the work of repeated epochs over a thread pool. Each epoch covers [0, num_units) in
+     * items of at most grain units. Workers pull items with next(), stealing once their own queue is
+     * empty, so a slow worker or an expensive item does not hold every other worker at the barrier.
+     *
+     * The scheduler refills itself: the last worker to finish an epoch refills the queues for the
+     * next epoch before it reaches the pool's barrier.
+     */
+    class EpochScheduler {
+    public:
+      EpochScheduler(int num_workers, int num_units, int grain);
+
+      /**
+       * @param worker The id of the calling worker.
+       * @param item Set to the next item of the current epoch.
+       * @return False once the epoch has no items left.
+       */
+      bool next(int worker, WorkItem *item) {
+        return queue_.pop(worker, item);
+      }
+
+      /**
+       * Each worker must call this exactly once per epoch, after next() has returned false.
+       * @return True for the last worker to finish, which may then do per-epoch bookkeeping
+       *         (e.g. decay a step size) as no other worker is still processing items.
+       */
+      bool finish(int worker);
+
+      int getNumWorkers() const {
+        return queue_.getNumWorkers();
+      }
+
+    private:
+      WorkStealingQueue queue_;
+      int const num_units_;
+      int const grain_;
+      std::atomic<int> finished_;
+
+      DISABLE_COPY_AND_ASSIGN(EpochScheduler);
+    };
 
   } // end namespace threading
 
 /*
- * Information relating to the running state of a thread.
+ * What a worker did during one job.
+ */
+struct WorkerStats {
+  WorkerStats()
+    : compute_ms(0),
+      wait_ms(0),
+      rows(0),
+      nonzeros(0) {}
+
+  double compute_ms;
+  // Time from finishing until the last worker of the job finished, i.e. time spent idle at the end
+  // of the cycle.
+  double wait_ms;
+  // As reported by the task through threading::reportWork.
+  std::int64_t rows;
+  std::int64_t nonzeros;
+};
+
+/*
+ * How evenly a cycle's work was spread over the threads of a pool.
+ */
+struct CycleReport {
+  CycleReport()
+    : min_ms(0),
+      median_ms(0),
+      max_ms(0),
+      imbalance(1),
+      fastest(-1),
+      slowest(-1),
+      max_wait_ms(0),
+      min_rows(0),
+      max_rows(0),
+      min_nonzeros(0),
+      max_nonzeros(0) {}
+
+  static CycleReport Summarize(std::vector<WorkerStats> const & workers);
+
+  // Compute time of the threads.
+  double min_ms;
+  double median_ms;
+  double max_ms;
+  // Max over mean compute time, 1 when the work is perfectly balanced.
+  double imbalance;
+  int fastest;
+  int slowest;
+  double max_wait_ms;
+
+  std::int64_t min_rows;
+  std::int64_t max_rows;
+  std::int64_t min_nonzeros;
+  std::int64_t max_nonzeros;
+};
+
+/*
+ * Information relating to the running state of a worker thread.
  */
 struct ThreadMeta {
-  ThreadMeta(int thread_id,
-             threading::barrier_t *barrier1,
-             threading::barrier_t *barrier2,
-             std::function<void(int, void*)> task_fn,
-             void* state) :
-    thread_id(thread_id),
-    barrier1(barrier1),
-    barrier2(barrier2),
-    fn_execute_(task_fn),
-    state_(state),
-    stop(false) {}
+  ThreadMeta(int thread_id, int core)
+    : thread_id(thread_id),
+      core(core),
+      stats(),
+      finished_at(),
+      counters(),
+      perf(),
+      submitted() {}
 
   int thread_id;
+  int core;
 
-  threading::barrier_t *barrier1;
-  threading::barrier_t *barrier2;
+  // Timing and work of the worker's last job.
+  WorkerStats stats;
+  std::chrono::steady_clock::time_point finished_at;
 
-  std::function<void(int, void*)> fn_execute_;
-  void* state_;
+  // Opened by the worker on the first job it counts.
+  std::unique_ptr<PerfCounters> counters;
+  // Counts of the worker's last job.
+  PerfSample perf;
 
-  bool stop;
+  // Advanced when a job is handed to this worker.
+  threading::Generation submitted;
+  char padding[64]; // keeps neighboring workers' generations off of the same cache line.
 };
 
-// takes the thread_t pointer as an argument.
-void* WorkerLoop(void *worker_params);
+/*
+ * A persistent pool of worker threads, each bound to a core once when the pool starts. A job is
+ * handed over without creating threads or taking locks: the submitter publishes the job and
+ * advances the generation of each worker taking part, and the last of those workers to finish
+ * advances the pool's completion generation.
+ *
+ * One job runs at a time. A process normally creates one pool in main and registers it with
+ * SetGlobal, and every ThreadPool then runs its cycles on it.
+ */
+class WorkerPool {
+public:
+  /**
+   * Binds the workers to the cores chosen by threading::getCoreAffinity.
+   */
+  WorkerPool(int num_workers);
+
+  /**
+   * Binds worker i to cores[i].
+   */
+  WorkerPool(std::vector<int> const & cores);
+
+  ~WorkerPool();
+
+  /**
+   * Starts a job on workers [0, fns.size()). Worker i calls fns[i](i, states[i]). The vectors must
+   * stay alive until wait() returns.
+   */
+  void submit(std::vector<std::function<void(int, void*)>> const & fns,
+              std::vector<void*> const & states);
+
+  /**
+   * Blocks until every worker of the submitted job has finished.
+   */
+  void wait();
+
+  int getNumWorkers() const {
+    return meta_info_.size();
+  }
+
+  /**
+   * @return The core the worker is bound to.
+   */
+  int getCore(int worker) const {
+    return meta_info_[worker]->core;
+  }
+
+  /**
+   * @return The timing and work of the worker's last job. Read after wait() returns.
+   */
+  WorkerStats const & getWorkerStats(int worker) const {
+    return meta_info_[worker]->stats;
+  }
+
+  /**
+   * @return The hardware counts of the worker's last job. Read after wait() returns.
+   */
+  PerfSample const & getPerfSample(int worker) const {
+    return meta_info_[worker]->perf;
+  }
+
+  /**
+   * @return The number of workers which have yet to finish the current job.
+   */
+  int getNumRunning() const {
+    return pending_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Reserves the pool for one user, e.g. a ThreadPool, so that users do not interleave jobs.
+   * @return False if the pool is already reserved.
+   */
+  bool tryAcquire() {
+    bool expected = false;
+    return acquired_.compare_exchange_strong(expected, true);
+  }
+
+  void release() {
+    acquired_.store(false);
+  }
+
+  /**
+   * @return The process-wide pool, or nullptr if none was registered.
+   */
+  static WorkerPool* Global();
+
+  /**
+   * Registers the process-wide pool. Not owned, pass nullptr before destroying it.
+   */
+  static void SetGlobal(WorkerPool *pool);
+
+  /**
+   * @return The pool which ThreadPools started on the calling thread run on: the thread's own pool
+   *         if one was set, otherwise the global pool.
+   */
+  static WorkerPool* Current();
+
+  /**
+   * Sets the pool for ThreadPools started on the calling thread, e.g. to keep a background thread's
+   * work on cores of its own. Not owned, pass nullptr before destroying it.
+   */
+  static void SetForThread(WorkerPool *pool);
+
+private:
+  static std::vector<int> ChooseCores(int num_workers);
+
+  void workerLoop(int worker);
+
+  std::vector<std::unique_ptr<ThreadMeta>> meta_info_;
+  std::vector<std::thread> threads_;
+
+  // The current job.
+  std::vector<std::function<void(int, void*)>> const * job_fns_;
+  std::vector<void*> const * job_states_;
+  int job_size_;
+  std::atomic<int> pending_;
+
+  std::uint32_t completed_seen_;
+  threading::Generation completed_;
+  std::atomic<bool> stop_;
+  std::atomic<bool> acquired_;
+  int const spin_budget_;
+
+  DISABLE_COPY_AND_ASSIGN(WorkerPool);
+};
 
 /*
- * A simple static-task thread pool.
+ * A simple static-task thread pool. Each cycle runs every task once, as a job on the current
+ * WorkerPool when it is free and large enough, or otherwise on a WorkerPool private to this pool.
+ * The current pool is only reserved for the length of a cycle, so other work, e.g. evaluating the
+ * model, can use it between cycles.
  */
 class ThreadPool {
 public:
   ThreadPool(std::vector<std::function<void(int, void*)>> const & thread_fns,
              const std::vector<void*> &thread_states)
-    : meta_info_(),
-      threads_(),
-      num_workers_(thread_states.size()),
-      b1_(new threading::barrier_t(num_workers_ + 1)),
-      b2_(new threading::barrier_t(num_workers_ + 1))
-  {
-    for (int i = 0; i < thread_states.size(); ++i) {
-      meta_info_.push_back(ThreadMeta(i, b1_, b2_, thread_fns[i], thread_states[i]));
-    }
-  }
+    : fns_(thread_fns),
+      states_(thread_states),
+      pool_(nullptr),
+      own_pool_(),
+      worker_stats_(),
+      perf_samples_() {}
 
   /**
    * ctor
@@ -160,67 +569,99 @@ public:
   ThreadPool(std::function<void(int, void*)> thread_fn,
              void* shared_thread_state,
              int num_threads)
-    : meta_info_(),
-      threads_(),
-      num_workers_(num_threads),
-      b1_(new threading::barrier_t(num_workers_ + 1)),
-      b2_(new threading::barrier_t(num_workers_ + 1))
-  {
-    for (int i = 0; i < num_workers_; ++i) {
-      meta_info_.push_back(ThreadMeta(i, b1_, b2_, thread_fn, shared_thread_state));
-    }
-  }
+    : fns_(num_threads, thread_fn),
+      states_(num_threads, shared_thread_state),
+      pool_(nullptr),
+      own_pool_(),
+      worker_stats_(),
+      perf_samples_() {}
 
   ~ThreadPool() {
-    delete b1_;
-    delete b2_;
-    for (int i = 0; i < threads_.size(); i++){
-      delete threads_[i];
-    }
+    stop();
   }
 
   /**
-   * Only call this method once.
+   * Only call this method once. Starts a private WorkerPool if the current one is too small.
    */
-  void begin() {
-    for (unsigned i = 0; i < num_workers_; i++) {
-      threads_.push_back(new std::thread(WorkerLoop, static_cast<void*>(&meta_info_[i])));
-    }
-  }
+  void begin();
 
   void cycle() {
-    b1_->wait();
+    WorkerPool *pool = acquirePool();
+    pool_.store(pool, std::memory_order_release);
+    pool->submit(fns_, states_);
     // workers do the routine
-    b2_->wait();
-    // workers are finished with routine and waiting on 1.
+    pool->wait();
+    // workers are finished with routine.
+    worker_stats_.resize(getNumWorkers());
+    for (int i = 0; i < getNumWorkers(); i++) {
+      worker_stats_[i] = pool->getWorkerStats(i);
+    }
+    if (threading::getPerfCountersEnabled()) {
+      perf_samples_.resize(getNumWorkers());
+      for (int i = 0; i < getNumWorkers(); i++) {
+        perf_samples_[i] = pool->getPerfSample(i);
+      }
+    }
+    pool_.store(nullptr, std::memory_order_relaxed);
+    if (pool != own_pool_.get()) {
+      pool->release();
+    }
     // Here is an opportunity to re-allocate work, and do an update to the model.
   }
 
-  int getWaiterCount() const {
-    return b2_->count();
+  /**
+   * @return The number of this pool's threads which have yet to finish the current cycle, 0
+   *         between cycles.
+   */
+  int getNumRunning() const {
+    WorkerPool const *pool = pool_.load(std::memory_order_acquire);
+    return pool == nullptr ? 0 : pool->getNumRunning();
   }
 
   int getNumWorkers() const {
-    return num_workers_;
+    return fns_.size();
   }
 
-  void stop() {
-    for (unsigned i = 0; i < num_workers_; i++) {
-      meta_info_[i].stop = true;
-    }
-    b1_->wait();
-    for (unsigned i = 0; i < threads_.size(); i++) {
-      threads_[i]->join();
-    }
+  /**
+   * @return Each thread's timing and work during the last cycle.
+   */
+  std::vector<WorkerStats> const & getWorkerStats() const {
+    return worker_stats_;
+  }
+
+  /**
+   * @return A summary of how evenly the last cycle's work was spread over the threads.
+   */
+  CycleReport getCycleReport() const {
+    return CycleReport::Summarize(worker_stats_);
+  }
+
+  /**
+   * @return Each thread's hardware counts during the last cycle, empty if counters are disabled.
+   */
+  std::vector<PerfSample> const & getPerfSamples() const {
+    return perf_samples_;
   }
 
+  void stop();
+
 private:
-  std::vector<ThreadMeta> meta_info_;
-  std::vector<std::thread*> threads_;
-  int num_workers_;
+  /**
+   * @return The current WorkerPool, reserved, or the private pool if the current one is too small
+   *         or busy, e.g. running the job which started this ThreadPool.
+   */
+  WorkerPool* acquirePool();
+
+  std::vector<std::function<void(int, void*)>> fns_;
+  std::vector<void*> states_;
+
+  // The pool running the current cycle.
+  std::atomic<WorkerPool*> pool_;
+  std::unique_ptr<WorkerPool> own_pool_;
+  std::vector<WorkerStats> worker_stats_;
+  std::vector<PerfSample> perf_samples_;
 
-  threading::barrier_t *b1_;
-  threading::barrier_t *b2_;
+  DISABLE_COPY_AND_ASSIGN(ThreadPool);
 };
 
 } // namespace obamadb
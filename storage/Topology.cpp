@@ -0,0 +1,233 @@
+#include "storage/Topology.h"
+
+#include "storage/ThreadPool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <tuple>
+
+#include "glog/logging.h"
+
+namespace obamadb {
+
+  namespace threading {
+
+    namespace {
+
+      /**
+       * Reads the first line of a sysfs file.
+       * @return False if the file could not be read.
+       */
+      bool readLine(std::string const & path, std::string *line) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+          return false;
+        }
+        return static_cast<bool>(std::getline(file, *line));
+      }
+
+      int readInt(std::string const & path, int default_value) {
+        std::string line;
+        if (!readLine(path, &line)) {
+          return default_value;
+        }
+        return std::atoi(line.c_str());
+      }
+
+      /**
+       * @return The lowest cpu sharing the cpu's highest level cache, the cpu itself if no cache is
+       *         listed.
+       */
+      int readLastLevelCache(std::string const & cpu_dir, int cpu) {
+        int best_level = 0;
+        int shared = cpu;
+        for (int index = 0; ; index++) {
+          std::string const dir = cpu_dir + "/cache/index" + std::to_string(index);
+          int const level = readInt(dir + "/level", -1);
+          if (level == -1) {
+            break;
+          }
+          std::string list;
+          if (level > best_level && readLine(dir + "/shared_cpu_list", &list)) {
+            std::vector<int> cpus = ParseCpuList(list);
+            if (!cpus.empty()) {
+              best_level = level;
+              shared = *std::min_element(cpus.begin(), cpus.end());
+            }
+          }
+        }
+        return shared;
+      }
+
+      CpuTopology flatTopology() {
+        std::vector<CpuInfo> cpus;
+        for (int cpu = 0; cpu < numCores(); cpu++) {
+          cpus.push_back(CpuInfo(cpu, 0, cpu, 0));
+        }
+        return CpuTopology(cpus);
+      }
+
+      typedef std::tuple<int, int, int, int> OrderKey;
+
+    } // namespace
+
+    bool ParsePlacementPolicy(std::string const & name, PlacementPolicy *policy) {
+      static std::map<std::string, PlacementPolicy> const kPolicies = {
+        {"linear", PlacementPolicy::kLinear},
+        {"compact", PlacementPolicy::kCompact},
+        {"scatter", PlacementPolicy::kScatter},
+        {"one-per-physical-core", PlacementPolicy::kOnePerPhysicalCore},
+        {"fill-socket-first", PlacementPolicy::kFillSocketFirst},
+      };
+      auto it = kPolicies.find(name);
+      if (it == kPolicies.end()) {
+        return false;
+      }
+      *policy = it->second;
+      return true;
+    }
+
+    std::string PlacementPolicyName(PlacementPolicy policy) {
+      switch (policy) {
+        case PlacementPolicy::kLinear:
+          return "linear";
+        case PlacementPolicy::kCompact:
+          return "compact";
+        case PlacementPolicy::kScatter:
+          return "scatter";
+        case PlacementPolicy::kOnePerPhysicalCore:
+          return "one-per-physical-core";
+        case PlacementPolicy::kFillSocketFirst:
+          return "fill-socket-first";
+      }
+      return "unknown";
+    }
+
+    std::vector<int> ParseCpuList(std::string const & list) {
+      std::vector<int> cpus;
+      std::stringstream stream(list);
+      std::string range;
+      while (std::getline(stream, range, ',')) {
+        if (range.empty() || range == "\n") {
+          continue;
+        }
+        size_t const dash = range.find('-');
+        int const first = std::atoi(range.substr(0, dash).c_str());
+        int const last = dash == std::string::npos ? first : std::atoi(range.substr(dash + 1).c_str());
+        for (int cpu = first; cpu <= last; cpu++) {
+          cpus.push_back(cpu);
+        }
+      }
+      return cpus;
+    }
+
+    CpuTopology::CpuTopology(std::vector<CpuInfo> const & cpus)
+      : cpus_(cpus) {
+      CHECK(!cpus_.empty());
+      std::sort(cpus_.begin(), cpus_.end(), [](CpuInfo const & a, CpuInfo const & b) {
+        return a.cpu < b.cpu;
+      });
+      // The lowest numbered hyperthread of a core has rank 0.
+      std::map<std::pair<int, int>, int> threads_per_core;
+      for (CpuInfo & info : cpus_) {
+        info.smt = threads_per_core[std::make_pair(info.socket, info.core)]++;
+      }
+    }
+
+    CpuTopology CpuTopology::Discover(std::string const & sysfs_root) {
+      std::string online;
+      if (APPLE || !readLine(sysfs_root + "/online", &online)) {
+        return flatTopology();
+      }
+      std::vector<CpuInfo> cpus;
+      for (int cpu : ParseCpuList(online)) {
+        std::string const cpu_dir = sysfs_root + "/cpu" + std::to_string(cpu);
+        // Some virtual machines report -1 for the package.
+        int const socket = std::max(0, readInt(cpu_dir + "/topology/physical_package_id", 0));
+        int const core = readInt(cpu_dir + "/topology/core_id", cpu);
+        cpus.push_back(CpuInfo(cpu, socket, core, readLastLevelCache(cpu_dir, cpu)));
+      }
+      if (cpus.empty()) {
+        return flatTopology();
+      }
+      return CpuTopology(cpus);
+    }
+
+    std::vector<int> CpuTopology::placement(PlacementPolicy policy) const {
+      // Core ids may be sparse, so number the physical cores of each socket from 0.
+      std::map<std::pair<int, int>, int> core_ranks;
+      for (CpuInfo const & info : cpus_) {
+        core_ranks.insert(std::make_pair(std::make_pair(info.socket, info.core), 0));
+      }
+      std::map<int, int> cores_per_socket;
+      for (auto & entry : core_ranks) {
+        entry.second = cores_per_socket[entry.first.first]++;
+      }
+
+      std::vector<std::pair<OrderKey, int>> keyed;
+      for (CpuInfo const & info : cpus_) {
+        int const core = core_ranks[std::make_pair(info.socket, info.core)];
+        OrderKey key;
+        switch (policy) {
+          case PlacementPolicy::kLinear:
+            key = std::make_tuple(info.cpu, 0, 0, 0);
+            break;
+          case PlacementPolicy::kCompact:
+            key = std::make_tuple(info.socket, core, info.smt, info.cpu);
+            break;
+          case PlacementPolicy::kScatter:
+            key = std::make_tuple(info.smt, core, info.socket, info.cpu);
+            break;
+          case PlacementPolicy::kOnePerPhysicalCore:
+            key = std::make_tuple(info.smt, info.socket, core, info.cpu);
+            break;
+          case PlacementPolicy::kFillSocketFirst:
+            key = std::make_tuple(info.socket, info.smt, core, info.cpu);
+            break;
+        }
+        keyed.push_back(std::make_pair(key, info.cpu));
+      }
+      std::sort(keyed.begin(), keyed.end());
+
+      std::vector<int> order;
+      for (auto const & entry : keyed) {
+        order.push_back(entry.second);
+      }
+      return order;
+    }
+
+    std::string CpuTopology::describe(int cpu) const {
+      for (CpuInfo const & info : cpus_) {
+        if (info.cpu == cpu) {
+          std::stringstream ss;
+          ss << "cpu" << cpu << "(socket " << info.socket << ", core " << info.core
+             << ", smt " << info.smt << ", l3 " << info.l3 << ")";
+          return ss.str();
+        }
+      }
+      return "cpu" + std::to_string(cpu) + "(unknown)";
+    }
+
+    int CpuTopology::numPhysicalCores() const {
+      int count = 0;
+      for (CpuInfo const & info : cpus_) {
+        count += info.smt == 0;
+      }
+      return count;
+    }
+
+    int CpuTopology::numSockets() const {
+      std::vector<int> sockets;
+      for (CpuInfo const & info : cpus_) {
+        sockets.push_back(info.socket);
+      }
+      std::sort(sockets.begin(), sockets.end());
+      return std::unique(sockets.begin(), sockets.end()) - sockets.begin();
+    }
+
+  } // namespace threading
+
+} // namespace obamadb
@@ -0,0 +1,98 @@
+#ifndef OBAMADB_TOPOLOGY_H_
+#define OBAMADB_TOPOLOGY_H_
+
+#include "storage/Utils.h"
+
+#include <string>
+#include <vector>
+
+namespace obamadb {
+
+  namespace threading {
+
+    /**
+     * Where one logical cpu sits in the machine.
+     */
+    struct CpuInfo {
+      CpuInfo(int cpu, int socket, int core, int l3)
+        : cpu(cpu), socket(socket), core(core), l3(l3), smt(0) {}
+
+      int cpu;    // the id used for affinity.
+      int socket; // physical package id.
+      int core;   // physical core id, unique within a socket.
+      int l3;     // lowest cpu sharing this cpu's last level cache.
+      int smt;    // rank of this cpu amongst the hyperthreads of its physical core.
+    };
+
+    /**
+     * Orders in which workers are placed on cpus. With N workers, the first N cpus of the order are
+     * used.
+     */
+    enum class PlacementPolicy {
+      kLinear,              // cpus 0, 1, 2, ... in id order, which may put workers on sibling hyperthreads.
+      kCompact,             // fill every hyperthread of a core, then the next core, then the next socket.
+      kScatter,             // round robin over sockets, then physical cores, before using hyperthreads.
+      kOnePerPhysicalCore,  // one hyperthread of each physical core, socket by socket, and then the siblings.
+      kFillSocketFirst,     // every physical core of a socket, then its hyperthreads, then the next socket.
+    };
+
+    /**
+     * @return False if the name does not name a policy.
+     */
+    bool ParsePlacementPolicy(std::string const & name, PlacementPolicy *policy);
+
+    std::string PlacementPolicyName(PlacementPolicy policy);
+
+    /**
+     * Parses a sysfs cpu list such as "0-3,8,10-11".
+     */
+    std::vector<int> ParseCpuList(std::string const & list);
+
+    /**
+     * The sockets, physical cores, hyperthreads and shared last level caches of the machine.
+     */
+    class CpuTopology {
+    public:
+      /**
+       * @param cpus The machine's cpus, in any order. Sets each cpu's smt rank.
+       */
+      CpuTopology(std::vector<CpuInfo> const & cpus);
+
+      /**
+       * Reads the topology of the online cpus from sysfs. When sysfs is unavailable, e.g. on mac,
+       * every cpu is reported as a separate core of one socket.
+       * @param sysfs_root Directory holding the cpuN directories.
+       */
+      static CpuTopology Discover(std::string const & sysfs_root = "/sys/devices/system/cpu");
+
+      /**
+       * @return Every cpu, ordered for the given policy.
+       */
+      std::vector<int> placement(PlacementPolicy policy) const;
+
+      /**
+       * @return A description of the cpu such as "cpu3(socket 0, core 1, smt 1, l3 0)".
+       */
+      std::string describe(int cpu) const;
+
+      int numCpus() const {
+        return cpus_.size();
+      }
+
+      int numPhysicalCores() const;
+
+      int numSockets() const;
+
+      std::vector<CpuInfo> const & getCpus() const {
+        return cpus_;
+      }
+
+    private:
+      std::vector<CpuInfo> cpus_;
+    };
+
+  } // namespace threading
+
+} // namespace obamadb
+
+#endif //OBAMADB_TOPOLOGY_H_
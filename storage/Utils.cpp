@@ -36,7 +36,7 @@ namespace obamadb {
         }
       }
     }
-    vec.push_back(cur_int);
+    vec.push_back(cur_int * (negate ? -1 : 1));
     return vec;
   }
 
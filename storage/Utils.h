@@ -71,6 +71,19 @@ namespace obamadb {
 
   };
 
+  /**
+   * A 64 bit mixing function (the SplitMix64 finalizer). Every bit of the input affects every bit
+   * of the output, so it is suitable for deriving pseudo-random values from keys.
+   * @param key Value to hash.
+   * @return Hashed value.
+   */
+  inline std::uint64_t hashInt64(std::uint64_t key) {
+    key += 0x9E3779B97F4A7C15ULL;
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+    return key ^ (key >> 31);
+  }
+
   class QuickRandom {
   public:
     QuickRandom() : x(15486719), y(19654991), z(16313527), char_index(0) {
@@ -81,6 +94,16 @@ namespace obamadb {
       }
     }
 
+    /**
+     * A generator whose sequence is derived from the seed, e.g. one per thread.
+     */
+    explicit QuickRandom(std::uint64_t seed)
+      : x(hashInt64(3 * seed)), y(hashInt64(3 * seed + 1)), z(hashInt64(3 * seed + 2)), char_index(0) {
+      for (int i = 0; i < 5; i++) {
+        nextInt64();
+      }
+    }
+
     inline std::uint64_t nextInt64() {
       // TODO: there are many other ways to generate random numbers,
       // http://stackoverflow.com/questions/1640258/need-a-fast-random-generator-for-c
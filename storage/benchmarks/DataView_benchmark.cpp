@@ -0,0 +1,112 @@
+#include "storage/DataView.h"
+#include "storage/exvector.h"
+#include "storage/SparseDataBlock.h"
+#include "storage/Utils.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include <gflags/gflags.h>
+
+DEFINE_string(core_affinities, "-1", "A comma separated list of cores to have threads bind to.");
+DEFINE_int64(num_rows, 2000000, "The number of rows scanned.");
+DEFINE_int64(num_columns, 100000, "The width of the model the rows are dotted with.");
+DEFINE_int64(num_passes, 5, "The number of timed passes over the rows for each method.");
+
+namespace obamadb {
+
+  /**
+   * Microbenchmark of the per-row cost of scanning a DataView, with rows of 1 to 64 nonzeros. Each
+   * row is dotted with a model, as training does, one row per getNext() call or a batch of rows per
+   * getNextBatch() call.
+   *
+   * @return Blocks of rows with nnz nonzeros each, at random increasing columns.
+   */
+  std::vector<std::unique_ptr<SparseDataBlock<num_t>>> getBlocks(int num_rows, int nnz, int num_columns) {
+    std::vector<std::unique_ptr<SparseDataBlock<num_t>>> blocks;
+    blocks.push_back(std::unique_ptr<SparseDataBlock<num_t>>(new SparseDataBlock<num_t>()));
+    QuickRandom qr;
+    static num_t label = 1;
+    for (int i = 0; i < num_rows; i++) {
+      svector<num_t> row;
+      row.setClassification(&label);
+      int column = qr.nextInt32() % (num_columns / nnz);
+      for (int j = 0; j < nnz; j++) {
+        row.push_back(column, 1);
+        column += 1 + qr.nextInt32() % (num_columns / nnz - 1);
+      }
+      if (!blocks.back()->appendRow(row)) {
+        blocks.push_back(std::unique_ptr<SparseDataBlock<num_t>>(new SparseDataBlock<num_t>()));
+        CHECK(blocks.back()->appendRow(row));
+      }
+    }
+    return blocks;
+  }
+
+  /**
+   * @return Mean nanoseconds per row.
+   */
+  template<class Scan>
+  double timeScan(DataView *view, int num_rows, Scan scan) {
+    num_t sum = 0;
+    scan(view, &sum);
+    auto time_start = std::chrono::steady_clock::now();
+    for (int p = 0; p < FLAGS_num_passes; p++) {
+      scan(view, &sum);
+    }
+    auto time_end = std::chrono::steady_clock::now();
+    CHECK_NE(-1, sum);
+    std::chrono::duration<double, std::nano> time_ns = time_end - time_start;
+    return time_ns.count() / (num_rows * FLAGS_num_passes);
+  }
+
+} // namespace obamadb
+
+int main(int argc, char** argv) {
+  using namespace obamadb;
+  ::gflags::ParseCommandLineFlags(&argc, &argv, true);
+  fvector theta = fvector::GetRandomFVector(FLAGS_num_columns);
+  num_t const * model = theta.values_;
+
+  printf("rows: %ld, model columns: %ld\n", (long) FLAGS_num_rows, (long) FLAGS_num_columns);
+  printf("nnz_per_row, get_next_ns, get_next_batch_ns\n");
+  for (int nnz = 1; nnz <= 64; nnz *= 4) {
+    auto blocks = getBlocks(FLAGS_num_rows, nnz, FLAGS_num_columns);
+    DataView view;
+    for (auto const & block : blocks) {
+      view.appendBlock(block.get());
+    }
+
+    double const row_ns = timeScan(&view, FLAGS_num_rows, [model](DataView *v, num_t *sum) {
+      v->reset();
+      svector<num_t> row(0, nullptr);
+      while (v->getNext(&row)) {
+        num_t dot = 0;
+        for (int i = 0; i < row.num_elements_; i++) {
+          dot += row.values_[i] * model[row.index_[i]];
+        }
+        *sum += dot * *row.class_;
+      }
+    });
+    double const batch_ns = timeScan(&view, FLAGS_num_rows, [model](DataView *v, num_t *sum) {
+      v->reset();
+      SparseRowBatch batch;
+      while (v->getNextBatch(SparseRowBatch::kMaxRows, &batch)) {
+        for (int r = 0; r < batch.size; r++) {
+          int const *index = batch.index(r);
+          num_t const *values = batch.row(r);
+          int const length = batch.length(r);
+          num_t dot = 0;
+          for (int i = 0; i < length; i++) {
+            dot += values[i] * model[index[i]];
+          }
+          *sum += dot * batch.label(r);
+        }
+      }
+    });
+    printf("%d, %.2f, %.2f\n", nnz, row_ns, batch_ns);
+  }
+  return 0;
+}
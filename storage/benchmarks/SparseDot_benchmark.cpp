@@ -0,0 +1,133 @@
+#include "storage/exvector.h"
+#include "storage/SparseDot.h"
+#include "storage/Utils.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include <gflags/gflags.h>
+
+DEFINE_bool(verbose, false, "Print out extra diagnostic information.");
+DEFINE_int64(num_rows, 20000, "The number of data rows to intersect with each projection row.");
+DEFINE_int64(num_projections, 20, "The number of projection rows (k).");
+DEFINE_int64(dimension, 47236, "The number of features. Defaults to RCV1's.");
+DEFINE_int64(repetitions, 5, "Timed runs of each kernel, after one warm-up run. The fastest run is reported.");
+
+namespace obamadb {
+
+  /**
+   * Microbenchmark of the sparse-sparse dot product kernels on the shapes seen by a random
+   * projection of RCV1. Data rows have a log-normal number of nonzeros with a median around RCV1's
+   * (roughly 75, with a long tail), and projection rows have roughly sqrt(dimension) nonzeros.
+   */
+  struct Workload {
+    Workload(int num_rows, int num_projections, int dimension) {
+      QuickRandom qr;
+      std::uint32_t max_uint32 = 0;
+      max_uint32 -= 1;
+      for (int i = 0; i < num_rows; i++) {
+        // Box-Muller for a normal variate, exponentiated for a log-normal row length.
+        double const u1 = (qr.nextInt32() + 1.0) / (max_uint32 + 2.0);
+        double const u2 = (qr.nextInt32() + 1.0) / (max_uint32 + 2.0);
+        double const normal = std::sqrt(-2.0 * std::log(u1)) * std::cos(2 * M_PI * u2);
+        int const length = std::max(1, std::min(dimension, (int) std::exp(std::log(75.0) + 0.8 * normal)));
+        rows.push_back(std::unique_ptr<svector<num_t>>(new svector<num_t>()));
+        fill(&qr, dimension, length, rows.back().get());
+      }
+      int const projection_length = std::sqrt(dimension);
+      for (int i = 0; i < num_projections; i++) {
+        projections.push_back(std::unique_ptr<svector<signed char>>(new svector<signed char>()));
+        fill(&qr, dimension, projection_length, projections.back().get());
+      }
+    }
+
+    template<class T>
+    static void fill(QuickRandom *qr, int dimension, int length, svector<T> *vec) {
+      // Choose length sorted unique indices by striding through random windows.
+      double const window = static_cast<double>(dimension) / length;
+      for (int i = 0; i < length; i++) {
+        int const index = i * window + (qr->nextInt32() % std::max(1, (int) window));
+        vec->push_back(std::min(index, dimension - 1), static_cast<T>(qr->nextInt32() % 2 == 0 ? 1 : -1));
+      }
+    }
+
+    std::vector<std::unique_ptr<svector<num_t>>> rows;
+    std::vector<std::unique_ptr<svector<signed char>>> projections;
+  };
+
+  typedef num_t (*SparseDotFn)(const svector<num_t> &, const svector<signed char> &);
+
+  struct KernelTiming {
+    double ns_per_pair;
+    double checksum;
+  };
+
+  /**
+   * Times a kernel over every pair of the workload, after one untimed pass to warm the caches.
+   * @return The best of FLAGS_repetitions timed passes.
+   */
+  KernelTiming timeKernel(Workload const & workload, SparseDotFn fn) {
+    KernelTiming timing;
+    double best_ms = 0;
+    for (int rep = -1; rep < FLAGS_repetitions; rep++) {
+      timing.checksum = 0;
+      auto time_start = std::chrono::steady_clock::now();
+      for (auto const & row : workload.rows) {
+        for (auto const & projection : workload.projections) {
+          timing.checksum += fn(*row, *projection);
+        }
+      }
+      auto time_end = std::chrono::steady_clock::now();
+      std::chrono::duration<double, std::milli> time_ms = time_end - time_start;
+      if (rep < 0) {
+        continue;  // The warm-up pass.
+      }
+      if (rep == 0 || time_ms.count() < best_ms) {
+        best_ms = time_ms.count();
+      }
+    }
+    double const pairs = static_cast<double>(workload.rows.size()) * workload.projections.size();
+    timing.ns_per_pair = best_ms * 1e6 / pairs;
+    return timing;
+  }
+
+  void printKernel(const char *name, KernelTiming const & timing, double baseline_ns) {
+    printf("%s,%.2f,%.2f,%.4f\n",
+           name,
+           timing.ns_per_pair,
+           baseline_ns / timing.ns_per_pair,
+           timing.checksum);
+  }
+
+  void runKernel(Workload const & workload, const char *name, SparseDotFn fn, double baseline_ns) {
+    printKernel(name, timeKernel(workload, fn), baseline_ns);
+  }
+
+  int main() {
+    Workload workload(FLAGS_num_rows, FLAGS_num_projections, FLAGS_dimension);
+    printf("dispatch block kernel: %s\n", ml::sparseDotBlockKernelName());
+    printf("kernel,ns_per_pair,speedup_vs_scalar,checksum\n");
+
+    // The scalar merge is timed like every other kernel, and the others report their speedup
+    // against it.
+    KernelTiming const scalar = timeKernel(workload, ml::sparseDotScalar);
+    printKernel("scalar", scalar, scalar.ns_per_pair);
+    runKernel(workload, "galloping", ml::sparseDotGalloping, scalar.ns_per_pair);
+    if (ml::cpuSupportsAVX2()) {
+      runKernel(workload, "avx2", ml::sparseDotAVX2, scalar.ns_per_pair);
+    }
+    if (ml::cpuSupportsAVX512()) {
+      runKernel(workload, "avx512", ml::sparseDotAVX512, scalar.ns_per_pair);
+    }
+    runKernel(workload, "dispatch", ml::sparseDot, scalar.ns_per_pair);
+    return 0;
+  }
+}
+
+int main(int argc, char **argv) {
+  ::gflags::ParseCommandLineFlags(&argc, &argv, true);
+  return obamadb::main();
+}
@@ -0,0 +1,134 @@
+#include "storage/ThreadPool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gflags/gflags.h>
+
+DEFINE_bool(verbose, false, "Print out extra diagnostic information.");
+DEFINE_string(core_affinities, "-1", "A comma separated list of cores to have threads bind to.");
+DEFINE_int64(max_threads, 256, "Thread counts are doubled from 1 up to this.");
+DEFINE_int64(num_cycles, 2000, "The number of cycles timed for each configuration.");
+DEFINE_int64(spin_budget, obamadb::threading::kDefaultBarrierSpinBudget,
+             "The spin budget of the spinning barrier.");
+DEFINE_string(placement, "one-per-physical-core", "The order in which threads are bound to cpus.");
+
+namespace obamadb {
+
+  /**
+   * Microbenchmark of ThreadPool::cycle() round-trip latency with empty tasks, i.e. the cost of
+   * handing a job to the workers and waiting for all of them to finish. ThreadPool's original
+   * worker loop over two mutex and condition variable barriers is kept here as the baseline.
+   */
+  class MutexBarrier {
+  public:
+    MutexBarrier(int totalWaiters)
+      : mutex_(),
+        cond_(),
+        count_(totalWaiters),
+        epoch_(0),
+        threshold_(totalWaiters) {}
+
+    void wait() {
+      int epoch_stackvar = epoch_;
+      std::unique_lock<std::mutex> lock{mutex_};
+      if (!--count_) {
+        epoch_++;
+        count_ = threshold_;
+        cond_.notify_all();
+      } else {
+        cond_.wait(lock, [this, epoch_stackvar] { return epoch_stackvar != epoch_; });
+      }
+    }
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    int count_;
+    int epoch_;
+    int const threshold_;
+  };
+
+  /**
+   * Runs ThreadPool's original worker loop over the baseline barrier.
+   * @return Mean microseconds per cycle.
+   */
+  double timeMutexBarrierCycles(int num_threads, int num_cycles) {
+    MutexBarrier b1(num_threads + 1);
+    MutexBarrier b2(num_threads + 1);
+    bool stop = false;
+    std::vector<std::unique_ptr<std::thread>> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.push_back(std::unique_ptr<std::thread>(new std::thread([&] {
+        threading::setCoreAffinity(threading::getCoreAffinity());
+        while (true) {
+          b1.wait();
+          if (stop) {
+            break;
+          }
+          b2.wait();
+        }
+      })));
+    }
+
+    // One untimed cycle to let every thread start.
+    b1.wait();
+    b2.wait();
+    auto time_start = std::chrono::steady_clock::now();
+    for (int c = 0; c < num_cycles; c++) {
+      b1.wait();
+      b2.wait();
+    }
+    auto time_end = std::chrono::steady_clock::now();
+
+    stop = true;
+    b1.wait();
+    for (auto & thread : threads) {
+      thread->join();
+    }
+    std::chrono::duration<double, std::micro> time_us = time_end - time_start;
+    return time_us.count() / num_cycles;
+  }
+
+  /**
+   * @return Mean microseconds per ThreadPool::cycle().
+   */
+  double timeThreadPoolCycles(int num_threads, int num_cycles, int spin_budget) {
+    threading::setDefaultBarrierSpinBudget(spin_budget);
+    ThreadPool tp([](int, void*) {}, nullptr, num_threads);
+    tp.begin();
+    tp.cycle();
+    auto time_start = std::chrono::steady_clock::now();
+    for (int c = 0; c < num_cycles; c++) {
+      tp.cycle();
+    }
+    auto time_end = std::chrono::steady_clock::now();
+    tp.stop();
+    std::chrono::duration<double, std::micro> time_us = time_end - time_start;
+    return time_us.count() / num_cycles;
+  }
+
+} // namespace obamadb
+
+int main(int argc, char** argv) {
+  ::gflags::ParseCommandLineFlags(&argc, &argv, true);
+  obamadb::threading::PlacementPolicy placement;
+  CHECK(obamadb::threading::ParsePlacementPolicy(FLAGS_placement, &placement)) << "invalid placement";
+  obamadb::threading::setPlacementPolicy(placement);
+  printf("cores: %d, cycles: %ld, spin budget: %ld, placement: %s\n",
+         obamadb::threading::numCores(), (long) FLAGS_num_cycles, (long) FLAGS_spin_budget,
+         FLAGS_placement.c_str());
+  printf("threads, mutex_us, futex_us, spin_futex_us\n");
+  for (int threads = 1; threads <= FLAGS_max_threads; threads *= 2) {
+    double const mutex_us = obamadb::timeMutexBarrierCycles(threads, FLAGS_num_cycles);
+    double const futex_us = obamadb::timeThreadPoolCycles(threads, FLAGS_num_cycles, 0);
+    double const spin_us = obamadb::timeThreadPoolCycles(threads, FLAGS_num_cycles, FLAGS_spin_budget);
+    printf("%d, %.2f, %.2f, %.2f\n", threads, mutex_us, futex_us, spin_us);
+  }
+  return 0;
+}
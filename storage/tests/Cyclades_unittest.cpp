@@ -0,0 +1,169 @@
+#include "gtest/gtest.h"
+#include "storage/Cyclades.h"
+#include "storage/exvector.h"
+#include "storage/MatrixStats.h"
+#include "storage/SparseDataBlock.h"
+#include "storage/ThreadPool.h"
+#include "storage/Utils.h"
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <vector>
+
+DEFINE_string(core_affinities, "-1", "");
+
+namespace obamadb {
+
+  namespace {
+    /**
+     * Rows of 1 to 4 random features. Row i of a block holds its global row number as its value.
+     */
+    std::vector<SparseDataBlock<num_t>*> getBlocks(int num_blocks, int rows_per_block, int num_columns) {
+      std::vector<SparseDataBlock<num_t>*> blocks;
+      QuickRandom qr;
+      for (int b = 0; b < num_blocks; b++) {
+        SparseDataBlock<num_t> *block = new SparseDataBlock<num_t>(rows_per_block * 64);
+        for (int i = 0; i < rows_per_block; i++) {
+          svector<num_t> row;
+          int const length = 1 + qr.nextInt32() % 4;
+          int column = qr.nextInt32() % (num_columns / 4);
+          for (int j = 0; j < length; j++) {
+            row.push_back(column, b * rows_per_block + i);
+            column += 1 + qr.nextInt32() % (num_columns / 4 - 1);
+          }
+          EXPECT_TRUE(block->appendRow(row)) << "test block too small";
+        }
+        blocks.push_back(block);
+      }
+      return blocks;
+    }
+
+    /**
+     * What each worker was given, by batch.
+     */
+    struct ScheduleLog {
+      ScheduleLog(CycladesScheduler *scheduler)
+        : scheduler(scheduler),
+          rows(scheduler->getNumWorkers()),
+          features(scheduler->getNumWorkers()) {}
+
+      CycladesScheduler *scheduler;
+      // Per worker, per batch.
+      std::vector<std::vector<std::vector<int>>> rows;
+      std::vector<std::vector<std::set<int>>> features;
+    };
+
+    void logEpoch(int worker, void *state) {
+      ScheduleLog *log = reinterpret_cast<ScheduleLog*>(state);
+      svector<num_t> row(0, nullptr);
+      while (log->scheduler->nextBatch(worker)) {
+        log->rows[worker].emplace_back();
+        log->features[worker].emplace_back();
+        for (BatchRow const & batch_row : log->scheduler->getRows(worker)) {
+          log->scheduler->getRow(batch_row, &row);
+          log->rows[worker].back().push_back(static_cast<int>(row.values_[0]));
+          log->features[worker].back().insert(row.index_, row.index_ + row.num_elements_);
+        }
+      }
+    }
+  }
+
+  TEST(CycladesTest, TestBatchRowsFromDegrees) {
+    // 100 features, each in 10 of 1000 rows: a row conflicts with 9 other rows per feature.
+    MatrixStats stats(1000, 100);
+    std::fill(stats.degrees.begin(), stats.degrees.end(), 10);
+    EXPECT_NEAR(9.0 * 99 / 999, CycladesExpectedConflicts(stats, 100), 1e-9);
+    EXPECT_DOUBLE_EQ(0, CycladesExpectedConflicts(stats, 1));
+
+    int const batch_rows = CycladesBatchRows(stats, 0.9);
+    EXPECT_EQ(100, batch_rows);
+    EXPECT_GE(0.9, CycladesExpectedConflicts(stats, batch_rows));
+    EXPECT_LT(0.9, CycladesExpectedConflicts(stats, batch_rows + 1));
+
+    // Without shared features, a batch is the whole matrix.
+    std::fill(stats.degrees.begin(), stats.degrees.end(), 1);
+    EXPECT_EQ(1000, CycladesBatchRows(stats, 0.9));
+  }
+
+  TEST(CycladesTest, TestWorkersNeverShareFeatures) {
+    int const num_columns = 400;
+    int const num_workers = 4;
+    std::vector<SparseDataBlock<num_t>*> blocks = getBlocks(5, 100, num_columns);
+    CycladesScheduler scheduler(num_workers, blocks, num_columns, 60, 11);
+    EXPECT_EQ(64, scheduler.getBatchRows());
+    EXPECT_EQ(9, scheduler.getNumBatches());
+
+    std::vector<int> previous_order;
+    for (int epoch = 0; epoch < 3; epoch++) {
+      ScheduleLog log(&scheduler);
+      ThreadPool tp(logEpoch, &log, num_workers);
+      tp.begin();
+      tp.cycle();
+      tp.stop();
+
+      std::vector<int> order;
+      int busy_batches = 0;
+      for (int b = 0; b < scheduler.getNumBatches(); b++) {
+        std::set<int> batch_features;
+        int busy_workers = 0;
+        for (int w = 0; w < num_workers; w++) {
+          ASSERT_EQ(scheduler.getNumBatches(), log.rows[w].size());
+          order.insert(order.end(), log.rows[w][b].begin(), log.rows[w][b].end());
+          busy_workers += !log.rows[w][b].empty();
+          for (int feature : log.features[w][b]) {
+            EXPECT_TRUE(batch_features.insert(feature).second)
+              << "feature " << feature << " given to two workers in batch " << b;
+          }
+        }
+        busy_batches += busy_workers > 1;
+      }
+      // The batches are sparse enough to break into components for several workers.
+      EXPECT_LT(scheduler.getNumBatches() / 2, busy_batches);
+
+      EXPECT_NE(previous_order, order) << "epoch " << epoch << " repeated the last order";
+      previous_order = order;
+      std::sort(order.begin(), order.end());
+      ASSERT_EQ(500, order.size());
+      for (int i = 0; i < order.size(); i++) {
+        EXPECT_EQ(i, order[i]);
+      }
+    }
+
+    for (auto block : blocks) {
+      delete block;
+    }
+  }
+
+  TEST(CycladesTest, TestConnectedRowsStayTogether) {
+    // Row i has features i and i + 1, so every batch is a single component.
+    int const num_rows = 200;
+    SparseDataBlock<num_t> block(num_rows * 64);
+    for (int i = 0; i < num_rows; i++) {
+      svector<num_t> row;
+      row.push_back(i, i);
+      row.push_back(i + 1, i);
+      ASSERT_TRUE(block.appendRow(row));
+    }
+    std::vector<SparseDataBlock<num_t>*> blocks = {&block};
+    CycladesScheduler scheduler(3, blocks, num_rows + 1, num_rows, 5);
+    ASSERT_EQ(1, scheduler.getNumBatches());
+
+    ScheduleLog log(&scheduler);
+    ThreadPool tp(logEpoch, &log, 3);
+    tp.begin();
+    tp.cycle();
+    tp.cycle();
+    tp.stop();
+    int busy_workers = 0;
+    for (int w = 0; w < 3; w++) {
+      ASSERT_EQ(2, log.rows[w].size());
+      for (int epoch = 0; epoch < 2; epoch++) {
+        EXPECT_TRUE(log.rows[w][epoch].empty() || log.rows[w][epoch].size() == num_rows);
+        busy_workers += !log.rows[w][epoch].empty();
+      }
+    }
+    EXPECT_EQ(2, busy_workers);
+  }
+
+} // namespace obamadb
@@ -0,0 +1,210 @@
+#include "gtest/gtest.h"
+#include "storage/DataView.h"
+#include "storage/DenseDataBlock.h"
+#include "storage/exvector.h"
+#include "storage/SparseDataBlock.h"
+#include "storage/Utils.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+DEFINE_string(core_affinities, "-1", "");
+
+namespace obamadb {
+
+  namespace {
+    /**
+     * Blocks whose rows each hold a single element, indexed by the row's global number.
+     */
+    std::vector<std::unique_ptr<SparseDataBlock<num_t>>> getNumberedBlocks(int num_blocks, int rows_per_block) {
+      std::vector<std::unique_ptr<SparseDataBlock<num_t>>> blocks;
+      for (int b = 0; b < num_blocks; b++) {
+        blocks.push_back(std::unique_ptr<SparseDataBlock<num_t>>(new SparseDataBlock<num_t>(rows_per_block * 64)));
+        for (int i = 0; i < rows_per_block; i++) {
+          svector<num_t> row;
+          row.push_back(b * rows_per_block + i, 1);
+          EXPECT_TRUE(blocks.back()->appendRow(row)) << "test block too small";
+        }
+      }
+      return blocks;
+    }
+
+    std::vector<int> readEpoch(DataView *view) {
+      view->reset();
+      std::vector<int> rows;
+      svector<num_t> row(0, nullptr);
+      while (view->getNext(&row)) {
+        rows.push_back(row.index_[0]);
+      }
+      return rows;
+    }
+  }
+
+  TEST(DataViewTest, TestUnshuffledOrderIsStorageOrder) {
+    auto blocks = getNumberedBlocks(3, 50);
+    DataView view;
+    for (auto const & block : blocks) {
+      view.appendBlock(block.get());
+    }
+    for (int epoch = 0; epoch < 2; epoch++) {
+      std::vector<int> const rows = readEpoch(&view);
+      ASSERT_EQ(150, rows.size());
+      for (int i = 0; i < rows.size(); i++) {
+        EXPECT_EQ(i, rows[i]);
+      }
+    }
+  }
+
+  TEST(DataViewTest, TestShuffleVisitsEveryRowOnce) {
+    auto blocks = getNumberedBlocks(5, 200);
+    DataView view;
+    for (auto const & block : blocks) {
+      view.appendBlock(block.get());
+    }
+    view.setShuffle(7);
+    EXPECT_TRUE(view.isShuffled());
+
+    std::vector<int> previous;
+    for (int epoch = 0; epoch < 3; epoch++) {
+      std::vector<int> rows = readEpoch(&view);
+      EXPECT_NE(previous, rows) << "epoch " << epoch << " repeated the last order";
+      previous = rows;
+
+      // Reads are mostly sequential: most steps go to the next row.
+      int sequential = 0;
+      for (int i = 1; i < rows.size(); i++) {
+        sequential += rows[i] == rows[i - 1] + 1;
+      }
+      EXPECT_LT(0.9 * rows.size(), sequential);
+
+      std::sort(rows.begin(), rows.end());
+      ASSERT_EQ(1000, rows.size());
+      for (int i = 0; i < rows.size(); i++) {
+        EXPECT_EQ(i, rows[i]);
+      }
+    }
+  }
+
+  TEST(DataViewTest, TestShuffleIsSeeded) {
+    auto blocks = getNumberedBlocks(4, 100);
+    DataView a;
+    DataView b;
+    DataView c;
+    for (auto const & block : blocks) {
+      a.appendBlock(block.get());
+      b.appendBlock(block.get());
+      c.appendBlock(block.get());
+    }
+    a.setShuffle(1);
+    b.setShuffle(1);
+    c.setShuffle(2);
+    for (int epoch = 0; epoch < 2; epoch++) {
+      std::vector<int> const rows = readEpoch(&a);
+      EXPECT_EQ(rows, readEpoch(&b));
+      EXPECT_NE(rows, readEpoch(&c));
+    }
+  }
+
+  TEST(DataViewTest, TestShuffleKeepsBlockRangeAndSlices) {
+    auto blocks = getNumberedBlocks(3, 100);
+    DataView view;
+    view.appendBlock(blocks[0].get(), 10, 90);
+    view.appendBlock(blocks[1].get());
+    view.appendBlock(blocks[2].get(), 0, 5);
+    view.setShuffle(3);
+
+    view.setBlockRange(0, 1);
+    svector<num_t> row(0, nullptr);
+    std::vector<int> rows;
+    while (view.getNext(&row)) {
+      rows.push_back(row.index_[0]);
+    }
+    std::sort(rows.begin(), rows.end());
+    ASSERT_EQ(80, rows.size());
+    EXPECT_EQ(10, rows.front());
+    EXPECT_EQ(89, rows.back());
+  }
+
+  TEST(DataViewTest, TestPeekReadsAheadAcrossRuns) {
+    auto blocks = getNumberedBlocks(2, 10);
+    DataView view;
+    view.appendBlock(blocks[0].get(), 0, 10);
+    view.appendBlock(blocks[1].get(), 4, 10);
+    view.reset();
+
+    svector<num_t> row(0, nullptr);
+    svector<num_t> ahead(0, nullptr);
+    ASSERT_TRUE(view.getNext(&row));
+    EXPECT_EQ(0, row.index_[0]);
+    ASSERT_TRUE(view.peek(1, &ahead));
+    EXPECT_EQ(1, ahead.index_[0]);
+    // Past the first block, into the next run.
+    ASSERT_TRUE(view.peek(12, &ahead));
+    EXPECT_EQ(16, ahead.index_[0]);
+    EXPECT_FALSE(view.peek(16, &ahead));
+
+    // Peeking does not move the iteration.
+    ASSERT_TRUE(view.getNext(&row));
+    EXPECT_EQ(1, row.index_[0]);
+  }
+
+  TEST(DataViewTest, TestSparseBatchesMatchRows) {
+    auto blocks = getNumberedBlocks(3, 100);
+    DataView view;
+    view.appendBlock(blocks[0].get(), 0, 70);
+    view.appendBlock(blocks[1].get());
+    view.appendBlock(blocks[2].get(), 90, 100);
+    view.reset();
+
+    std::vector<int> rows;
+    std::vector<int> sizes;
+    SparseRowBatch batch;
+    while (view.getNextBatch(SparseRowBatch::kMaxRows, &batch)) {
+      sizes.push_back(batch.size);
+      for (int r = 0; r < batch.size; r++) {
+        ASSERT_EQ(1, batch.length(r));
+        EXPECT_EQ(1, batch.row(r)[0]);
+        rows.push_back(batch.index(r)[0]);
+      }
+    }
+    // Batches do not cross runs.
+    EXPECT_EQ(std::vector<int>({64, 6, 64, 36, 10}), sizes);
+    ASSERT_EQ(180, rows.size());
+    for (int i = 0; i < 70; i++) {
+      EXPECT_EQ(i, rows[i]);
+    }
+    EXPECT_EQ(290, rows[170]);
+
+    // Batches and single rows interleave.
+    view.reset();
+    ASSERT_TRUE(view.getNextBatch(5, &batch));
+    EXPECT_EQ(5, batch.size);
+    svector<num_t> row(0, nullptr);
+    ASSERT_TRUE(view.getNext(&row));
+    EXPECT_EQ(5, row.index_[0]);
+  }
+
+  TEST(DataViewTest, TestDenseBatchesMatchRows) {
+    DenseDataBlock<num_t> block(100, 7);
+    block.randomize();
+    DataView view;
+    view.appendBlock(&block, 10, 100);
+    view.reset();
+
+    int next_row = 10;
+    DenseRowBatch batch;
+    dvector<num_t> expected(0, nullptr);
+    while (view.getNextBatch(DenseRowBatch::kMaxRows, &batch)) {
+      for (int r = 0; r < batch.size; r++) {
+        block.getRowVectorFast(next_row++, &expected);
+        EXPECT_EQ(nullptr, batch.index(r));
+        EXPECT_EQ(7, batch.length(r));
+        EXPECT_EQ(expected.values_, batch.row(r));
+        EXPECT_EQ(*expected.class_, batch.label(r));
+      }
+    }
+    EXPECT_EQ(100, next_row);
+  }
+
+} // namespace obamadb
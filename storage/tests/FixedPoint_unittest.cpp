@@ -0,0 +1,136 @@
+#include "gtest/gtest.h"
+#include "storage/FixedPoint.h"
+#include "storage/SparseDot.h"
+#include "storage/Utils.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+DEFINE_string(core_affinities, "-1", "");
+
+namespace obamadb {
+
+  namespace {
+    /**
+     * Checks every kernel against a float dot product with the dequantized weights, for rows of
+     * every length up to the dimension, dense and with the sparse row's last columns.
+     */
+    template<class T>
+    void expectKernelsAgree(int dimension) {
+      QuickRandom qr;
+      fvector theta(dimension);
+      for (int i = 0; i < dimension; i++) {
+        theta[i] = qr.nextFloat() * 2 - 1;
+      }
+      FixedPointModel<T> model(theta, 1);
+      fvector dequantized(dimension);
+      model.copyWeights(&dequantized);
+
+      std::vector<num_t> values(dimension);
+      for (num_t & value : values) {
+        value = qr.nextFloat() - 0.5f;
+      }
+      std::vector<int> index(dimension);
+      for (int length = 0; length <= dimension; length++) {
+        for (int i = 0; i < length; i++) {
+          index[i] = dimension - length + i;
+        }
+        num_t dense = 0;
+        num_t sparse = 0;
+        for (int i = 0; i < length; i++) {
+          dense += values[i] * dequantized[i];
+          sparse += values[i] * dequantized[index[i]];
+        }
+        num_t const resolution = model.getResolution();
+        T const *weights = model.getValues();
+        EXPECT_NEAR(dense, resolution * ml::fixedPointDot(nullptr, values.data(), length, weights), 1e-4);
+        EXPECT_NEAR(sparse, resolution * ml::fixedPointDot(index.data(), values.data(), length, weights), 1e-4);
+        EXPECT_NEAR(sparse, resolution * ml::fixedPointDotScalar(index.data(), values.data(), length, weights),
+                    1e-4);
+        if (ml::cpuSupportsAVX2()) {
+          EXPECT_NEAR(dense, resolution * ml::fixedPointDotAVX2(nullptr, values.data(), length, weights), 1e-4);
+          EXPECT_NEAR(sparse, resolution * ml::fixedPointDotAVX2(index.data(), values.data(), length, weights),
+                      1e-4);
+        }
+      }
+    }
+  }
+
+  TEST(FixedPointTest, TestParseModelPrecision) {
+    for (ModelPrecision precision : {ModelPrecision::kFloat32,
+                                     ModelPrecision::kInt16,
+                                     ModelPrecision::kInt8}) {
+      ModelPrecision parsed;
+      ASSERT_TRUE(ParseModelPrecision(ModelPrecisionName(precision), &parsed));
+      EXPECT_EQ(precision, parsed);
+    }
+    ModelPrecision parsed;
+    EXPECT_FALSE(ParseModelPrecision("int4", &parsed));
+  }
+
+  TEST(FixedPointTest, TestStochasticRoundingIsUnbiased) {
+    RoundingRandom rng(7);
+    for (num_t x : {0.25f, -0.25f, 2.9f, -3.7f, 0.001f}) {
+      int const floor = std::floor(x);
+      double sum = 0;
+      int const draws = 100000;
+      for (int i = 0; i < draws; i++) {
+        int const rounded = stochasticRound(x, &rng);
+        ASSERT_TRUE(rounded == floor || rounded == floor + 1) << x << " rounded to " << rounded;
+        sum += rounded;
+      }
+      EXPECT_NEAR(x, sum / draws, 0.01) << x;
+    }
+    EXPECT_EQ(-2, stochasticRound(-2, &rng));
+    EXPECT_EQ(5, stochasticRound(5, &rng));
+  }
+
+  TEST(FixedPointTest, TestUpdatesSaturate) {
+    RoundingRandom rng(3);
+    std::int8_t weight = 120;
+    addStochastic(&weight, 50, &rng);
+    EXPECT_EQ(127, weight);
+    addStochastic(&weight, -1e9, &rng);
+    EXPECT_EQ(-127, weight);
+
+    // Many updates far below the resolution add up to their sum.
+    std::int16_t small = 0;
+    for (int i = 0; i < 10000; i++) {
+      addStochastic(&small, 0.01f, &rng);
+    }
+    EXPECT_NEAR(100, small, 30);
+  }
+
+  TEST(FixedPointTest, TestModelRoundsToNearest) {
+    fvector theta(4);
+    theta[0] = 0.5;
+    theta[1] = -0.26;
+    theta[2] = 3;
+    theta[3] = -5;
+    FixedPointModel<std::int8_t> model(theta, 2);
+    EXPECT_FLOAT_EQ(2.0f / 127, model.getResolution());
+    EXPECT_EQ(32, model.getValues()[0]);
+    EXPECT_EQ(-17, model.getValues()[1]);
+    // Out of range weights saturate.
+    EXPECT_EQ(127, model.getValues()[2]);
+    EXPECT_EQ(-127, model.getValues()[3]);
+    for (int i = 0; i < kFixedPointPadding; i++) {
+      EXPECT_EQ(0, model.getValues()[4 + i]);
+    }
+
+    fvector copy(4);
+    model.copyWeights(&copy);
+    EXPECT_NEAR(0.5, copy[0], model.getResolution() / 2);
+    EXPECT_NEAR(-0.26, copy[1], model.getResolution() / 2);
+    EXPECT_FLOAT_EQ(2, copy[2]);
+    EXPECT_FLOAT_EQ(-2, copy[3]);
+    EXPECT_NE(model.nextSeed(), model.nextSeed());
+  }
+
+  TEST(FixedPointTest, TestDotKernelsAgree) {
+    expectKernelsAgree<std::int8_t>(37);
+    expectKernelsAgree<std::int16_t>(37);
+  }
+
+} // namespace obamadb
@@ -2,12 +2,20 @@
 #include "storage/IO.h"
 #include "storage/exvector.h"
 #include "storage/DataBlock.h"
+#include "storage/Matrix.h"
+#include "storage/MatrixStats.h"
 #include "storage/SparseDataBlock.h"
+#include "storage/Utils.h"
 
+#include <cstdio>
+#include <fstream>
 #include <memory>
+#include <sys/time.h>
 
 #include "storage/tests/StorageTestHelpers.h"
 
+DEFINE_string(core_affinities, "-1", "");
+
 namespace obamadb {
 
   TEST(IOTest, TestLoadSparse) {
@@ -25,4 +33,35 @@ namespace obamadb {
     EXPECT_EQ(12.111, row.values_[row.numElements() - 1]);
     EXPECT_EQ(-1, *row.getClassification());
   }
+
+  TEST(IOTest, TestStatsCacheDetectsRewrittenFile) {
+    std::string const file_name = "IOTest_cached.dat";
+    std::string const stats_file = file_name + IO::kStatsFileSuffix;
+    auto write = [&file_name](num_t value, long mtime_sec) {
+      std::ofstream out(file_name);
+      out << "0  -2  1\n0  3  " << value << "\n1  -2  -1\n1  4  2\n";
+      out.close();
+      struct timeval times[2] = {{mtime_sec, 0}, {mtime_sec, 0}};
+      ASSERT_EQ(0, utimes(file_name.c_str(), times));
+    };
+
+    write(5, 1000000);
+    std::unique_ptr<Matrix> mat(IO::load(file_name, true));
+    EXPECT_FLOAT_EQ(5, mat->getStats().maxes[3]);
+    // Loaded again, the statistics come from the cache.
+    mat.reset(IO::load(file_name, true));
+    EXPECT_EQ(1000000000000000LL, mat->getStats().source_mtime_ns);
+    EXPECT_FLOAT_EQ(5, mat->getStats().maxes[3]);
+
+    // The same shape with another value must not reuse the cached statistics.
+    write(7, 2000000);
+    mat.reset(IO::load(file_name, true));
+    EXPECT_FLOAT_EQ(7, mat->getStats().maxes[3]);
+    std::unique_ptr<MatrixStats> cached(MatrixStats::Load(stats_file));
+    ASSERT_NE(nullptr, cached.get());
+    EXPECT_FLOAT_EQ(7, cached->maxes[3]);
+
+    std::remove(file_name.c_str());
+    std::remove(stats_file.c_str());
+  }
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "gtest/gtest.h"
+#include "storage/DenseDataBlock.h"
+#include "storage/exvector.h"
+#include "storage/Matrix.h"
+#include "storage/MatrixStats.h"
+#include "storage/SparseDataBlock.h"
+#include "storage/Utils.h"
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <memory>
+
+DEFINE_string(core_affinities, "-1", "");
+
+namespace obamadb {
+
+  namespace {
+    // Several small blocks, so that the blocks are spread over threads.
+    Matrix* getMultiBlockMatrix(int num_blocks, int rows_per_block, int num_columns) {
+      Matrix *mat = new Matrix();
+      QuickRandom qr;
+      num_t classification = 1;
+      for (int b = 0; b < num_blocks; b++) {
+        SparseDataBlock<num_t> *block = new SparseDataBlock<num_t>(rows_per_block * num_columns * 12);
+        for (int i = 0; i < rows_per_block; i++) {
+          svector<num_t> row;
+          row.setClassification(&classification);
+          for (int j = 0; j < num_columns; j++) {
+            if (qr.nextInt32() % 3 == 0) {
+              row.push_back(j, qr.nextFloat());
+            }
+          }
+          EXPECT_TRUE(block->appendRow(row)) << "test block too small";
+        }
+        mat->addBlock(block);
+      }
+      return mat;
+    }
+
+    // Compares against statistics computed by a serial scan.
+    void expectMatchesSerial(Matrix const & mat, MatrixStats const & stats) {
+      ASSERT_EQ(mat.numRows_, stats.numRows());
+      ASSERT_EQ(mat.numColumns_, stats.numColumns());
+      std::vector<int> degrees(mat.numColumns_, 0);
+      std::vector<double> sums(mat.numColumns_, 0);
+      std::vector<num_t> mins(mat.numColumns_, std::numeric_limits<num_t>::max());
+      std::vector<num_t> maxes(mat.numColumns_, std::numeric_limits<num_t>::lowest());
+      std::uint64_t nnz = 0;
+      int row_id = 0;
+      svector<num_t> row(0, nullptr);
+      for (auto block : mat.blocks_) {
+        for (int i = 0; i < block->getNumRows(); i++, row_id++) {
+          block->getRowVectorFast(i, &row);
+          double norm_sq = 0;
+          for (int e = 0; e < row.numElements(); e++) {
+            int const c = row.index_[e];
+            degrees[c]++;
+            sums[c] += row.values_[e];
+            mins[c] = std::min(mins[c], row.values_[e]);
+            maxes[c] = std::max(maxes[c], row.values_[e]);
+            norm_sq += row.values_[e] * row.values_[e];
+          }
+          nnz += row.numElements();
+          EXPECT_EQ(row.numElements(), stats.row_nnz[row_id]);
+          EXPECT_NEAR(std::sqrt(norm_sq), stats.row_norms[row_id], 1e-4);
+        }
+      }
+      EXPECT_EQ(nnz, stats.nnz);
+      for (int c = 0; c < mat.numColumns_; c++) {
+        EXPECT_EQ(degrees[c], stats.degrees[c]);
+        EXPECT_NEAR(sums[c], stats.sums[c], 1e-3);
+        EXPECT_EQ(degrees[c] == 0 ? 0 : mins[c], stats.mins[c]);
+        EXPECT_EQ(degrees[c] == 0 ? 0 : maxes[c], stats.maxes[c]);
+      }
+    }
+  }
+
+  TEST(MatrixStatsTest, TestMatchesSerialScan) {
+    std::unique_ptr<Matrix> mat(getMultiBlockMatrix(7, 50, 40));
+    EXPECT_FALSE(mat->hasStats());
+    mat->computeStats();
+    EXPECT_TRUE(mat->hasStats());
+    expectMatchesSerial(*mat, mat->getStats());
+    EXPECT_EQ(mat->getStats().nnz, mat->getNNZ());
+  }
+
+  TEST(MatrixStatsTest, TestInvalidatedByAppend) {
+    std::unique_ptr<Matrix> mat(getMultiBlockMatrix(2, 10, 20));
+    std::uint64_t const nnz_before = mat->getStats().nnz;
+    svector<num_t> row;
+    row.push_back(3, 2.0);
+    row.push_back(25, -1.0);
+    mat->addRow(row);
+    EXPECT_FALSE(mat->hasStats());
+    EXPECT_EQ(nnz_before + 2, mat->getNNZ());
+
+    MatrixStats const & stats = mat->getStats();
+    EXPECT_EQ(26, stats.numColumns());
+    EXPECT_EQ(2, stats.row_nnz.back());
+    EXPECT_FLOAT_EQ(std::sqrt(5.0), stats.row_norms.back());
+    EXPECT_EQ(-1.0, stats.mins[25]);
+    EXPECT_EQ(1, stats.degrees[25]);
+    expectMatchesSerial(*mat, stats);
+  }
+
+  TEST(MatrixStatsTest, TestDense) {
+    Matrix mat;
+    DenseDataBlock<num_t> *block = new DenseDataBlock<num_t>(3, 2);
+    dvector<num_t> row(2);
+    row.num_elements_ = 2;
+    num_t const values[3][2] = {{1, 0}, {-2, 0}, {3, 4}};
+    for (int i = 0; i < 3; i++) {
+      row.values_[0] = values[i][0];
+      row.values_[1] = values[i][1];
+      ASSERT_TRUE(block->appendRow(row));
+    }
+    block->finalize();
+    mat.addBlock(block);
+
+    MatrixStats const & stats = mat.getStats();
+    EXPECT_EQ(4u, stats.nnz);
+    EXPECT_EQ(3, stats.degrees[0]);
+    EXPECT_EQ(1, stats.degrees[1]);
+    EXPECT_DOUBLE_EQ(2, stats.sums[0]);
+    EXPECT_DOUBLE_EQ(14, stats.sums_sq[0]);
+    EXPECT_EQ(-2, stats.mins[0]);
+    EXPECT_EQ(3, stats.maxes[0]);
+    EXPECT_EQ(4, stats.mins[1]);
+    EXPECT_EQ(2, stats.row_nnz[2]);
+    EXPECT_FLOAT_EQ(5, stats.row_norms[2]);
+  }
+
+  TEST(MatrixStatsTest, TestSaveLoad) {
+    std::unique_ptr<Matrix> mat(getMultiBlockMatrix(3, 20, 30));
+    std::unique_ptr<MatrixStats> computed(
+      MatrixStats::Compute(mat->blocks_, mat->dense_blocks_, mat->numRows_, mat->numColumns_));
+    EXPECT_EQ(-1, computed->source_size);
+    EXPECT_EQ(-1, computed->source_mtime_ns);
+    computed->source_size = 1234;
+    computed->source_mtime_ns = 5678;
+    MatrixStats const & stats = *computed;
+    std::string const file_name = "MatrixStatsTest.stats";
+    ASSERT_TRUE(stats.save(file_name));
+
+    std::unique_ptr<MatrixStats> loaded(MatrixStats::Load(file_name));
+    ASSERT_NE(nullptr, loaded.get());
+    EXPECT_EQ(stats.nnz, loaded->nnz);
+    EXPECT_EQ(1234, loaded->source_size);
+    EXPECT_EQ(5678, loaded->source_mtime_ns);
+    EXPECT_EQ(stats.degrees, loaded->degrees);
+    EXPECT_EQ(stats.sums, loaded->sums);
+    EXPECT_EQ(stats.sums_sq, loaded->sums_sq);
+    EXPECT_EQ(stats.mins, loaded->mins);
+    EXPECT_EQ(stats.maxes, loaded->maxes);
+    EXPECT_EQ(stats.row_nnz, loaded->row_nnz);
+    EXPECT_EQ(stats.row_norms, loaded->row_norms);
+    mat->setStats(loaded.release());
+    EXPECT_TRUE(mat->hasStats());
+    std::remove(file_name.c_str());
+
+    EXPECT_EQ(nullptr, MatrixStats::Load("does_not_exist.stats"));
+  }
+
+} // namespace obamadb
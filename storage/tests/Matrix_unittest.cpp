@@ -3,6 +3,7 @@
 #include "storage/exvector.h"
 #include "storage/IO.h"
 #include "storage/Matrix.h"
+#include "storage/RandomProjection.h"
 #include "storage/SparseDataBlock.h"
 #include "storage/Utils.h"
 
@@ -68,6 +69,120 @@ namespace obamadb {
     IO::save("/tmp/matR.csv", *compressed_mat);
   }
 
+  TEST(TestMatrix, TestImplicitProjection) {
+    const int m = 47000, k = 20;
+    ImplicitProjection projection(m, k, 42);
+    int counts[3] = {0,0,0};
+    for (int i = 0; i < m; i++) {
+      for (int j = 0; j < k; j++) {
+        counts[1 + projection.get(i, j)]++;
+      }
+    }
+    const double tolerance = 0.1;
+    const double freq_ones = (1.0/(2.0*sqrt(m))) * m * k;
+    EXPECT_TRUE(counts[0] > freq_ones * (1.0 - tolerance) && counts[0] < freq_ones * (1.0 + tolerance));
+    EXPECT_TRUE(counts[2] > freq_ones * (1.0 - tolerance) && counts[2] < freq_ones * (1.0 + tolerance));
+
+    // The same seed describes the same matrix, another seed does not.
+    ImplicitProjection same(m, k, 42);
+    ImplicitProjection other(m, k, 43);
+    int differing = 0;
+    for (int i = 0; i < m; i++) {
+      for (int j = 0; j < k; j++) {
+        ASSERT_EQ(projection.get(i, j), same.get(i, j));
+        differing += projection.get(i, j) != other.get(i, j);
+      }
+    }
+    EXPECT_LT(0, differing);
+  }
+
+  TEST(TestMatrix, TestImplicitProjectionCompress) {
+    std::unique_ptr<Matrix> mat(getRandomSparseMatrix(1000, 1000, 0.9));
+    const int k = 100;
+    ImplicitProjection projection(mat->numColumns_, k, 7);
+    std::unique_ptr<Matrix> compressed(mat->randomProjectionsCompress(projection));
+    ASSERT_EQ(mat->numRows_, compressed->numRows_);
+    ASSERT_EQ(k, compressed->numColumns_);
+
+    // Compressing again with the same projection gives the same rows.
+    std::unique_ptr<Matrix> again(mat->randomProjectionsCompress(ImplicitProjection(mat->numColumns_, k, 7)));
+    ASSERT_EQ(compressed->blocks_.size(), again->blocks_.size());
+    svector<num_t> row_a(0, nullptr);
+    svector<num_t> row_b(0, nullptr);
+    for (int b = 0; b < compressed->blocks_.size(); b++) {
+      ASSERT_EQ(compressed->blocks_[b]->getNumRows(), again->blocks_[b]->getNumRows());
+      for (int r = 0; r < compressed->blocks_[b]->getNumRows(); r++) {
+        compressed->blocks_[b]->getRowVectorFast(r, &row_a);
+        again->blocks_[b]->getRowVectorFast(r, &row_b);
+        ASSERT_EQ(row_a.numElements(), row_b.numElements());
+        for (int e = 0; e < row_a.numElements(); e++) {
+          ASSERT_EQ(row_a.index_[e], row_b.index_[e]);
+          ASSERT_EQ(row_a.values_[e], row_b.values_[e]);
+        }
+      }
+    }
+  }
+
+  TEST(TestMatrix, TestDenseProjection) {
+    std::unique_ptr<Matrix> mat(getRandomSparseMatrix(1000, 1000, 0.9));
+    const int k = 50;
+    ImplicitProjection projection(mat->numColumns_, k, 11);
+    // 100 nonzeros per row with 1/sqrt(1000) sparsity in R: nearly every projected value is nonzero.
+    EXPECT_LT(0.9, mat->expectedProjectedDensity(projection));
+
+    std::unique_ptr<Matrix> sparse(mat->randomProjectionsCompress(projection, false));
+    std::unique_ptr<Matrix> dense(mat->randomProjectionsCompress(projection, true));
+    ASSERT_FALSE(sparse->isDense());
+    ASSERT_TRUE(dense->isDense());
+    ASSERT_EQ(sparse->numRows_, dense->numRows_);
+    ASSERT_EQ(k, dense->numColumns_);
+    EXPECT_EQ(sparse->getNNZ(), dense->getNNZ());
+    EXPECT_GT(sparse->sizeBytes(), dense->sizeBytes() * 0.9);
+
+    // The same values are stored, the dense rows just hold the zeros explicitly.
+    svector<num_t> srow(0, nullptr);
+    dvector<num_t> drow(0, nullptr);
+    int dense_block = 0, dense_row = 0;
+    for (auto block : sparse->blocks_) {
+      for (int i = 0; i < block->getNumRows(); i++) {
+        if (dense_row == dense->dense_blocks_[dense_block]->getNumRows()) {
+          dense_block++;
+          dense_row = 0;
+        }
+        block->getRowVectorFast(i, &srow);
+        dense->dense_blocks_[dense_block]->getRowVectorFast(dense_row++, &drow);
+        ASSERT_EQ(*srow.class_, *drow.class_);
+        for (int e = 0; e < srow.numElements(); e++) {
+          ASSERT_EQ(srow.values_[e], drow.values_[srow.index_[e]]);
+        }
+      }
+    }
+  }
+
+  TEST(TestMatrix, TestProjectionPreservesRowOrder) {
+    // Several blocks, so that the blocks do not divide evenly between threads.
+    std::unique_ptr<Matrix> mat(Matrix::GetRandomMatrix(7 * kStorageBlockSize, 1000, 0.99));
+    ASSERT_LT(1, mat->blocks_.size());
+    std::unique_ptr<Matrix> compressed(mat->randomProjectionsCompress(ImplicitProjection(mat->numColumns_, 10, 3)));
+    ASSERT_EQ(mat->numRows_, compressed->numRows_);
+
+    // Rows come out in input order, so their classifications line up.
+    svector<num_t> row_in(0, nullptr);
+    svector<num_t> row_out(0, nullptr);
+    int out_block = 0, out_row = 0;
+    for (auto block : mat->blocks_) {
+      for (int i = 0; i < block->getNumRows(); i++) {
+        if (out_row == compressed->blocks_[out_block]->getNumRows()) {
+          out_block++;
+          out_row = 0;
+        }
+        block->getRowVectorFast(i, &row_in);
+        compressed->blocks_[out_block]->getRowVectorFast(out_row++, &row_out);
+        ASSERT_EQ(*row_in.class_, *row_out.class_);
+      }
+    }
+  }
+
   // TODO: this method+test should be removed as it's obsolete.
   TEST(TestMatrix, TestRandomMatrix) {
     int m = 1000, n = 100;
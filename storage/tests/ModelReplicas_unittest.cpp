@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+#include "storage/ModelReplicas.h"
+#include "storage/Topology.h"
+#include "storage/Utils.h"
+
+#include <vector>
+
+DEFINE_string(core_affinities, "-1", "");
+
+namespace obamadb {
+
+  namespace {
+    using threading::CpuInfo;
+    using threading::CpuTopology;
+
+    // Two sockets of two cores with two hyperthreads each: cpus 0-3 are the first hyperthreads of
+    // cores (socket 0, core 0), (0, 1), (1, 0), (1, 1), and cpus 4-7 their siblings.
+    CpuTopology getTwoSocketTopology() {
+      std::vector<CpuInfo> cpus;
+      for (int cpu = 0; cpu < 8; cpu++) {
+        cpus.push_back(CpuInfo(cpu, (cpu / 2) % 2, cpu % 2, 0));
+      }
+      return CpuTopology(cpus);
+    }
+  }
+
+  TEST(ModelReplicasTest, TestParseReplicationPolicy) {
+    for (ReplicationPolicy policy : {ReplicationPolicy::kShared,
+                                     ReplicationPolicy::kPerSocket,
+                                     ReplicationPolicy::kPerCore}) {
+      ReplicationPolicy parsed;
+      ASSERT_TRUE(ParseReplicationPolicy(ReplicationPolicyName(policy), &parsed));
+      EXPECT_EQ(policy, parsed);
+    }
+    ReplicationPolicy parsed;
+    EXPECT_FALSE(ParseReplicationPolicy("numa", &parsed));
+  }
+
+  TEST(ModelReplicasTest, TestAssignReplicas) {
+    CpuTopology const topology = getTwoSocketTopology();
+    std::vector<int> const cores = {0, 2, 4, 1, 6, 3};
+    EXPECT_EQ(std::vector<int>({0, 0, 0, 0, 0, 0}),
+              AssignReplicas(ReplicationPolicy::kShared, cores, topology));
+    EXPECT_EQ(std::vector<int>({0, 1, 0, 0, 1, 1}),
+              AssignReplicas(ReplicationPolicy::kPerSocket, cores, topology));
+    // Hyperthreads of a core share its replica.
+    EXPECT_EQ(std::vector<int>({0, 1, 0, 2, 1, 3}),
+              AssignReplicas(ReplicationPolicy::kPerCore, cores, topology));
+    // Cpus outside the topology get replicas of their own.
+    EXPECT_EQ(std::vector<int>({0, 1, 2}),
+              AssignReplicas(ReplicationPolicy::kPerSocket, {0, 9, 10}, topology));
+  }
+
+  TEST(ModelReplicasTest, TestAverage) {
+    fvector model(3);
+    for (int i = 0; i < 3; i++) {
+      model[i] = i;
+    }
+    ModelReplicas replicas(model, {0, 1, 1, 2});
+    ASSERT_EQ(3, replicas.getNumReplicas());
+    EXPECT_EQ(replicas.getReplica(1), replicas.getReplica(2));
+    EXPECT_NE(replicas.getReplica(0), replicas.getReplica(1));
+    EXPECT_FLOAT_EQ(2, (*replicas.getReplica(3))[2]);
+
+    (*replicas.getReplica(0))[0] = 3;
+    (*replicas.getReplica(1))[0] = 6;
+    (*replicas.getReplica(3))[1] = 4;
+    fvector averaged(3);
+    replicas.average(&averaged);
+    EXPECT_EQ(1, replicas.getNumMerges());
+    for (int w = 0; w < 4; w++) {
+      EXPECT_FLOAT_EQ(3, (*replicas.getReplica(w))[0]);
+      EXPECT_FLOAT_EQ(2, (*replicas.getReplica(w))[1]);
+      EXPECT_FLOAT_EQ(2, (*replicas.getReplica(w))[2]);
+    }
+    EXPECT_FLOAT_EQ(3, averaged[0]);
+    EXPECT_FLOAT_EQ(2, averaged[1]);
+
+    replicas.getRowCounter(0)->store(5);
+    replicas.getRowCounter(3)->store(7);
+    EXPECT_EQ(12, replicas.getRows());
+  }
+
+} // namespace obamadb
@@ -0,0 +1,170 @@
+#include "gtest/gtest.h"
+#include "storage/DataView.h"
+#include "storage/exvector.h"
+#include "storage/Partitioner.h"
+#include "storage/SparseDataBlock.h"
+#include "storage/Utils.h"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+DEFINE_string(core_affinities, "-1", "");
+
+namespace obamadb {
+
+  namespace {
+    RowCosts getCosts(int num_blocks, int rows_per_block, std::int64_t cost) {
+      return RowCosts(num_blocks, std::vector<std::int64_t>(rows_per_block, cost));
+    }
+
+    /**
+     * Checks that every row is in exactly one part, and that each part's slices are in storage order.
+     */
+    void expectCovers(RowCosts const & costs, std::vector<std::vector<RowSlice>> const & parts) {
+      std::vector<std::vector<int>> seen(costs.size());
+      for (int b = 0; b < costs.size(); b++) {
+        seen[b].assign(costs[b].size(), 0);
+      }
+      for (auto const & part : parts) {
+        for (int i = 0; i < part.size(); i++) {
+          RowSlice const & slice = part[i];
+          ASSERT_LE(0, slice.begin);
+          ASSERT_LE(slice.begin, slice.end);
+          ASSERT_LE(slice.end, costs[slice.block].size());
+          if (i > 0) {
+            EXPECT_TRUE(part[i - 1].block < slice.block ||
+                        (part[i - 1].block == slice.block && part[i - 1].end <= slice.begin));
+          }
+          for (int r = slice.begin; r < slice.end; r++) {
+            seen[slice.block][r]++;
+          }
+        }
+      }
+      for (int b = 0; b < costs.size(); b++) {
+        for (int r = 0; r < costs[b].size(); r++) {
+          EXPECT_EQ(1, seen[b][r]) << "block " << b << " row " << r;
+        }
+      }
+    }
+
+    double imbalance(RowCosts const & costs, std::vector<std::vector<RowSlice>> const & parts) {
+      std::vector<std::int64_t> const part_costs = GetPartCosts(costs, parts);
+      double const mean = std::accumulate(part_costs.begin(), part_costs.end(), 0.0) / part_costs.size();
+      return *std::max_element(part_costs.begin(), part_costs.end()) / mean;
+    }
+  }
+
+  TEST(PartitionerTest, TestParsePartitionPolicy) {
+    for (PartitionPolicy policy : {PartitionPolicy::kRoundRobin,
+                                   PartitionPolicy::kLongestFirst,
+                                   PartitionPolicy::kContiguous}) {
+      PartitionPolicy parsed;
+      EXPECT_TRUE(ParsePartitionPolicy(PartitionPolicyName(policy), &parsed));
+      EXPECT_EQ(policy, parsed);
+    }
+    PartitionPolicy parsed;
+    EXPECT_FALSE(ParsePartitionPolicy("nonsense", &parsed));
+  }
+
+  TEST(PartitionerTest, TestSlightlyMoreBlocksThanParts) {
+    // Round robin gives one part two of the five blocks.
+    RowCosts const costs = getCosts(5, 100, 1);
+    auto const round_robin = PartitionRows(costs, 4, PartitionPolicy::kRoundRobin);
+    expectCovers(costs, round_robin);
+    EXPECT_DOUBLE_EQ(1.6, imbalance(costs, round_robin));
+
+    auto const contiguous = PartitionRows(costs, 4, PartitionPolicy::kContiguous);
+    expectCovers(costs, contiguous);
+    EXPECT_DOUBLE_EQ(1.0, imbalance(costs, contiguous));
+
+    auto const longest_first = PartitionRows(costs, 4, PartitionPolicy::kLongestFirst);
+    expectCovers(costs, longest_first);
+    EXPECT_GE(1.25, imbalance(costs, longest_first));
+  }
+
+  TEST(PartitionerTest, TestBalancesNonzerosNotRows) {
+    // The first block's rows are ten times longer than the others'.
+    RowCosts costs = getCosts(8, 50, 1);
+    costs[0].assign(50, 10);
+    for (PartitionPolicy policy : {PartitionPolicy::kLongestFirst, PartitionPolicy::kContiguous}) {
+      auto const parts = PartitionRows(costs, 3, policy);
+      expectCovers(costs, parts);
+      EXPECT_GE(1.25, imbalance(costs, parts)) << PartitionPolicyName(policy);
+    }
+    EXPECT_LT(1.5, imbalance(costs, PartitionRows(costs, 3, PartitionPolicy::kRoundRobin)));
+  }
+
+  TEST(PartitionerTest, TestSplitsASingleBlock) {
+    RowCosts costs(1);
+    QuickRandom qr;
+    for (int r = 0; r < 1000; r++) {
+      costs[0].push_back(1 + qr.nextInt32() % 20);
+    }
+    for (PartitionPolicy policy : {PartitionPolicy::kLongestFirst, PartitionPolicy::kContiguous}) {
+      auto const parts = PartitionRows(costs, 4, policy);
+      expectCovers(costs, parts);
+      for (auto const & part : parts) {
+        EXPECT_FALSE(part.empty());
+      }
+      EXPECT_GE(1.3, imbalance(costs, parts)) << PartitionPolicyName(policy);
+    }
+    // The contiguous parts are off by at most one row from an equal share.
+    EXPECT_GE(1.05, imbalance(costs, PartitionRows(costs, 4, PartitionPolicy::kContiguous)));
+  }
+
+  TEST(PartitionerTest, TestFewerRowsThanParts) {
+    RowCosts const costs = getCosts(1, 2, 3);
+    for (PartitionPolicy policy : {PartitionPolicy::kRoundRobin,
+                                   PartitionPolicy::kLongestFirst,
+                                   PartitionPolicy::kContiguous}) {
+      auto const parts = PartitionRows(costs, 4, policy);
+      EXPECT_EQ(4, parts.size());
+      expectCovers(costs, parts);
+    }
+  }
+
+  TEST(PartitionerTest, TestEvenSplit) {
+    for (int num_items : {0, 3, 10, 1001}) {
+      int expected_begin = 0;
+      for (int part = 0; part < 4; part++) {
+        std::pair<int, int> const range = EvenSplit(num_items, 4, part);
+        EXPECT_EQ(expected_begin, range.first);
+        EXPECT_LE(num_items / 4, range.second - range.first);
+        EXPECT_GE(num_items / 4 + 1, range.second - range.first);
+        expected_begin = range.second;
+      }
+      EXPECT_EQ(num_items, expected_begin);
+    }
+  }
+
+  TEST(PartitionerTest, TestDataViewIteratesSlices) {
+    SparseDataBlock<num_t> block(1000);
+    for (int i = 0; i < 10; i++) {
+      svector<num_t> row;
+      row.push_back(i, static_cast<num_t>(i));
+      ASSERT_TRUE(block.appendRow(row));
+    }
+
+    DataView view;
+    view.appendBlock(&block, 2, 5);
+    view.appendBlock(&block, 5, 5);
+    view.appendBlock(&block, 8, 10);
+    for (int pass = 0; pass < 2; pass++) {
+      view.reset();
+      std::vector<int> rows;
+      svector<num_t> row(0, nullptr);
+      while (view.getNext(&row)) {
+        rows.push_back(row.index_[0]);
+      }
+      EXPECT_EQ(std::vector<int>({2, 3, 4, 8, 9}), rows);
+    }
+
+    // Block ranges index the slices.
+    view.setBlockRange(2, 3);
+    svector<num_t> row(0, nullptr);
+    ASSERT_TRUE(view.getNext(&row));
+    EXPECT_EQ(8, row.index_[0]);
+  }
+
+} // namespace obamadb
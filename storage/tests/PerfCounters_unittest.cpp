@@ -0,0 +1,70 @@
+#include "gtest/gtest.h"
+#include "storage/PerfCounters.h"
+#include "storage/ThreadPool.h"
+
+#include <vector>
+
+DEFINE_string(core_affinities, "-1", "");
+
+namespace obamadb {
+
+  namespace {
+    // Work which the counters can see.
+    double spin(int iterations) {
+      volatile double sum = 0;
+      for (int i = 0; i < iterations; i++) {
+        sum = sum + i * 0.5;
+      }
+      return sum;
+    }
+  }
+
+  TEST(PerfCountersTest, TestUnavailableEventsAreSkipped) {
+    // Counters may be unavailable, e.g. in containers, so only check what could be opened.
+    PerfCounters counters;
+    counters.start();
+    spin(100000);
+    PerfSample const sample = counters.stop();
+    for (int e = 0; e < kNumPerfEvents; e++) {
+      PerfEvent const event = static_cast<PerfEvent>(e);
+      if (counters.isAvailable(event)) {
+        EXPECT_LE(0, sample.values[e]) << PerfCounters::EventName(event);
+      } else {
+        EXPECT_EQ(-1, sample.values[e]) << PerfCounters::EventName(event);
+      }
+    }
+    if (counters.isAvailable(kPerfInstructions)) {
+      EXPECT_LT(100000, sample.values[kPerfInstructions]);
+    }
+  }
+
+  TEST(PerfCountersTest, TestSampleAdd) {
+    PerfSample a;
+    PerfSample b;
+    a.values[kPerfCycles] = 10;
+    b.values[kPerfCycles] = 5;
+    a.values[kPerfInstructions] = 3;
+    a.add(b);
+    EXPECT_EQ(15, a.values[kPerfCycles]);
+    // Unavailable in one interval, so unavailable in the sum.
+    EXPECT_EQ(-1, a.values[kPerfInstructions]);
+  }
+
+  TEST(PerfCountersTest, TestThreadPoolCollectsSamples) {
+    ThreadPool tp([](int, void*) { spin(10000); }, nullptr, 3);
+    tp.begin();
+    tp.cycle();
+    EXPECT_TRUE(tp.getPerfSamples().empty());
+
+    threading::setPerfCountersEnabled(true);
+    tp.cycle();
+    threading::setPerfCountersEnabled(false);
+    ASSERT_EQ(3, tp.getPerfSamples().size());
+    PerfCounters probe;
+    for (PerfSample const & sample : tp.getPerfSamples()) {
+      EXPECT_EQ(probe.isAvailable(kPerfCycles), sample.values[kPerfCycles] >= 0);
+    }
+    tp.stop();
+  }
+
+}
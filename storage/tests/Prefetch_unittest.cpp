@@ -0,0 +1,42 @@
+#include "gtest/gtest.h"
+#include "storage/Prefetch.h"
+#include "storage/Utils.h"
+
+#include <vector>
+
+DEFINE_string(core_affinities, "-1", "");
+
+namespace obamadb {
+
+  TEST(PrefetchTest, TestTunerKeepsFastestDistance) {
+    PrefetchTuner tuner({0, 4, 16});
+    std::vector<double> const times = {3.0, 1.0, 2.0};
+    for (int i = 0; i < times.size(); i++) {
+      EXPECT_FALSE(tuner.isTuned());
+      EXPECT_EQ(std::vector<int>({0, 4, 16})[i], tuner.distance());
+      tuner.record(times[i]);
+    }
+    EXPECT_TRUE(tuner.isTuned());
+    EXPECT_EQ(4, tuner.distance());
+
+    // Later epochs do not change the choice.
+    tuner.record(0.1);
+    EXPECT_EQ(4, tuner.distance());
+  }
+
+  TEST(PrefetchTest, TestSmallModelsAreNotPrefetched) {
+    EXPECT_EQ(0, prefetchDistanceFor(8, 1 << 10));
+    EXPECT_EQ(8, prefetchDistanceFor(8, kPrefetchMinModelBytes));
+    EXPECT_EQ(0, prefetchDistanceFor(0, kPrefetchMinModelBytes * 2));
+  }
+
+  TEST(PrefetchTest, TestPrefetchRange) {
+    // Prefetching is only a hint, so any range, aligned or not, is safe.
+    std::vector<num_t> values(1000, 1);
+    prefetchForWrite(values.data() + 3, sizeof(num_t) * 500);
+    prefetchForWrite(values.data(), 0);
+    prefetchForWrite(values.data() + 999);
+    EXPECT_EQ(1, values[999]);
+  }
+
+} // namespace obamadb
@@ -0,0 +1,532 @@
+#include "gtest/gtest.h"
+#include "storage/DataView.h"
+#include "storage/exvector.h"
+#include "storage/SparseDataBlock.h"
+#include "storage/SVMTask.h"
+#include "storage/ThreadPool.h"
+#include "storage/Utils.h"
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+DEFINE_string(core_affinities, "-1", "");
+
+namespace obamadb {
+
+  namespace {
+    // Blocks of random rows labeled +1 or -1.
+    std::vector<SparseDataBlock<num_t>*> getLabeledBlocks(int num_blocks, int rows_per_block, int num_columns) {
+      std::vector<SparseDataBlock<num_t>*> blocks;
+      QuickRandom qr;
+      static num_t labels[2] = {-1, 1};
+      for (int b = 0; b < num_blocks; b++) {
+        SparseDataBlock<num_t> *block = new SparseDataBlock<num_t>(rows_per_block * num_columns * 12);
+        for (int i = 0; i < rows_per_block; i++) {
+          svector<num_t> row;
+          row.setClassification(&labels[qr.nextInt32() % 2 == 0]);
+          for (int j = 0; j < num_columns; j++) {
+            if (qr.nextInt32() % 4 == 0) {
+              row.push_back(j, qr.nextFloat());
+            }
+          }
+          EXPECT_TRUE(block->appendRow(row)) << "test block too small";
+        }
+        blocks.push_back(block);
+      }
+      return blocks;
+    }
+  }
+
+  TEST(SVMTaskTest, TestParallelMetricsMatchSerial) {
+    int const num_columns = 30;
+    std::vector<SparseDataBlock<num_t>*> blocks = getLabeledBlocks(9, 40, num_columns);
+    fvector theta = fvector::GetRandomFVector(num_columns);
+
+    int misclassified = 0;
+    for (auto block : blocks) {
+      misclassified += SVMTask::numMisclassified(theta, *block);
+    }
+    double const expected_fraction = misclassified / (9.0 * 40);
+    double const serial_loss = SVMTask::rmsErrorLoss(theta, blocks);
+    EXPECT_DOUBLE_EQ(expected_fraction, SVMTask::fractionMisclassified(theta, blocks));
+    EXPECT_LT(0, serial_loss);
+
+    // More threads than blocks is allowed.
+    for (int num_threads : {2, 4, 16}) {
+      EXPECT_DOUBLE_EQ(expected_fraction, SVMTask::fractionMisclassified(theta, blocks, num_threads));
+      EXPECT_NEAR(serial_loss, SVMTask::rmsErrorLoss(theta, blocks, num_threads), 1e-9);
+    }
+
+    for (auto block : blocks) {
+      delete block;
+    }
+  }
+
+  TEST(SVMTaskTest, TestEvaluateMatchesPerRowMetrics) {
+    int const num_columns = 8;
+    std::vector<SparseDataBlock<num_t>*> blocks = getLabeledBlocks(7, 30, num_columns);
+    fvector theta = fvector::GetRandomFVector(num_columns);
+
+    std::vector<num_t> margins;
+    std::vector<num_t> labels;
+    double hinge_loss = 0;
+    double squared_loss = 0;
+    svector<num_t> row(0, nullptr);
+    for (auto block : blocks) {
+      for (int i = 0; i < block->getNumRows(); i++) {
+        block->getRowVectorFast(i, &row);
+        num_t const margin = ml::dot(row, theta.values_);
+        margins.push_back(margin);
+        labels.push_back(*row.class_);
+        hinge_loss += std::max<num_t>(0, 1 - margin * *row.class_);
+        squared_loss += (1 - margin * *row.class_) * (1 - margin * *row.class_);
+      }
+    }
+    // The AUC by comparing every positive row with every negative row.
+    double pairs = 0;
+    double wins = 0;
+    for (int p = 0; p < margins.size(); p++) {
+      for (int n = 0; n < margins.size(); n++) {
+        if (labels[p] == 1 && labels[n] == -1) {
+          pairs++;
+          wins += margins[p] > margins[n] ? 1 : margins[p] == margins[n] ? 0.5 : 0;
+        }
+      }
+    }
+
+    for (int num_threads : {1, 3}) {
+      SVMMetrics const metrics = SVMTask::evaluate(theta, blocks, num_threads, true);
+      EXPECT_EQ(margins.size(), metrics.rows);
+      EXPECT_DOUBLE_EQ(SVMTask::fractionMisclassified(theta, blocks), metrics.fractionMisclassified());
+      EXPECT_NEAR(hinge_loss, metrics.hinge_loss, 1e-3);
+      EXPECT_NEAR(squared_loss, metrics.squared_loss, 1e-3);
+      EXPECT_NEAR(wins / pairs, metrics.auc, 1e-9);
+      EXPECT_NEAR(SVMTask::rmsErrorLoss(theta, blocks), metrics.rmsErrorLoss(), 1e-9);
+    }
+    EXPECT_EQ(-1, SVMTask::evaluate(theta, blocks).auc);
+
+    for (auto block : blocks) {
+      delete block;
+    }
+  }
+
+  TEST(SVMTaskTest, TestGradientBufferSumsEachFeatureOnce) {
+    GradientBuffer gradient(10);
+    gradient.add(3, 1);
+    gradient.add(7, 2);
+    gradient.add(3, 0.5);
+    gradient.add(7, -1);
+    ASSERT_EQ(std::vector<int>({3, 7}), gradient.columns());
+    EXPECT_FLOAT_EQ(1.5, gradient.take(3));
+    EXPECT_FLOAT_EQ(1, gradient.take(7));
+    gradient.clear();
+    EXPECT_TRUE(gradient.columns().empty());
+
+    // Taken sums start again from zero.
+    gradient.add(7, 4);
+    ASSERT_EQ(std::vector<int>({7}), gradient.columns());
+    EXPECT_FLOAT_EQ(4, gradient.take(7));
+    EXPECT_FLOAT_EQ(0, gradient.take(3));
+    gradient.clear();
+
+    // A feature whose sum returns to zero, or which is added zero, is still listed once.
+    gradient.add(5, 0);
+    gradient.add(2, 1);
+    gradient.add(2, -1);
+    gradient.add(2, 3);
+    gradient.add(5, 0);
+    ASSERT_EQ(std::vector<int>({5, 2}), gradient.columns());
+    EXPECT_FLOAT_EQ(3, gradient.take(2));
+    EXPECT_FLOAT_EQ(0, gradient.take(5));
+  }
+
+  TEST(SVMTaskTest, TestEveryUpdatePolicyLearns) {
+    // Rows labeled by the sign of their first column's value, which every row holds.
+    int const num_columns = 20;
+    std::vector<SparseDataBlock<num_t>*> blocks;
+    QuickRandom qr;
+    static num_t labels[2] = {-1, 1};
+    for (int b = 0; b < 4; b++) {
+      SparseDataBlock<num_t> *block = new SparseDataBlock<num_t>(100 * num_columns * 12);
+      for (int i = 0; i < 100; i++) {
+        svector<num_t> row;
+        num_t const x = qr.nextFloat() * 2 - 1;
+        row.setClassification(&labels[x > 0]);
+        row.push_back(0, x);
+        for (int j = 1; j < num_columns; j++) {
+          if (qr.nextInt32() % 4 == 0) {
+            row.push_back(j, qr.nextFloat() * 0.1);
+          }
+        }
+        EXPECT_TRUE(block->appendRow(row)) << "test block too small";
+      }
+      blocks.push_back(block);
+    }
+    std::vector<int> degrees(num_columns, 1);
+
+    std::vector<SVMUpdatePolicy> policies;
+    for (SVMLoss loss : {SVMLoss::kHinge, SVMLoss::kAlwaysUpdate}) {
+      for (SVMRegularization regularization : {SVMRegularization::kNone,
+                                               SVMRegularization::kDegreeScaling,
+                                               SVMRegularization::kLazyL2}) {
+        for (UpdateConsistency consistency : {UpdateConsistency::kRacy,
+                                              UpdateConsistency::kAtomic,
+                                              UpdateConsistency::kLocked}) {
+          for (SVMOptimizer optimizer : {SVMOptimizer::kSgd, SVMOptimizer::kAdaGrad}) {
+            SVMUpdatePolicy policy;
+            policy.loss = loss;
+            policy.regularization = regularization;
+            policy.consistency = consistency;
+            policy.optimizer = optimizer;
+            policies.push_back(policy);
+          }
+        }
+      }
+      for (ModelPrecision precision : {ModelPrecision::kInt16, ModelPrecision::kInt8}) {
+        SVMUpdatePolicy policy;
+        policy.loss = loss;
+        policy.precision = precision;
+        policies.push_back(policy);
+      }
+    }
+
+    for (SVMUpdatePolicy const & policy : policies) {
+      SVMParams params(1e-3, 0.5, 0.9);
+      params.policy = policy;
+      params.degrees = degrees;
+      fvector theta(num_columns);
+      theta.clear();
+      if (policy.regularization == SVMRegularization::kLazyL2) {
+        params.lazy_l2.reset(new LazyL2(num_columns, 400, params.mu, params.step_size));
+      }
+      if (policy.optimizer == SVMOptimizer::kAdaGrad) {
+        params.adagrad.reset(new AdaGradModel(theta));
+      }
+      if (policy.precision == ModelPrecision::kInt16) {
+        params.fixed_point16.reset(new FixedPointModel<std::int16_t>(theta, 8));
+      } else if (policy.precision == ModelPrecision::kInt8) {
+        params.fixed_point8.reset(new FixedPointModel<std::int8_t>(theta, 8));
+      }
+
+      std::vector<std::unique_ptr<SVMTask>> tasks;
+      for (int t = 0; t < 2; t++) {
+        DataView *view = new DataView();
+        view->appendBlock(blocks[2 * t]);
+        view->appendBlock(blocks[2 * t + 1]);
+        tasks.push_back(std::unique_ptr<SVMTask>(new SVMTask(view, &theta, &params)));
+      }
+      ThreadPool tp([&tasks](int thread_id, void *state) {
+        (void) state;
+        tasks[thread_id]->execute(thread_id, nullptr);
+      }, nullptr, 2);
+      tp.begin();
+      for (int epoch = 0; epoch < 5; epoch++) {
+        tp.cycle();
+        FinishSVMEpoch(&params, &theta);
+      }
+      tp.stop();
+      EXPECT_GT(0.1, SVMTask::fractionMisclassified(theta, blocks))
+        << SVMLossName(policy.loss) << ", " << SVMRegularizationName(policy.regularization) << ", "
+        << UpdateConsistencyName(policy.consistency) << ", " << SVMOptimizerName(policy.optimizer) << ", "
+        << ModelPrecisionName(policy.precision);
+    }
+
+    for (auto block : blocks) {
+      delete block;
+    }
+  }
+
+  TEST(SVMTaskTest, TestLazyL2MatchesEagerShrinkage) {
+    int const num_columns = 6;
+    int const num_rows = 50;
+    SparseDataBlock<num_t> block(num_rows * 64);
+    QuickRandom qr;
+    static num_t labels[2] = {-1, 1};
+    for (int i = 0; i < num_rows; i++) {
+      svector<num_t> row;
+      row.setClassification(&labels[i % 2]);
+      // Rows touch few features, so most shrinkage is deferred.
+      row.push_back(i % num_columns, qr.nextFloat() + 0.5);
+      row.push_back((i * 7 + 3) % num_columns, qr.nextFloat() - 0.5);
+      ASSERT_TRUE(block.appendRow(row));
+    }
+
+    SVMParams params(2, 0.5, 0.9);
+    params.policy.loss = SVMLoss::kHinge;
+    params.policy.regularization = SVMRegularization::kLazyL2;
+    params.lazy_l2.reset(new LazyL2(num_columns, num_rows, params.mu, params.step_size));
+    fvector lazy(num_columns);
+    lazy.clear();
+    DataView *view = new DataView();
+    view->appendBlock(&block);
+    SVMTask task(view, &lazy, &params);
+
+    std::vector<double> eager(num_columns, 0);
+    double step_size = params.step_size;
+    svector<num_t> row(0, nullptr);
+    for (int epoch = 0; epoch < 3; epoch++) {
+      task.execute(0, nullptr);
+      params.lazy_l2->renormalize(&lazy, params.step_size);
+
+      // Every row shrinks the whole model once it has stepped.
+      double const decay = 1 - step_size * params.mu / num_rows;
+      for (int i = 0; i < num_rows; i++) {
+        block.getRowVectorFast(i, &row);
+        double wxy = 0;
+        for (int j = 0; j < row.num_elements_; j++) {
+          wxy += row.values_[j] * eager[row.index_[j]];
+        }
+        wxy *= *row.class_;
+        if (wxy < 1) {
+          for (int j = 0; j < row.num_elements_; j++) {
+            eager[row.index_[j]] += row.values_[j] * step_size * *row.class_;
+          }
+        }
+        for (double & w : eager) {
+          w *= decay;
+        }
+      }
+      step_size *= params.step_decay;
+
+      for (int j = 0; j < num_columns; j++) {
+        EXPECT_NEAR(eager[j], lazy[j], 1e-4) << "epoch " << epoch << ", feature " << j;
+      }
+    }
+  }
+
+  TEST(SVMTaskTest, TestLazyL2MiniBatchesMatchEagerShrinkage) {
+    int const num_columns = 6;
+    int const num_rows = 50;
+    int const minibatch_rows = 4;
+    SparseDataBlock<num_t> block(num_rows * 64);
+    QuickRandom qr;
+    static num_t labels[2] = {-1, 1};
+    for (int i = 0; i < num_rows; i++) {
+      svector<num_t> row;
+      row.setClassification(&labels[i % 2]);
+      row.push_back(i % num_columns, qr.nextFloat() + 0.5);
+      row.push_back((i * 7 + 3) % num_columns, qr.nextFloat() - 0.5);
+      ASSERT_TRUE(block.appendRow(row));
+    }
+
+    for (UpdateConsistency consistency : {UpdateConsistency::kRacy, UpdateConsistency::kLocked}) {
+      SVMParams params(2, 0.5, 0.9);
+      params.policy.loss = SVMLoss::kHinge;
+      params.policy.regularization = SVMRegularization::kLazyL2;
+      params.policy.consistency = consistency;
+      params.minibatch_rows = minibatch_rows;
+      params.lazy_l2.reset(new LazyL2(num_columns, num_rows, params.mu, params.step_size));
+      fvector lazy(num_columns);
+      lazy.clear();
+      DataView *view = new DataView();
+      view->appendBlock(&block);
+      SVMTask task(view, &lazy, &params);
+
+      std::vector<double> eager(num_columns, 0);
+      std::vector<double> gradient(num_columns, 0);
+      double step_size = params.step_size;
+      svector<num_t> row(0, nullptr);
+      for (int epoch = 0; epoch < 3; epoch++) {
+        task.execute(0, nullptr);
+        params.lazy_l2->renormalize(&lazy, params.step_size);
+
+        // Rows read the model without the pending gradient, which is added after every
+        // minibatch_rows rows, before the last row's shrinkage, and at the end of the epoch.
+        double const decay = 1 - step_size * params.mu / num_rows;
+        auto add_gradient = [&eager, &gradient]() {
+          for (int j = 0; j < num_columns; j++) {
+            eager[j] += gradient[j];
+            gradient[j] = 0;
+          }
+        };
+        for (int i = 0; i < num_rows; i++) {
+          block.getRowVectorFast(i, &row);
+          double wxy = 0;
+          for (int j = 0; j < row.num_elements_; j++) {
+            wxy += row.values_[j] * eager[row.index_[j]];
+          }
+          wxy *= *row.class_;
+          if (wxy < 1) {
+            for (int j = 0; j < row.num_elements_; j++) {
+              gradient[row.index_[j]] += row.values_[j] * step_size * *row.class_;
+            }
+          }
+          if ((i + 1) % minibatch_rows == 0) {
+            add_gradient();
+          }
+          for (double & w : eager) {
+            w *= decay;
+          }
+        }
+        add_gradient();
+        step_size *= params.step_decay;
+
+        for (int j = 0; j < num_columns; j++) {
+          EXPECT_NEAR(eager[j], lazy[j], 1e-4) << UpdateConsistencyName(consistency) << ", epoch " << epoch
+                                               << ", feature " << j;
+        }
+      }
+    }
+  }
+
+  TEST(SVMTaskTest, TestAdaGradStepsEachFeatureByItsHistory) {
+    int const num_columns = 4;
+    int const num_rows = 40;
+    SparseDataBlock<num_t> block(num_rows * 64);
+    QuickRandom qr;
+    static num_t labels[2] = {-1, 1};
+    for (int i = 0; i < num_rows; i++) {
+      svector<num_t> row;
+      row.setClassification(&labels[i % 2]);
+      row.push_back(0, qr.nextFloat() - 0.5);
+      // Feature 3 is rare.
+      row.push_back(i % 10 == 0 ? 3 : 1 + i % 2, qr.nextFloat() + 0.5);
+      ASSERT_TRUE(block.appendRow(row));
+    }
+
+    SVMParams params(1, 0.2, 0.9);
+    params.policy.loss = SVMLoss::kHinge;
+    params.policy.optimizer = SVMOptimizer::kAdaGrad;
+    fvector theta(num_columns);
+    theta.clear();
+    params.adagrad.reset(new AdaGradModel(theta));
+    DataView *view = new DataView();
+    view->appendBlock(&block);
+    SVMTask task(view, &theta, &params);
+
+    std::vector<double> weights(num_columns, 0);
+    std::vector<double> accumulators(num_columns, 0);
+    double step_size = params.step_size;
+    svector<num_t> row(0, nullptr);
+    for (int epoch = 0; epoch < 3; epoch++) {
+      task.execute(0, nullptr);
+      FinishSVMEpoch(&params, &theta);
+
+      for (int i = 0; i < num_rows; i++) {
+        block.getRowVectorFast(i, &row);
+        double wxy = 0;
+        for (int j = 0; j < row.num_elements_; j++) {
+          wxy += row.values_[j] * weights[row.index_[j]];
+        }
+        if (wxy * *row.class_ >= 1) {
+          continue;
+        }
+        for (int j = 0; j < row.num_elements_; j++) {
+          double const gradient = row.values_[j] * *row.class_;
+          accumulators[row.index_[j]] += gradient * gradient;
+          weights[row.index_[j]] += step_size * gradient / std::sqrt(accumulators[row.index_[j]]);
+        }
+      }
+      step_size *= params.step_decay;
+
+      for (int j = 0; j < num_columns; j++) {
+        EXPECT_NEAR(weights[j], theta[j], 1e-4) << "epoch " << epoch << ", feature " << j;
+        EXPECT_NEAR(accumulators[j], params.adagrad->getEntries()[j].accumulator, 1e-4);
+      }
+    }
+  }
+
+  TEST(SVMTaskTest, TestMultiModelMatchesSeparateRuns) {
+    int const num_columns = 30;
+    int const num_rows = 200;
+    SparseDataBlock<num_t> block(num_rows * num_columns * 12);
+    QuickRandom qr;
+    static num_t labels[2] = {-1, 1};
+    for (int i = 0; i < num_rows; i++) {
+      svector<num_t> row;
+      row.setClassification(&labels[qr.nextInt32() % 2]);
+      for (int j = qr.nextInt32() % 5; j < num_columns; j += 1 + qr.nextInt32() % 8) {
+        row.push_back(j, qr.nextFloat() - 0.5);
+      }
+      ASSERT_TRUE(block.appendRow(row));
+    }
+    std::vector<int> degrees(num_columns, 1);
+    svector<num_t> row(0, nullptr);
+    for (int i = 0; i < num_rows; i++) {
+      block.getRowVectorFast(i, &row);
+      for (int j = 0; j < row.num_elements_; j++) {
+        degrees[row.index_[j]]++;
+      }
+    }
+    fvector initial(num_columns);
+    for (int j = 0; j < num_columns; j++) {
+      initial[j] = qr.nextFloat() - 0.5;
+    }
+    // More settings than one vector of lanes.
+    std::vector<SVMSweepSetting> settings;
+    for (int k = 0; k < 10; k++) {
+      settings.push_back(SVMSweepSetting(0.02 * (k + 1), k % 3));
+    }
+
+    for (SVMLoss loss : {SVMLoss::kHinge, SVMLoss::kAlwaysUpdate}) {
+      for (SVMRegularization regularization : {SVMRegularization::kNone, SVMRegularization::kDegreeScaling}) {
+        MultiSVMModel model(initial, settings.size());
+        ASSERT_EQ(16, model.getStride());
+        MultiSVMParams multi_params(settings, model.getStride(), 0.9, degrees);
+        multi_params.loss = loss;
+        multi_params.regularization = regularization;
+        DataView *multi_view = new DataView();
+        multi_view->appendBlock(&block);
+        MultiSVMTask multi_task(multi_view, &model, &multi_params);
+        for (int epoch = 0; epoch < 3; epoch++) {
+          multi_task.execute(0, nullptr);
+        }
+
+        fvector theta(num_columns);
+        for (int k = 0; k < settings.size(); k++) {
+          SVMParams params(settings[k].mu, settings[k].step_size, 0.9);
+          params.policy.loss = loss;
+          params.policy.regularization = regularization;
+          params.degrees = degrees;
+          fvector expected(initial);
+          DataView *view = new DataView();
+          view->appendBlock(&block);
+          SVMTask task(view, &expected, &params);
+          for (int epoch = 0; epoch < 3; epoch++) {
+            task.execute(0, nullptr);
+          }
+
+          model.copyModel(k, &theta);
+          for (int j = 0; j < num_columns; j++) {
+            EXPECT_NEAR(expected[j], theta[j], 1e-4)
+              << SVMLossName(loss) << ", " << SVMRegularizationName(regularization) << ", model " << k;
+          }
+        }
+      }
+    }
+  }
+
+  TEST(SVMTaskTest, TestParseSVMSweep) {
+    std::vector<SVMSweepSetting> settings;
+    ASSERT_TRUE(ParseSVMSweep("0.1:1,0.05:0.5", &settings));
+    ASSERT_EQ(2, settings.size());
+    EXPECT_FLOAT_EQ(0.05, settings[1].step_size);
+    EXPECT_FLOAT_EQ(0.5, settings[1].mu);
+    EXPECT_FALSE(ParseSVMSweep("", &settings));
+    EXPECT_FALSE(ParseSVMSweep("0.1", &settings));
+    EXPECT_FALSE(ParseSVMSweep("0.1:1,x:1", &settings));
+    EXPECT_FALSE(ParseSVMSweep("0.1:1x", &settings));
+    EXPECT_EQ(2, settings.size());
+  }
+
+  TEST(SVMTaskTest, TestParseUpdatePolicy) {
+    SVMLoss loss;
+    ASSERT_TRUE(ParseSVMLoss(SVMLossName(SVMLoss::kHinge), &loss));
+    EXPECT_EQ(SVMLoss::kHinge, loss);
+    EXPECT_FALSE(ParseSVMLoss("squared", &loss));
+    SVMRegularization regularization;
+    ASSERT_TRUE(ParseSVMRegularization(SVMRegularizationName(SVMRegularization::kDegreeScaling), &regularization));
+    EXPECT_EQ(SVMRegularization::kDegreeScaling, regularization);
+    UpdateConsistency consistency;
+    for (UpdateConsistency expected : {UpdateConsistency::kRacy, UpdateConsistency::kAtomic, UpdateConsistency::kLocked}) {
+      ASSERT_TRUE(ParseUpdateConsistency(UpdateConsistencyName(expected), &consistency));
+      EXPECT_EQ(expected, consistency);
+    }
+    EXPECT_FALSE(ParseUpdateConsistency("transactional", &consistency));
+    SVMOptimizer optimizer;
+    ASSERT_TRUE(ParseSVMOptimizer(SVMOptimizerName(SVMOptimizer::kAdaGrad), &optimizer));
+    EXPECT_EQ(SVMOptimizer::kAdaGrad, optimizer);
+  }
+
+}
@@ -0,0 +1,72 @@
+#include "gtest/gtest.h"
+#include "storage/exvector.h"
+#include "storage/SparseDot.h"
+#include "storage/Utils.h"
+
+#include <cmath>
+
+namespace obamadb {
+
+  namespace {
+    // Fills a vector with sorted, unique indices in [0, dimension) chosen with probability density.
+    template<class T>
+    void randomSparseVector(QuickRandom *qr, int dimension, double density, svector<T> *vec) {
+      std::uint32_t max_uint32 = 0;
+      max_uint32 -= 1;
+      std::uint32_t const bound = density * max_uint32;
+      for (int i = 0; i < dimension; i++) {
+        if (qr->nextInt32() < bound) {
+          vec->push_back(i, static_cast<T>((qr->nextInt32() % 5) - 2));
+        }
+      }
+    }
+
+    void expectKernelsAgree(const svector<num_t> &a, const svector<signed char> &b) {
+      num_t const expected = ml::sparseDotScalar(a, b);
+      num_t const tolerance = 1e-4 * (1 + std::abs(expected));
+      EXPECT_NEAR(expected, ml::sparseDotGalloping(a, b), tolerance);
+      EXPECT_NEAR(expected, ml::sparseDot(a, b), tolerance);
+      if (ml::cpuSupportsAVX2()) {
+        EXPECT_NEAR(expected, ml::sparseDotAVX2(a, b), tolerance);
+      }
+      if (ml::cpuSupportsAVX512()) {
+        EXPECT_NEAR(expected, ml::sparseDotAVX512(a, b), tolerance);
+      }
+    }
+  }
+
+  TEST(SparseDotTest, TestSmall) {
+    svector<num_t> a;
+    svector<signed char> b;
+    a.push_back(1, 2.0);
+    a.push_back(5, 3.0);
+    a.push_back(9, 4.0);
+    b.push_back(0, 1);
+    b.push_back(5, -1);
+    b.push_back(9, 1);
+    EXPECT_EQ(1.0, ml::sparseDotScalar(a, b));
+    expectKernelsAgree(a, b);
+  }
+
+  TEST(SparseDotTest, TestKernelsAgree) {
+    QuickRandom qr;
+    double const densities[] = {0.001, 0.01, 0.1, 0.5, 1.0};
+    for (double da : densities) {
+      for (double db : densities) {
+        svector<num_t> a;
+        svector<signed char> b;
+        randomSparseVector(&qr, 5000, da, &a);
+        randomSparseVector(&qr, 5000, db, &b);
+        expectKernelsAgree(a, b);
+      }
+    }
+  }
+
+  TEST(SparseDotTest, TestEmpty) {
+    svector<num_t> a;
+    svector<signed char> b;
+    a.push_back(3, 1.0);
+    EXPECT_EQ(0, ml::sparseDot(a, b));
+    EXPECT_EQ(0, ml::sparseDot(svector<num_t>(), b));
+  }
+}
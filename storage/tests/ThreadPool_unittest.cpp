@@ -0,0 +1,275 @@
+#include "gtest/gtest.h"
+#include "storage/ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+DEFINE_string(core_affinities, "-1", "");
+
+namespace obamadb {
+
+  TEST(ThreadPoolTest, TestWorkStealingQueueCoversAllUnits) {
+    const int num_units = 101;
+    threading::WorkStealingQueue queue(4);
+    queue.fill(num_units, 3);
+
+    // A single worker drains its own queue and then steals every other worker's items.
+    std::vector<int> covered(num_units, 0);
+    threading::WorkItem item;
+    while (queue.pop(1, &item)) {
+      ASSERT_LT(item.begin, item.end);
+      ASSERT_GE(3, item.end - item.begin);
+      for (int i = item.begin; i < item.end; i++) {
+        covered[i]++;
+      }
+    }
+    for (int i = 0; i < num_units; i++) {
+      EXPECT_EQ(1, covered[i]);
+    }
+  }
+
+  TEST(ThreadPoolTest, TestWorkStealingQueueParallel) {
+    const int num_threads = 4;
+    const int num_units = 10000;
+    threading::WorkStealingQueue queue(num_threads);
+    queue.fill(num_units, 7);
+
+    struct State {
+      threading::WorkStealingQueue *queue;
+      std::vector<int> covered;
+    } state = { &queue, std::vector<int>(num_units, 0) };
+
+    auto drain_fn = [](int thread_id, void *s) {
+      State *state = reinterpret_cast<State*>(s);
+      threading::WorkItem item;
+      while (state->queue->pop(thread_id, &item)) {
+        for (int i = item.begin; i < item.end; i++) {
+          state->covered[i]++;
+        }
+      }
+    };
+    ThreadPool tp(drain_fn, &state, num_threads);
+    tp.begin();
+    tp.cycle();
+    tp.stop();
+
+    for (int i = 0; i < num_units; i++) {
+      EXPECT_EQ(1, state.covered[i]);
+    }
+  }
+
+  TEST(ThreadPoolTest, TestBarrierCount) {
+    threading::barrier_t barrier(2, 0);
+    EXPECT_EQ(2, barrier.count());
+    std::thread waiter([&barrier] { barrier.wait(); });
+    while (barrier.count() != 1) {
+      std::this_thread::yield();
+    }
+    barrier.wait();
+    waiter.join();
+    // The barrier resets for its next use.
+    EXPECT_EQ(2, barrier.count());
+  }
+
+  TEST(ThreadPoolTest, TestCyclesAreOrdered) {
+    const int num_threads = 4;
+    const int num_cycles = 200;
+    // Both the futex-only and the spinning paths must order every cycle.
+    for (int spins : {0, 100000}) {
+      threading::setDefaultBarrierSpinBudget(spins);
+      std::vector<int> counters(num_threads, 0);
+      auto count_fn = [](int thread_id, void *s) {
+        (*reinterpret_cast<std::vector<int>*>(s))[thread_id]++;
+      };
+      ThreadPool tp(count_fn, &counters, num_threads);
+      tp.begin();
+      for (int cycle = 0; cycle < num_cycles; cycle++) {
+        tp.cycle();
+        for (int t = 0; t < num_threads; t++) {
+          ASSERT_EQ(cycle + 1, counters[t]);
+        }
+      }
+      tp.stop();
+    }
+    threading::setDefaultBarrierSpinBudget(threading::kDefaultBarrierSpinBudget);
+  }
+
+  TEST(ThreadPoolTest, TestEpochSchedulerRefills) {
+    const int num_threads = 4;
+    const int num_units = 1000;
+    const int num_epochs = 5;
+    threading::EpochScheduler scheduler(num_threads, num_units, 9);
+
+    struct State {
+      threading::EpochScheduler *scheduler;
+      std::vector<int> covered;
+      std::atomic<int> last_finishers;
+    } state;
+    state.scheduler = &scheduler;
+    state.covered.resize(num_units, 0);
+    state.last_finishers = 0;
+
+    auto epoch_fn = [](int thread_id, void *s) {
+      State *state = reinterpret_cast<State*>(s);
+      threading::WorkItem item;
+      while (state->scheduler->next(thread_id, &item)) {
+        for (int i = item.begin; i < item.end; i++) {
+          state->covered[i]++;
+        }
+      }
+      if (state->scheduler->finish(thread_id)) {
+        state->last_finishers++;
+      }
+    };
+    ThreadPool tp(epoch_fn, &state, num_threads);
+    tp.begin();
+    for (int epoch = 0; epoch < num_epochs; epoch++) {
+      tp.cycle();
+      EXPECT_EQ(epoch + 1, state.last_finishers);
+      for (int i = 0; i < num_units; i++) {
+        ASSERT_EQ(epoch + 1, state.covered[i]);
+      }
+    }
+    tp.stop();
+  }
+
+  TEST(ThreadPoolTest, TestWorkerPoolPartialJobs) {
+    WorkerPool pool(4);
+    std::vector<int> counters(4, 0);
+    auto count_fn = [](int thread_id, void *s) {
+      (*reinterpret_cast<std::vector<int>*>(s))[thread_id]++;
+    };
+    // Jobs which use only some of the workers leave the others idle.
+    for (int size = 1; size <= 4; size++) {
+      std::vector<std::function<void(int, void*)>> fns(size, count_fn);
+      std::vector<void*> states(size, &counters);
+      pool.submit(fns, states);
+      pool.wait();
+      EXPECT_EQ(0, pool.getNumRunning());
+    }
+    EXPECT_EQ(std::vector<int>({4, 3, 2, 1}), counters);
+  }
+
+  TEST(ThreadPoolTest, TestThreadPoolsShareGlobalPool) {
+    WorkerPool pool(4);
+    WorkerPool::SetGlobal(&pool);
+    std::vector<int> counters(3, 0);
+    auto count_fn = [](int thread_id, void *s) {
+      (*reinterpret_cast<std::vector<int>*>(s))[thread_id]++;
+    };
+    // Consecutive pools reuse the global workers, which are only reserved during a cycle.
+    for (int i = 0; i < 3; i++) {
+      ThreadPool tp(count_fn, &counters, 3);
+      tp.begin();
+      tp.cycle();
+      EXPECT_TRUE(pool.tryAcquire());
+      pool.release();
+      tp.stop();
+    }
+    EXPECT_EQ(std::vector<int>({3, 3, 3}), counters);
+
+    // A pool running inside a job on the global pool falls back to private workers.
+    struct Nested {
+      std::vector<int> counters;
+    } nested = { std::vector<int>(2, 0) };
+    auto outer_fn = [](int, void *s) {
+      Nested *nested = reinterpret_cast<Nested*>(s);
+      ThreadPool inner([](int thread_id, void *s) {
+        reinterpret_cast<Nested*>(s)->counters[thread_id]++;
+      }, nested, 2);
+      inner.begin();
+      inner.cycle();
+      inner.stop();
+    };
+    ThreadPool outer(outer_fn, &nested, 1);
+    outer.begin();
+    outer.cycle();
+    outer.stop();
+    EXPECT_EQ(std::vector<int>({1, 1}), nested.counters);
+    WorkerPool::SetGlobal(nullptr);
+  }
+
+  TEST(ThreadPoolTest, TestThreadPoolsUseThreadsPool) {
+    WorkerPool global(2);
+    WorkerPool::SetGlobal(&global);
+    WorkerPool own(std::vector<int>({0, 0}));
+    EXPECT_EQ(2, own.getNumWorkers());
+    EXPECT_EQ(0, own.getCore(1));
+
+    // A background thread which sets its own pool keeps its cycles off of the global pool.
+    std::atomic<int> acquired(0);
+    std::thread background([&own, &acquired] {
+      WorkerPool::SetForThread(&own);
+      EXPECT_EQ(&own, WorkerPool::Current());
+      struct State {
+        WorkerPool *own;
+        std::atomic<int> *acquired;
+      } state = { &own, &acquired };
+      ThreadPool tp([](int, void *s) {
+        State *state = reinterpret_cast<State*>(s);
+        // The thread's pool is reserved by the cycle.
+        *state->acquired += state->own->tryAcquire();
+      }, &state, 2);
+      tp.begin();
+      tp.cycle();
+      tp.stop();
+      WorkerPool::SetForThread(nullptr);
+    });
+    background.join();
+    EXPECT_EQ(0, acquired);
+    EXPECT_EQ(&global, WorkerPool::Current());
+    WorkerPool::SetGlobal(nullptr);
+  }
+
+  TEST(ThreadPoolTest, TestCycleReportSummarizes) {
+    std::vector<WorkerStats> workers(4);
+    double const times[4] = {10, 40, 20, 30};
+    for (int i = 0; i < 4; i++) {
+      workers[i].compute_ms = times[i];
+      workers[i].wait_ms = 40 - times[i];
+      workers[i].rows = i + 1;
+      workers[i].nonzeros = 10 * (i + 1);
+    }
+    CycleReport const report = CycleReport::Summarize(workers);
+    EXPECT_DOUBLE_EQ(10, report.min_ms);
+    EXPECT_DOUBLE_EQ(25, report.median_ms);
+    EXPECT_DOUBLE_EQ(40, report.max_ms);
+    EXPECT_DOUBLE_EQ(40.0 / 25, report.imbalance);
+    EXPECT_EQ(0, report.fastest);
+    EXPECT_EQ(1, report.slowest);
+    EXPECT_DOUBLE_EQ(30, report.max_wait_ms);
+    EXPECT_EQ(1, report.min_rows);
+    EXPECT_EQ(4, report.max_rows);
+    EXPECT_EQ(10, report.min_nonzeros);
+    EXPECT_EQ(40, report.max_nonzeros);
+  }
+
+  TEST(ThreadPoolTest, TestWorkersReportStragglers) {
+    const int num_threads = 3;
+    ThreadPool tp([](int thread_id, void*) {
+      // The last thread straggles.
+      std::this_thread::sleep_for(std::chrono::milliseconds(thread_id == 2 ? 50 : 1));
+      threading::reportWork(thread_id + 1, 100);
+    }, nullptr, num_threads);
+    tp.begin();
+    tp.cycle();
+    ASSERT_EQ(num_threads, tp.getWorkerStats().size());
+    for (int i = 0; i < num_threads; i++) {
+      EXPECT_EQ(i + 1, tp.getWorkerStats()[i].rows);
+      EXPECT_EQ(100, tp.getWorkerStats()[i].nonzeros);
+    }
+    CycleReport const report = tp.getCycleReport();
+    EXPECT_EQ(2, report.slowest);
+    EXPECT_LE(50, report.max_ms);
+    EXPECT_LT(1, report.imbalance);
+    // The straggler finished last, so it never waited.
+    EXPECT_DOUBLE_EQ(0, tp.getWorkerStats()[2].wait_ms);
+    EXPECT_LT(0, tp.getWorkerStats()[0].wait_ms);
+    tp.stop();
+
+    // Work reported off of a pool is ignored.
+    threading::reportWork(1, 1);
+  }
+}
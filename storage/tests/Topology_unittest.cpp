@@ -0,0 +1,126 @@
+#include "gtest/gtest.h"
+#include "storage/ThreadPool.h"
+#include "storage/Topology.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+DEFINE_string(core_affinities, "-1", "");
+
+namespace obamadb {
+
+  namespace {
+    using threading::CpuInfo;
+    using threading::CpuTopology;
+    using threading::PlacementPolicy;
+
+    // Two sockets of two cores with two hyperthreads each, numbered the way Linux numbers them:
+    // the first hyperthread of every core, then the siblings.
+    CpuTopology getTwoSocketTopology() {
+      std::vector<CpuInfo> cpus;
+      for (int cpu = 0; cpu < 8; cpu++) {
+        int const socket = (cpu / 2) % 2;
+        cpus.push_back(CpuInfo(cpu, socket, cpu % 2, socket * 2));
+      }
+      return CpuTopology(cpus);
+    }
+
+    void writeFile(std::string const & path,
+                   std::string const & contents,
+                   std::vector<std::string> *created) {
+      std::ofstream file(path);
+      file << contents << "\n";
+      created->push_back(path);
+    }
+
+    void makeDir(std::string const & path, std::vector<std::string> *created) {
+      mkdir(path.c_str(), 0755);
+      created->push_back(path);
+    }
+  }
+
+  TEST(TopologyTest, TestParseCpuList) {
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 8, 10, 11}), threading::ParseCpuList("0-3,8,10-11"));
+    EXPECT_EQ(std::vector<int>({5}), threading::ParseCpuList("5\n"));
+    EXPECT_TRUE(threading::ParseCpuList("").empty());
+  }
+
+  TEST(TopologyTest, TestPlacementPolicies) {
+    CpuTopology topology = getTwoSocketTopology();
+    EXPECT_EQ(8, topology.numCpus());
+    EXPECT_EQ(4, topology.numPhysicalCores());
+    EXPECT_EQ(2, topology.numSockets());
+
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7}), topology.placement(PlacementPolicy::kLinear));
+    EXPECT_EQ(std::vector<int>({0, 4, 1, 5, 2, 6, 3, 7}), topology.placement(PlacementPolicy::kCompact));
+    EXPECT_EQ(std::vector<int>({0, 2, 1, 3, 4, 6, 5, 7}), topology.placement(PlacementPolicy::kScatter));
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7}),
+              topology.placement(PlacementPolicy::kOnePerPhysicalCore));
+    EXPECT_EQ(std::vector<int>({0, 1, 4, 5, 2, 3, 6, 7}),
+              topology.placement(PlacementPolicy::kFillSocketFirst));
+    EXPECT_EQ("cpu5(socket 0, core 1, smt 1, l3 0)", topology.describe(5));
+  }
+
+  TEST(TopologyTest, TestParsePlacementPolicy) {
+    for (PlacementPolicy policy : {PlacementPolicy::kLinear, PlacementPolicy::kCompact,
+                                   PlacementPolicy::kScatter, PlacementPolicy::kOnePerPhysicalCore,
+                                   PlacementPolicy::kFillSocketFirst}) {
+      PlacementPolicy parsed = PlacementPolicy::kLinear;
+      EXPECT_TRUE(threading::ParsePlacementPolicy(threading::PlacementPolicyName(policy), &parsed));
+      EXPECT_TRUE(policy == parsed);
+    }
+    PlacementPolicy parsed;
+    EXPECT_FALSE(threading::ParsePlacementPolicy("everywhere", &parsed));
+  }
+
+  TEST(TopologyTest, TestDiscoverFromSysfs) {
+    // One socket with two cores, whose hyperthreads are cpus {0, 2} and {1, 3}, sharing an L3.
+    std::string const root = "TopologyTest_sysfs";
+    std::vector<std::string> created;
+    makeDir(root, &created);
+    writeFile(root + "/online", "0-3", &created);
+    for (int cpu = 0; cpu < 4; cpu++) {
+      std::string const dir = root + "/cpu" + std::to_string(cpu);
+      makeDir(dir, &created);
+      makeDir(dir + "/topology", &created);
+      makeDir(dir + "/cache", &created);
+      makeDir(dir + "/cache/index0", &created);
+      makeDir(dir + "/cache/index1", &created);
+      writeFile(dir + "/topology/physical_package_id", "0", &created);
+      writeFile(dir + "/topology/core_id", std::to_string(cpu % 2), &created);
+      writeFile(dir + "/cache/index0/level", "1", &created);
+      writeFile(dir + "/cache/index0/shared_cpu_list", cpu % 2 == 0 ? "0,2" : "1,3", &created);
+      writeFile(dir + "/cache/index1/level", "3", &created);
+      writeFile(dir + "/cache/index1/shared_cpu_list", "0-3", &created);
+    }
+
+    CpuTopology topology = CpuTopology::Discover(root);
+    EXPECT_EQ(4, topology.numCpus());
+    EXPECT_EQ(2, topology.numPhysicalCores());
+    EXPECT_EQ(1, topology.numSockets());
+    EXPECT_EQ("cpu2(socket 0, core 0, smt 1, l3 0)", topology.describe(2));
+    EXPECT_EQ(std::vector<int>({0, 2, 1, 3}), topology.placement(PlacementPolicy::kCompact));
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3}), topology.placement(PlacementPolicy::kOnePerPhysicalCore));
+
+    // A missing sysfs falls back to one core per cpu.
+    CpuTopology flat = CpuTopology::Discover(root + "/does_not_exist");
+    EXPECT_EQ(threading::numCores(), flat.numCpus());
+    EXPECT_EQ(threading::numCores(), flat.numPhysicalCores());
+
+    // Children were created after their parents.
+    for (auto it = created.rbegin(); it != created.rend(); ++it) {
+      std::remove(it->c_str());
+    }
+  }
+
+  TEST(TopologyTest, TestDiscoverMachine) {
+    CpuTopology const & topology = threading::getTopology();
+    EXPECT_EQ(threading::numCores(), topology.numCpus());
+    for (int cpu : topology.placement(threading::getPlacementPolicy())) {
+      EXPECT_LE(0, cpu);
+    }
+  }
+}
@@ -76,6 +76,11 @@ namespace obamadb {
     EXPECT_GE(totalFloats * 0.02, std::abs((totalFloats/2) - negatives));
   }
 
+  TEST(UtilsTest, TestGetIntList) {
+    EXPECT_EQ(std::vector<int>({-1}), GetIntList("-1"));
+    EXPECT_EQ(std::vector<int>({0, 12, -3}), GetIntList("0,12,-3"));
+  }
+
 }
 
 